@@ -0,0 +1,458 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  adapter_bench.c
+ *
+ * @brief End-to-end latency and throughput benchmark for webos-connman-adapter
+ *
+ * Drives the adapter's Luna methods at a controlled concurrency while the
+ * adapter talks to mock-connman, and prints one JSON object per method:
+ *
+ *   {"method":"getstatus","services":1000,"requests":2000,"concurrency":16,
+ *    "p50Us":412,"p99Us":1730,"requestsPerSec":9120.5,"errors":0,
+ *    "dbusCallsPerRequest":3.00,"adapterCpuMsPerRequest":0.081,"peakRssKb":10240}
+ *
+ * With --storm an additional {"phase":"signalStorm",...} object reports the
+ * adapter's CPU time per connman signal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <glib.h>
+#include <luna-service2/lunaservice.h>
+
+typedef struct bench_method
+{
+	const gchar *name;
+	const gchar *uri;
+}bench_method_t;
+
+static const bench_method_t bench_methods[] = {
+	{ "findnetworks",	"luna://com.palm.wifi/findnetworks" },
+	{ "getstatus",		"luna://com.palm.connectionmanager/getstatus" },
+	{ "connect",		"luna://com.palm.wifi/connect" },
+	{ "setipv4",		"luna://com.palm.connectionmanager/setipv4" },
+	{ NULL,			NULL },
+};
+
+/* Seconds to wait for a method's requests before giving up on the rest */
+#define BENCH_RUN_TIMEOUT	60
+
+typedef struct bench_run
+{
+	const bench_method_t *method;
+	guint issued;
+	guint completed;	/* replied or failed to be sent */
+	guint errors;
+	gint64 *latencies;	/* of the replied requests */
+	guint replied;
+	GPtrArray *calls;	/* waiting for a reply */
+	GMainLoop *loop;
+}bench_run_t;
+
+typedef struct bench_call
+{
+	bench_run_t *run;
+	gint64 start;
+}bench_call_t;
+
+typedef struct process_usage
+{
+	guint64 cpu_ns;
+	guint64 peak_rss_kb;
+}process_usage_t;
+
+static LSHandle *handle = NULL;
+
+static gchar *option_methods = NULL;
+static gint option_requests = 1000;
+static gint option_concurrency = 16;
+static gint option_adapter_pid = 0;
+static gint option_mock_pid = 0;
+static gchar *option_mock_stats = NULL;
+static gint option_services = 0;
+static gboolean option_storm = FALSE;
+static gint option_storm_seconds = 5;
+
+static GOptionEntry option_entries[] = {
+	{ "methods", 'm', 0, G_OPTION_ARG_STRING, &option_methods, "Comma separated methods (findnetworks,getstatus,connect,setipv4)", "LIST" },
+	{ "requests", 'n', 0, G_OPTION_ARG_INT, &option_requests, "Requests per method", "N" },
+	{ "concurrency", 'c', 0, G_OPTION_ARG_INT, &option_concurrency, "Requests kept in flight", "N" },
+	{ "adapter-pid", 'p', 0, G_OPTION_ARG_INT, &option_adapter_pid, "PID of webos-connman-adapter", "PID" },
+	{ "mock-pid", 'M', 0, G_OPTION_ARG_INT, &option_mock_pid, "PID of mock-connman", "PID" },
+	{ "mock-stats", 's', 0, G_OPTION_ARG_FILENAME, &option_mock_stats, "Stats file written by mock-connman", "PATH" },
+	{ "services", 'N', 0, G_OPTION_ARG_INT, &option_services, "Number of services the mock was started with (reported only)", "N" },
+	{ "storm", 0, 0, G_OPTION_ARG_NONE, &option_storm, "Measure CPU time per signal during a mock signal storm", NULL },
+	{ "storm-seconds", 0, 0, G_OPTION_ARG_INT, &option_storm_seconds, "Duration of the mock signal storm", "SECONDS" },
+	{ NULL }
+};
+
+/**
+ * Read the accumulated CPU time and the peak RSS of a process from /proc
+ */
+
+static gboolean read_process_usage(gint pid, process_usage_t *usage)
+{
+	gchar *path, *contents = NULL;
+	gboolean ret = FALSE;
+
+	memset(usage, 0, sizeof(*usage));
+	if(pid <= 0)
+		return FALSE;
+
+	path = g_strdup_printf("/proc/%d/stat", pid);
+	if(g_file_get_contents(path, &contents, NULL, NULL))
+	{
+		/* utime and stime are fields 14 and 15, counted after the ')' closing the command name */
+		gchar *p = strrchr(contents, ')');
+		unsigned long long utime = 0, stime = 0;
+		if(NULL != p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) == 2)
+		{
+			usage->cpu_ns = (utime + stime) * (1000000000ULL / sysconf(_SC_CLK_TCK));
+			ret = TRUE;
+		}
+		g_free(contents);
+	}
+	g_free(path);
+
+	path = g_strdup_printf("/proc/%d/status", pid);
+	if(g_file_get_contents(path, &contents, NULL, NULL))
+	{
+		gchar *p = strstr(contents, "VmHWM:");
+		if(NULL != p)
+			usage->peak_rss_kb = g_ascii_strtoull(p + strlen("VmHWM:"), NULL, 10);
+		g_free(contents);
+	}
+	g_free(path);
+
+	return ret;
+}
+
+static guint64 stats_value(const gchar *stats, const gchar *key)
+{
+	gchar *needle = g_strdup_printf("\"%s\":", key);
+	const gchar *p = strstr(stats, needle);
+	guint64 value = 0;
+
+	if(NULL != p)
+		value = g_ascii_strtoull(p + strlen(needle), NULL, 10);
+	g_free(needle);
+
+	return value;
+}
+
+/**
+ * Ask mock-connman to dump its counters and return the requested one
+ */
+
+static guint64 read_mock_counter(const gchar *key)
+{
+	gchar *contents = NULL;
+	guint64 value = 0;
+
+	if(option_mock_pid <= 0 || NULL == option_mock_stats)
+		return 0;
+
+	kill(option_mock_pid, SIGUSR1);
+	/* The mock handles the signal from its main loop */
+	g_usleep(200 * 1000);
+
+	if(g_file_get_contents(option_mock_stats, &contents, NULL, NULL))
+	{
+		value = stats_value(contents, key);
+		g_free(contents);
+	}
+
+	return value;
+}
+
+static gchar *request_payload(const bench_method_t *method, guint sequence)
+{
+	if(g_str_equal(method->name, "connect"))
+		/* even numbered mock APs are open networks */
+		return g_strdup_printf("{\"ssid\":\"mock-ap-%u\"}", (sequence * 2) % MAX(2, option_services));
+	if(g_str_equal(method->name, "setipv4"))
+		return g_strdup("{\"method\":\"dhcp\"}");
+
+	return g_strdup("{}");
+}
+
+static void issue_next(bench_run_t *run);
+
+static bool reply_cb(LSHandle *sh, LSMessage *reply, void *ctx)
+{
+	bench_call_t *call = ctx;
+	bench_run_t *run = call->run;
+	const char *payload = LSMessageGetPayload(reply);
+
+	/* the run already timed out */
+	if(NULL == run)
+	{
+		g_free(call);
+		return true;
+	}
+
+	g_ptr_array_remove_fast(run->calls, call);
+	run->latencies[run->replied++] = g_get_monotonic_time() - call->start;
+	run->completed++;
+	if(NULL == payload || NULL != strstr(payload, "\"returnValue\":false"))
+		run->errors++;
+	g_free(call);
+
+	issue_next(run);
+
+	return true;
+}
+
+/**
+ * Send one request, a request failing to be sent only counting as an error
+ *
+ * @return FALSE if it could not be sent
+ */
+
+static gboolean issue_request(bench_run_t *run)
+{
+	LSError lserror;
+	bench_call_t *call = g_new0(bench_call_t, 1);
+	gchar *payload = request_payload(run->method, run->issued);
+	gboolean sent = TRUE;
+
+	LSErrorInit(&lserror);
+	call->run = run;
+	call->start = g_get_monotonic_time();
+	run->issued++;
+
+	if (LSCallOneReply(handle, run->method->uri, payload, reply_cb, call, NULL, &lserror))
+		g_ptr_array_add(run->calls, call);
+	else
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+		run->completed++;
+		run->errors++;
+		g_free(call);
+		sent = FALSE;
+	}
+	g_free(payload);
+
+	return sent;
+}
+
+/**
+ * Keep one request in flight in place of a finished one, or stop the run
+ * once every request finished
+ */
+
+static void issue_next(bench_run_t *run)
+{
+	while(run->issued < (guint) option_requests)
+	{
+		if(issue_request(run))
+			return;
+	}
+
+	if(run->completed == run->issued)
+		g_main_loop_quit(run->loop);
+}
+
+static gboolean run_timeout_cb(gpointer user_data)
+{
+	bench_run_t *run = user_data;
+
+	g_printerr("%u of %u %s requests did not complete\n", run->issued - run->completed, run->issued,
+			run->method->name);
+	g_main_loop_quit(run->loop);
+	return FALSE;
+}
+
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+	gint64 la = *(const gint64 *) a, lb = *(const gint64 *) b;
+	return (la > lb) - (la < lb);
+}
+
+static gint64 percentile(gint64 *sorted, guint count, guint pct)
+{
+	if(0 == count)
+		return 0;
+	return sorted[MIN(count - 1, (count * pct) / 100)];
+}
+
+static void run_method(const bench_method_t *method)
+{
+	bench_run_t run = { 0 };
+	process_usage_t before, after;
+	guint i;
+
+	run.method = method;
+	run.latencies = g_new0(gint64, option_requests);
+	run.calls = g_ptr_array_new();
+	run.loop = g_main_loop_new(NULL, FALSE);
+
+	guint64 calls_before = read_mock_counter("totalCalls");
+	read_process_usage(option_adapter_pid, &before);
+	gint64 start = g_get_monotonic_time();
+
+	for (i = 0; i < (guint) option_concurrency && run.issued < (guint) option_requests; i++)
+	{
+		/* a request failing to be sent is replaced right away */
+		while(run.issued < (guint) option_requests && !issue_request(&run))
+			;
+	}
+	if(run.completed < run.issued)
+	{
+		/* do not wait forever for requests which never get a reply */
+		g_timeout_add_seconds(BENCH_RUN_TIMEOUT, run_timeout_cb, &run);
+		g_main_loop_run(run.loop);
+		/* the timeout is gone already if it fired */
+		g_source_remove_by_user_data(&run);
+	}
+
+	gint64 elapsed = g_get_monotonic_time() - start;
+	read_process_usage(option_adapter_pid, &after);
+	guint64 calls_after = read_mock_counter("totalCalls");
+
+	qsort(run.latencies, run.replied, sizeof(gint64), compare_latency);
+
+	printf("{\"method\":\"%s\",\"services\":%d,\"requests\":%u,\"concurrency\":%d,"
+		"\"p50Us\":%" G_GINT64_FORMAT ",\"p99Us\":%" G_GINT64_FORMAT ",\"requestsPerSec\":%.1f,\"errors\":%u,"
+		"\"dbusCallsPerRequest\":%.2f,\"adapterCpuMsPerRequest\":%.3f,\"peakRssKb\":%" G_GUINT64_FORMAT "}\n",
+		method->name, option_services, run.completed, option_concurrency,
+		percentile(run.latencies, run.replied, 50), percentile(run.latencies, run.replied, 99),
+		elapsed > 0 ? run.completed * (gdouble) G_USEC_PER_SEC / elapsed : 0.0, run.errors,
+		run.completed ? (gdouble) (calls_after - calls_before) / run.completed : 0.0,
+		run.completed ? (after.cpu_ns - before.cpu_ns) / 1e6 / run.completed : 0.0,
+		after.peak_rss_kb);
+	fflush(stdout);
+
+	/* requests still waiting for a reply are detached from this run and
+	 * freed when the reply arrives */
+	for (i = 0; i < run.calls->len; i++)
+		((bench_call_t *) g_ptr_array_index(run.calls, i))->run = NULL;
+	g_ptr_array_free(run.calls, TRUE);
+
+	g_main_loop_unref(run.loop);
+	g_free(run.latencies);
+}
+
+static gboolean quit_loop_cb(gpointer user_data)
+{
+	g_main_loop_quit(user_data);
+	return FALSE;
+}
+
+/**
+ * Let the mock emit a signal storm and account the adapter's CPU time per signal
+ */
+
+static void run_signal_storm(void)
+{
+	process_usage_t before, after;
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+	guint64 signals_before = read_mock_counter("signalsEmitted");
+	read_process_usage(option_adapter_pid, &before);
+
+	kill(option_mock_pid, SIGUSR2);
+	/* give the adapter one extra second to drain its queue */
+	g_timeout_add_seconds(option_storm_seconds + 1, quit_loop_cb, loop);
+	g_main_loop_run(loop);
+
+	read_process_usage(option_adapter_pid, &after);
+	guint64 signals = read_mock_counter("signalsEmitted") - signals_before;
+
+	printf("{\"phase\":\"signalStorm\",\"services\":%d,\"signals\":%" G_GUINT64_FORMAT ","
+		"\"adapterCpuUsPerSignal\":%.2f,\"peakRssKb\":%" G_GUINT64_FORMAT "}\n",
+		option_services, signals,
+		signals ? (after.cpu_ns - before.cpu_ns) / 1e3 / signals : 0.0,
+		after.peak_rss_kb);
+	fflush(stdout);
+
+	g_main_loop_unref(loop);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	LSError lserror;
+	GMainLoop *mainloop;
+	gchar **names;
+	guint i, j;
+
+	context = g_option_context_new("- benchmark webos-connman-adapter end to end");
+	g_option_context_add_main_entries(context, option_entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if(option_requests <= 0 || option_concurrency <= 0)
+	{
+		g_printerr("requests and concurrency must be positive\n");
+		return 1;
+	}
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+
+	LSErrorInit(&lserror);
+	if (!LSRegister(NULL, &handle, &lserror) || !LSGmainAttach(handle, mainloop, &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+		return 1;
+	}
+
+	names = g_strsplit(option_methods ? option_methods : "findnetworks,getstatus,connect,setipv4", ",", -1);
+	for (i = 0; NULL != names[i]; i++)
+	{
+		for (j = 0; NULL != bench_methods[j].name; j++)
+		{
+			if(g_str_equal(bench_methods[j].name, names[i]))
+				break;
+		}
+		if(NULL == bench_methods[j].name)
+		{
+			g_printerr("Unknown method %s\n", names[i]);
+			continue;
+		}
+		run_method(&bench_methods[j]);
+	}
+	g_strfreev(names);
+
+	if(option_storm && option_mock_pid > 0)
+		run_signal_storm();
+
+	LSErrorInit(&lserror);
+	if (!LSUnregister(handle, &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+	g_main_loop_unref(mainloop);
+
+	return 0;
+}
@@ -0,0 +1,313 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  loadgen.c
+ *
+ * @brief Load generator calling the luna method handlers in-process
+ *
+ * Switches the adapter to the in-memory luna transport and fires requests
+ * and subscriptions straight at the com.palm.wifi and
+ * com.palm.connectionmanager method tables, so that handler cost can be
+ * measured without a hub. The handlers still talk to connman, so
+ * DBUS_SYSTEM_BUS_ADDRESS should point to a bus running mock-connman.
+ *
+ * Prints one JSON line per method plus one for the subscription fan-out.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "connman_manager.h"
+#include "connectionmanager_service.h"
+#include "wifi_service.h"
+#include "lunaservice_utils.h"
+#include "common.h"
+#include "logging.h"
+#include "microbench.h"
+
+PmLogContext gLogContext;
+
+/* Seconds to wait for all requests of one method */
+#define LOADGEN_RUN_TIMEOUT	60
+
+static gint option_requests = 10000;
+static gint option_concurrency = 64;
+static gint option_subscribers = 1000;
+static gint option_posts = 100;
+static gchar *option_methods = NULL;
+
+static GOptionEntry option_entries[] = {
+	{ "requests", 'n', 0, G_OPTION_ARG_INT, &option_requests, "Requests per method", "N" },
+	{ "concurrency", 'c', 0, G_OPTION_ARG_INT, &option_concurrency, "Requests issued per main loop iteration", "N" },
+	{ "subscribers", 's', 0, G_OPTION_ARG_INT, &option_subscribers, "Number of getstatus subscribers", "N" },
+	{ "posts", 'p', 0, G_OPTION_ARG_INT, &option_posts, "Status posts sent to the subscribers", "N" },
+	{ "methods", 'm', 0, G_OPTION_ARG_STRING, &option_methods,
+		"Comma separated service/method list (default wifi/getstatus,wifi/findnetworks,connectionmanager/getstatus)", "LIST" },
+	{ NULL }
+};
+
+typedef struct loadgen_run
+{
+	luna_service_category_t *category;
+	const gchar *method;
+	const gchar *payload;
+	guint issued;
+	guint completed;
+	guint errors;
+	gint64 *latencies;
+	GPtrArray *requests;
+	GMainLoop *loop;
+}loadgen_run_t;
+
+typedef struct loadgen_request
+{
+	loadgen_run_t *run;
+	gint64 start;
+	gboolean replied;
+}loadgen_request_t;
+
+static guint64 deliveries = 0;
+
+static luna_service_category_t *wifi_category = NULL;
+static luna_service_category_t *connectionmanager_category = NULL;
+
+static void request_reply_cb(LSMessage *message, const char *payload, gpointer user_data)
+{
+	loadgen_request_t *req = user_data;
+	loadgen_run_t *run = req->run;
+
+	if(req->replied || NULL == run)
+		return;
+
+	req->replied = TRUE;
+	run->latencies[run->completed++] = g_get_monotonic_time() - req->start;
+	if(NULL != strstr(payload, "\"returnValue\":false"))
+		run->errors++;
+
+	if(run->completed == (guint) option_requests)
+		g_main_loop_quit(run->loop);
+}
+
+static gboolean issue_requests_cb(gpointer user_data)
+{
+	loadgen_run_t *run = user_data;
+	guint i;
+
+	for (i = 0; i < (guint) option_concurrency && run->issued < (guint) option_requests; i++)
+	{
+		loadgen_request_t *req = g_new0(loadgen_request_t, 1);
+		req->run = run;
+		req->start = g_get_monotonic_time();
+		g_ptr_array_add(run->requests, req);
+
+		LSMessage *message = luna_service_memory_message_new(run->method, run->payload, false,
+								request_reply_cb, req);
+		run->issued++;
+		if(!luna_service_memory_call(NULL, run->category, message) && !req->replied)
+		{
+			run->latencies[run->completed++] = 0;
+			run->errors++;
+		}
+		luna_service_message_unref(message);
+	}
+
+	if(run->completed == (guint) option_requests)
+		g_main_loop_quit(run->loop);
+
+	return run->issued < (guint) option_requests;
+}
+
+static gboolean run_timeout_cb(gpointer user_data)
+{
+	loadgen_run_t *run = user_data;
+
+	g_printerr("%u of %u %s requests did not complete\n", run->issued - run->completed, run->issued, run->method);
+	g_main_loop_quit(run->loop);
+	return FALSE;
+}
+
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+	gint64 la = *(const gint64 *) a, lb = *(const gint64 *) b;
+	return (la > lb) - (la < lb);
+}
+
+static gint64 percentile(gint64 *sorted, guint count, guint pct)
+{
+	if(0 == count)
+		return 0;
+	return sorted[MIN(count - 1, (count * pct) / 100)];
+}
+
+static void run_method(const gchar *service, luna_service_category_t *category, const gchar *method)
+{
+	loadgen_run_t run = { 0 };
+
+	run.category = category;
+	run.method = method;
+	run.payload = "{}";
+	run.latencies = g_new0(gint64, option_requests);
+	run.requests = g_ptr_array_new_with_free_func(g_free);
+	run.loop = g_main_loop_new(NULL, FALSE);
+
+	gint64 start = g_get_monotonic_time();
+	g_idle_add(issue_requests_cb, &run);
+	/* do not wait forever for handlers which never reply */
+	guint timeout = g_timeout_add_seconds(LOADGEN_RUN_TIMEOUT, run_timeout_cb, &run);
+	g_main_loop_run(run.loop);
+	gint64 elapsed = g_get_monotonic_time() - start;
+	g_source_remove(timeout);
+
+	qsort(run.latencies, run.completed, sizeof(gint64), compare_latency);
+
+	printf("{\"method\":\"%s/%s\",\"requests\":%u,\"concurrency\":%d,\"p50Us\":%" G_GINT64_FORMAT ","
+		"\"p99Us\":%" G_GINT64_FORMAT ",\"requestsPerSec\":%.1f,\"errors\":%u}\n",
+		service, method, run.completed, option_concurrency,
+		percentile(run.latencies, run.completed, 50), percentile(run.latencies, run.completed, 99),
+		elapsed > 0 ? run.completed * (gdouble) G_USEC_PER_SEC / elapsed : 0.0, run.errors);
+	fflush(stdout);
+
+	/* stop issuing requests if the run timed out */
+	g_source_remove_by_user_data(&run);
+	g_main_loop_unref(run.loop);
+	/* requests still waiting for an asynchronous reply are leaked on purpose
+	 * and detached from this run */
+	if(run.completed != run.issued)
+	{
+		guint i;
+		for (i = 0; i < run.requests->len; i++)
+			((loadgen_request_t *) g_ptr_array_index(run.requests, i))->run = NULL;
+		g_ptr_array_set_free_func(run.requests, NULL);
+	}
+	g_ptr_array_free(run.requests, TRUE);
+	g_free(run.latencies);
+}
+
+static void subscriber_reply_cb(LSMessage *message, const char *payload, gpointer user_data)
+{
+	deliveries++;
+}
+
+/**
+ * Subscribe clients to connectionmanager/getstatus and time the status fan-out
+ */
+
+static void run_fanout(void)
+{
+	LSMessage **subscribers = g_new0(LSMessage *, option_subscribers);
+	gint i;
+
+	gint64 start = g_get_monotonic_time();
+	for (i = 0; i < option_subscribers; i++)
+	{
+		subscribers[i] = luna_service_memory_message_new(LUNA_METHOD_GETSTATUS, "{\"subscribe\":true}", true,
+								subscriber_reply_cb, NULL);
+		luna_service_memory_call(NULL, connectionmanager_category, subscribers[i]);
+	}
+	gint64 subscribe_elapsed = g_get_monotonic_time() - start;
+
+	deliveries = 0;
+	start = g_get_monotonic_time();
+	for (i = 0; i < option_posts; i++)
+		connectionmanager_send_status();
+	/* Posts are delivered from background sources, newer ones superseding the rest of older ones */
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+	gint64 post_elapsed = g_get_monotonic_time() - start;
+
+	printf("{\"phase\":\"fanout\",\"subscribers\":%d,\"posts\":%d,\"subscribeUs\":%.2f,"
+		"\"usPerPost\":%.2f,\"usPerDelivery\":%.3f,\"deliveries\":%" G_GUINT64_FORMAT "}\n",
+		option_subscribers, option_posts,
+		option_subscribers ? (gdouble) subscribe_elapsed / option_subscribers : 0.0,
+		option_posts ? (gdouble) post_elapsed / option_posts : 0.0,
+		deliveries ? (gdouble) post_elapsed / deliveries : 0.0, deliveries);
+	fflush(stdout);
+
+	for (i = 0; i < option_subscribers; i++)
+	{
+		luna_service_memory_message_cancel(subscribers[i]);
+		luna_service_message_unref(subscribers[i]);
+	}
+	g_free(subscribers);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	gchar **names;
+	guint i;
+
+	context = g_option_context_new("- drive the adapter's luna handlers in-process");
+	g_option_context_add_main_entries(context, option_entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if(option_requests <= 0 || option_concurrency <= 0 || option_subscribers < 0 || option_posts < 0)
+	{
+		g_printerr("Invalid arguments\n");
+		return 1;
+	}
+
+	(void)PmLogGetContext("webos-connman-adapter-loadgen", &gLogContext);
+
+	luna_service_set_transport(&luna_service_transport_memory);
+
+	manager = connman_manager_new();
+	if(NULL == manager)
+	{
+		g_printerr("Could not reach connman; is mock-connman running on DBUS_SYSTEM_BUS_ADDRESS?\n");
+		return 1;
+	}
+
+	wifi_category = luna_service_category_new(WIFI_LUNA_SERVICE_NAME, microbench_wifi_methods());
+	connectionmanager_category = luna_service_category_new(CONNECTIONMANAGER_LUNA_SERVICE_NAME,
+					microbench_connectionmanager_methods());
+
+	names = g_strsplit(option_methods ? option_methods :
+			"wifi/getstatus,wifi/findnetworks,connectionmanager/getstatus", ",", -1);
+	for (i = 0; NULL != names[i]; i++)
+	{
+		gchar **parts = g_strsplit(names[i], "/", 2);
+
+		if(g_strv_length(parts) == 2 && g_str_equal(parts[0], "wifi"))
+			run_method(parts[0], wifi_category, parts[1]);
+		else if(g_strv_length(parts) == 2 && g_str_equal(parts[0], "connectionmanager"))
+			run_method(parts[0], connectionmanager_category, parts[1]);
+		else
+			g_printerr("Unknown method %s\n", names[i]);
+
+		g_strfreev(parts);
+	}
+	g_strfreev(names);
+
+	run_fanout();
+
+	connman_manager_free(manager);
+	manager = NULL;
+
+	return 0;
+}
@@ -0,0 +1,34 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  micro_connectionmanager_service.c
+ *
+ * @brief Compiles connectionmanager_service.c into the benchmarks and
+ *        exposes its method table
+ *
+ */
+
+#include "connectionmanager_service.c"
+
+#include "microbench.h"
+
+const LSMethod *microbench_connectionmanager_methods(void)
+{
+	return connectionmanager_methods;
+}
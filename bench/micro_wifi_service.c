@@ -0,0 +1,59 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  micro_wifi_service.c
+ *
+ * @brief Compiles wifi_service.c into the micro-benchmark and exposes its
+ *        JSON building helpers and method table
+ *
+ */
+
+#include "wifi_service.c"
+
+#include "microbench.h"
+
+void microbench_set_wifi_services(GSList *services)
+{
+	if(NULL == manager)
+		manager = g_new0(connman_manager_t, 1);
+	manager->wifi_services = services;
+	network_state_invalidate();
+}
+
+bool microbench_populate_wifi_networks(jvalue_ref *reply)
+{
+	network_state_t *state = network_state_acquire();
+	bool networks_found = add_network_list(state, reply);
+	network_state_release(state);
+
+	return networks_found;
+}
+
+void microbench_add_service(connman_service_t *service, jvalue_ref *network)
+{
+	network_service_state_t *info = network_service_state_new(service);
+	wifi_profile_t *profile = get_profile_by_ssid(service->name);
+	add_network_info(info, (NULL != profile) ? (gint) profile->profile_id : -1, network);
+	network_service_state_unref(info);
+}
+
+const LSMethod *microbench_wifi_methods(void)
+{
+	return wifi_methods;
+}
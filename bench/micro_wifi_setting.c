@@ -0,0 +1,49 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  micro_wifi_setting.c
+ *
+ * @brief Compiles wifi_setting.c into the micro-benchmark
+ *
+ * store_wifi_setting() is renamed so that creating and deleting profiles
+ * while setting up a benchmark never writes to the real luna-prefs store.
+ */
+
+#define store_wifi_setting wifi_setting_store_unused
+#include "wifi_setting.c"
+#undef store_wifi_setting
+
+#include "microbench.h"
+
+gboolean store_wifi_setting(wifi_setting_type_t setting, void *data)
+{
+	return TRUE;
+}
+
+gchar *microbench_add_wifi_profile_list(void)
+{
+	if(profile_list_is_empty())
+		return NULL;
+
+	GPtrArray *profiles = copy_wifi_profile_list();
+	gchar *profile_list_str = serialize_wifi_profile_list(profiles);
+	g_ptr_array_free(profiles, TRUE);
+
+	return profile_list_str;
+}
@@ -0,0 +1,304 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  microbench.c
+ *
+ * @brief Micro-benchmarks for the adapter's per-signal and per-store paths
+ *
+ * Links the adapter's translation units directly and times
+ *
+ *  - connman_service_update_properties() on a full service property dict
+ *  - snapshotting and building the findnetworks payload for N access points,
+ *    for the whole list (populate_wifi_networks) and one service (add_service)
+ *  - get_profile_by_ssid() with N profiles
+ *  - copying and encrypting/serializing the profile list
+ *    (serialize_wifi_profile_list) with N profiles
+ *
+ * Every result is printed as one JSON line with ns/op and allocations/op.
+ * Allocations are counted by wrapping malloc, calloc and realloc.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+#include <pbnjson.h>
+
+#include "connman_service.h"
+#include "wifi_profile.h"
+#include "logging.h"
+#include "microbench.h"
+
+PmLogContext gLogContext;
+
+static gint option_iterations = 1000;
+static gchar *option_sizes = NULL;
+
+static GOptionEntry option_entries[] = {
+	{ "iterations", 'i', 0, G_OPTION_ARG_INT, &option_iterations, "Iterations per benchmark", "N" },
+	{ "sizes", 'n', 0, G_OPTION_ARG_STRING, &option_sizes, "Comma separated AP/profile counts (default 10,100,1000)", "LIST" },
+	{ NULL }
+};
+
+/* Allocation counting */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static guint64 alloc_count = 0;
+
+void *malloc(size_t size)
+{
+	__atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+static guint64 now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (guint64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+typedef void (*bench_fn)(guint iteration, gpointer data);
+
+static void run_bench(const gchar *name, guint size, bench_fn fn, gpointer data)
+{
+	guint i;
+
+	/* warm up caches and lazily initialized library state */
+	fn(0, data);
+
+	guint64 allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+	guint64 start = now_ns();
+	for (i = 0; i < (guint) option_iterations; i++)
+		fn(i, data);
+	guint64 elapsed = now_ns() - start;
+	allocs = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED) - allocs;
+
+	printf("{\"benchmark\":\"%s\",\"n\":%u,\"iterations\":%d,\"nsPerOp\":%.1f,\"allocsPerOp\":%.2f}\n",
+		name, size, option_iterations,
+		(gdouble) elapsed / option_iterations, (gdouble) allocs / option_iterations);
+	fflush(stdout);
+}
+
+/**
+ * Build the property dict connman sends for a wifi service
+ */
+
+static GVariant *service_properties_new(guint index)
+{
+	GVariantBuilder builder, ipv4, ethernet;
+	const gchar *security[] = { index % 2 ? "psk" : "none", NULL };
+	const gchar *nameservers[] = { "192.168.1.1", "8.8.8.8", NULL };
+	gchar *name = g_strdup_printf("mock-ap-%u", index);
+
+	g_variant_builder_init(&ipv4, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&ipv4, "{sv}", "Method", g_variant_new_string("dhcp"));
+	g_variant_builder_add(&ipv4, "{sv}", "Address", g_variant_new_string("192.168.1.23"));
+	g_variant_builder_add(&ipv4, "{sv}", "Netmask", g_variant_new_string("255.255.255.0"));
+	g_variant_builder_add(&ipv4, "{sv}", "Gateway", g_variant_new_string("192.168.1.1"));
+
+	g_variant_builder_init(&ethernet, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&ethernet, "{sv}", "Method", g_variant_new_string("auto"));
+	g_variant_builder_add(&ethernet, "{sv}", "Interface", g_variant_new_string("wlan0"));
+	g_variant_builder_add(&ethernet, "{sv}", "Address", g_variant_new_string("00:11:22:33:44:55"));
+	g_variant_builder_add(&ethernet, "{sv}", "MTU", g_variant_new_uint16(1500));
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&builder, "{sv}", "Type", g_variant_new_string("wifi"));
+	g_variant_builder_add(&builder, "{sv}", "Security", g_variant_new_strv(security, -1));
+	g_variant_builder_add(&builder, "{sv}", "State", g_variant_new_string("idle"));
+	g_variant_builder_add(&builder, "{sv}", "Strength", g_variant_new_byte(30 + index % 70));
+	g_variant_builder_add(&builder, "{sv}", "Favorite", g_variant_new_boolean(FALSE));
+	g_variant_builder_add(&builder, "{sv}", "Immutable", g_variant_new_boolean(FALSE));
+	g_variant_builder_add(&builder, "{sv}", "AutoConnect", g_variant_new_boolean(FALSE));
+	g_variant_builder_add(&builder, "{sv}", "Name", g_variant_new_string(name));
+	g_variant_builder_add(&builder, "{sv}", "IPv4", g_variant_builder_end(&ipv4));
+	g_variant_builder_add(&builder, "{sv}", "Nameservers", g_variant_new_strv(nameservers, -1));
+	g_variant_builder_add(&builder, "{sv}", "Ethernet", g_variant_builder_end(&ethernet));
+	g_free(name);
+
+	return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static connman_service_t *bench_service_new(guint index)
+{
+	connman_service_t *service = g_new0(connman_service_t, 1);
+	GVariant *properties = service_properties_new(index);
+
+	service->path = g_strdup_printf("/net/connman/service/wifi_mock_%u_managed_psk", index);
+	connman_service_update_properties(service, properties);
+	g_variant_unref(properties);
+
+	return service;
+}
+
+/* Benchmark bodies */
+
+typedef struct bench_state
+{
+	GSList *services;
+	GPtrArray *service_array;
+	GVariant *properties;
+	connman_service_t *service;
+	gchar **ssids;
+	guint size;
+}bench_state_t;
+
+static void bench_update_properties(guint iteration, gpointer data)
+{
+	bench_state_t *state = data;
+	connman_service_update_properties(state->service, state->properties);
+}
+
+static void bench_populate_wifi_networks(guint iteration, gpointer data)
+{
+	jvalue_ref reply = jobject_create();
+	microbench_populate_wifi_networks(&reply);
+	j_release(&reply);
+}
+
+static void bench_add_service(guint iteration, gpointer data)
+{
+	bench_state_t *state = data;
+	connman_service_t *service = g_ptr_array_index(state->service_array, iteration % state->size);
+	jvalue_ref network = jobject_create();
+	microbench_add_service(service, &network);
+	j_release(&network);
+}
+
+static void bench_get_profile_by_ssid(guint iteration, gpointer data)
+{
+	bench_state_t *state = data;
+	(void) get_profile_by_ssid(state->ssids[iteration % state->size]);
+}
+
+static void bench_add_wifi_profile_list(guint iteration, gpointer data)
+{
+	g_free(microbench_add_wifi_profile_list());
+}
+
+/**
+ * Create size access points and size profiles, half of which match an AP
+ */
+
+static void setup_state(bench_state_t *state, guint size)
+{
+	guint i;
+
+	memset(state, 0, sizeof(*state));
+	state->size = size;
+	state->ssids = g_new0(gchar *, size + 1);
+	state->service_array = g_ptr_array_new();
+
+	for (i = 0; i < size; i++)
+	{
+		connman_service_t *service = bench_service_new(i);
+		state->services = g_slist_prepend(state->services, service);
+		g_ptr_array_add(state->service_array, service);
+		state->ssids[i] = (i % 2) ? g_strdup_printf("remembered-%u", i) : g_strdup_printf("mock-ap-%u", i);
+		create_new_profile(state->ssids[i], NULL, FALSE);
+	}
+	state->services = g_slist_reverse(state->services);
+	microbench_set_wifi_services(state->services);
+}
+
+static void teardown_state(bench_state_t *state)
+{
+	wifi_profile_t *profile;
+
+	microbench_set_wifi_services(NULL);
+	g_slist_foreach(state->services, (GFunc) connman_service_free, NULL);
+	g_slist_free(state->services);
+	g_ptr_array_free(state->service_array, TRUE);
+	while(NULL != (profile = get_next_profile(NULL)))
+		delete_profile(profile);
+	g_strfreev(state->ssids);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	bench_state_t state;
+	gchar **sizes;
+	guint i;
+
+	/* make GSlice allocations visible to the malloc counters */
+	g_setenv("G_SLICE", "always-malloc", TRUE);
+
+	context = g_option_context_new("- micro-benchmarks for webos-connman-adapter");
+	g_option_context_add_main_entries(context, option_entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if(option_iterations <= 0)
+	{
+		g_printerr("iterations must be positive\n");
+		return 1;
+	}
+
+	(void)PmLogGetContext("webos-connman-adapter-bench", &gLogContext);
+
+	/* update_properties does not depend on the number of APs */
+	memset(&state, 0, sizeof(state));
+	state.service = bench_service_new(0);
+	state.properties = service_properties_new(1);
+	run_bench("connman_service_update_properties", 1, bench_update_properties, &state);
+	g_variant_unref(state.properties);
+	connman_service_free(state.service, NULL);
+
+	sizes = g_strsplit(option_sizes ? option_sizes : "10,100,1000", ",", -1);
+	for (i = 0; NULL != sizes[i]; i++)
+	{
+		guint size = g_ascii_strtoull(sizes[i], NULL, 10);
+		if(0 == size)
+			continue;
+
+		setup_state(&state, size);
+		run_bench("populate_wifi_networks", size, bench_populate_wifi_networks, &state);
+		run_bench("add_service", size, bench_add_service, &state);
+		run_bench("get_profile_by_ssid", size, bench_get_profile_by_ssid, &state);
+		run_bench("add_wifi_profile_list", size, bench_add_wifi_profile_list, &state);
+		teardown_state(&state);
+	}
+	g_strfreev(sizes);
+
+	return 0;
+}
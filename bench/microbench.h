@@ -0,0 +1,48 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  microbench.h
+ *
+ * @brief Entry points into static adapter functions for the micro-benchmarks
+ *
+ */
+
+#ifndef _MICROBENCH_H_
+#define _MICROBENCH_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include <pbnjson.h>
+#include <luna-service2/lunaservice.h>
+
+#include "connman_service.h"
+
+/* micro_wifi_service.c */
+extern void microbench_set_wifi_services(GSList *services);
+extern bool microbench_populate_wifi_networks(jvalue_ref *reply);
+extern void microbench_add_service(connman_service_t *service, jvalue_ref *network);
+extern const LSMethod *microbench_wifi_methods(void);
+
+/* micro_connectionmanager_service.c */
+extern const LSMethod *microbench_connectionmanager_methods(void);
+
+/* micro_wifi_setting.c */
+extern gchar *microbench_add_wifi_profile_list(void);
+
+#endif /* _MICROBENCH_H_ */
@@ -0,0 +1,868 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ * @file  mock_connman.c
+ *
+ * @brief Minimal stand-in for the connman daemon used by the benchmarks
+ *
+ * Owns "net.connman" on the bus selected through DBUS_SYSTEM_BUS_ADDRESS and
+ * exports a manager, a wifi and an ethernet technology and a configurable
+ * number of synthetic wifi services. Every method call received is counted
+ * so the benchmark driver can compute D-Bus calls per request.
+ *
+ * Usage:
+ *   mock-connman --services 1000 --stats-file /tmp/mock-stats.json
+ *
+ * SIGUSR1 writes the call statistics to the stats file, SIGUSR2 starts a
+ * signal storm of --storm-rate signals per second lasting --storm-seconds.
+ *
+ * With --replay SIGUSR2 instead plays back a trace recorded by
+ * webos-connman-adapter --record, at the recorded pace scaled by
+ * --replay-speed or as fast as possible with --replay-speed 0. Recorded
+ * signals are emitted as they were; recorded replies to GetServices,
+ * GetTechnologies and GetProperties are turned into the ServicesChanged,
+ * TechnologyAdded and PropertyChanged signals carrying the same state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+
+#include "connman-interface.h"
+#include "connman_trace.h"
+
+#define MOCK_SERVICE_PATH_PREFIX	"/net/connman/service/"
+#define MOCK_TECHNOLOGY_PATH_PREFIX	"/net/connman/technology/"
+
+/* Time spent in each intermediate state while connecting */
+#define MOCK_STATE_STEP_MS		20
+
+/* Interval in which the signal storm emits a batch of signals */
+#define MOCK_STORM_TICK_MS		10
+
+/* Messages replayed per main loop iteration when replaying as fast as possible */
+#define MOCK_REPLAY_BATCH		64
+
+typedef struct mock_service
+{
+	gchar *path;
+	gchar *name;
+	gchar *type;
+	gchar *state;
+	guchar strength;
+	gboolean secured;
+	guint index;
+	ConnmanInterfaceService *skeleton;
+}mock_service_t;
+
+typedef struct mock_replay_record
+{
+	guint64 timestamp;
+	GDBusMessage *message;
+}mock_replay_record_t;
+
+typedef struct mock_technology
+{
+	gchar *path;
+	gchar *type;
+	gchar *name;
+	gboolean powered;
+	ConnmanInterfaceTechnology *skeleton;
+}mock_technology_t;
+
+static GMainLoop *mainloop = NULL;
+static GDBusConnection *connection = NULL;
+static ConnmanInterfaceManager *manager_skeleton = NULL;
+
+static GPtrArray *services = NULL;
+static GPtrArray *technologies = NULL;
+static gchar *manager_state = NULL;
+static gboolean offline_mode = FALSE;
+
+static GHashTable *call_counts = NULL;
+static guint64 total_calls = 0;
+static guint64 signals_emitted = 0;
+
+static gint option_services = 100;
+static gchar *option_stats_file = NULL;
+static gint option_storm_rate = 1000;
+static gint option_storm_seconds = 5;
+
+static gchar *option_replay_file = NULL;
+static gdouble option_replay_speed = 1.0;
+
+static gint64 storm_end_time = 0;
+static guint storm_source = 0;
+
+static GPtrArray *replay_records = NULL;
+static GHashTable *replay_calls = NULL;
+static guint replay_next = 0;
+static gint64 replay_start_time = 0;
+static guint replay_source = 0;
+
+static GOptionEntry option_entries[] = {
+	{ "services", 'n', 0, G_OPTION_ARG_INT, &option_services, "Number of synthetic wifi services", "N" },
+	{ "stats-file", 's', 0, G_OPTION_ARG_FILENAME, &option_stats_file, "File the call statistics are written to", "PATH" },
+	{ "storm-rate", 'r', 0, G_OPTION_ARG_INT, &option_storm_rate, "Signals per second emitted during a storm", "RATE" },
+	{ "storm-seconds", 'd', 0, G_OPTION_ARG_INT, &option_storm_seconds, "Duration of a signal storm", "SECONDS" },
+	{ "replay", 0, 0, G_OPTION_ARG_FILENAME, &option_replay_file, "Trace replayed on SIGUSR2 instead of a storm", "PATH" },
+	{ "replay-speed", 0, 0, G_OPTION_ARG_DOUBLE, &option_replay_speed, "Replay speed factor, 0 for as fast as possible", "FACTOR" },
+	{ NULL }
+};
+
+/**
+ * Account one received method call
+ */
+
+static void count_call(const gchar *member)
+{
+	gpointer count = g_hash_table_lookup(call_counts, member);
+	g_hash_table_replace(call_counts, g_strdup(member), GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+	total_calls++;
+}
+
+static GVariant *string_dict_entry(const gchar *key, const gchar *value)
+{
+	return g_variant_new("{sv}", key, g_variant_new_string(value));
+}
+
+/**
+ * Build the property dictionary of a service the way connman reports it
+ */
+
+static GVariant *service_properties(mock_service_t *service)
+{
+	GVariantBuilder builder, sub;
+	guint index = service->index;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+	if(NULL != service->name)
+		g_variant_builder_add_value(&builder, string_dict_entry("Name", service->name));
+	g_variant_builder_add_value(&builder, string_dict_entry("Type", service->type));
+	g_variant_builder_add_value(&builder, string_dict_entry("State", service->state));
+	g_variant_builder_add(&builder, "{sv}", "Strength", g_variant_new_byte(service->strength));
+
+	const gchar *security[] = { service->secured ? "psk" : "none", NULL };
+	g_variant_builder_add(&builder, "{sv}", "Security", g_variant_new_strv(security, -1));
+	g_variant_builder_add(&builder, "{sv}", "AutoConnect", g_variant_new_boolean(FALSE));
+	g_variant_builder_add(&builder, "{sv}", "Immutable", g_variant_new_boolean(FALSE));
+	g_variant_builder_add(&builder, "{sv}", "Favorite", g_variant_new_boolean(FALSE));
+
+	gchar *address = g_strdup_printf("02:00:00:%02X:%02X:%02X", (index >> 16) & 0xff, (index >> 8) & 0xff, index & 0xff);
+	g_variant_builder_init(&sub, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add_value(&sub, string_dict_entry("Interface", g_str_equal(service->type, "wifi") ? "wlan0" : "eth0"));
+	g_variant_builder_add_value(&sub, string_dict_entry("Address", address));
+	g_variant_builder_add(&builder, "{sv}", "Ethernet", g_variant_builder_end(&sub));
+	g_free(address);
+
+	g_variant_builder_init(&sub, G_VARIANT_TYPE("a{sv}"));
+	if(g_str_equal(service->state, "ready") || g_str_equal(service->state, "online"))
+	{
+		g_variant_builder_add_value(&sub, string_dict_entry("Method", "dhcp"));
+		g_variant_builder_add_value(&sub, string_dict_entry("Address", "192.168.1.10"));
+		g_variant_builder_add_value(&sub, string_dict_entry("Netmask", "255.255.255.0"));
+		g_variant_builder_add_value(&sub, string_dict_entry("Gateway", "192.168.1.1"));
+	}
+	g_variant_builder_add(&builder, "{sv}", "IPv4", g_variant_builder_end(&sub));
+
+	const gchar *nameservers[] = { "192.168.1.1", NULL };
+	g_variant_builder_add(&builder, "{sv}", "Nameservers", g_variant_new_strv(nameservers, -1));
+
+	return g_variant_builder_end(&builder);
+}
+
+static GVariant *technology_properties(mock_technology_t *technology)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add_value(&builder, string_dict_entry("Name", technology->name));
+	g_variant_builder_add_value(&builder, string_dict_entry("Type", technology->type));
+	g_variant_builder_add(&builder, "{sv}", "Powered", g_variant_new_boolean(technology->powered));
+	g_variant_builder_add(&builder, "{sv}", "Connected", g_variant_new_boolean(FALSE));
+
+	return g_variant_builder_end(&builder);
+}
+
+static GVariant *manager_properties(void)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add_value(&builder, string_dict_entry("State", manager_state));
+	g_variant_builder_add(&builder, "{sv}", "OfflineMode", g_variant_new_boolean(offline_mode));
+
+	return g_variant_builder_end(&builder);
+}
+
+static GVariant *all_services(void)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+	for (i = 0; i < services->len; i++)
+	{
+		mock_service_t *service = g_ptr_array_index(services, i);
+		g_variant_builder_add(&builder, "(o@a{sv})", service->path, service_properties(service));
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+static void set_manager_state(const gchar *state)
+{
+	if(!g_strcmp0(manager_state, state))
+		return;
+
+	g_free(manager_state);
+	manager_state = g_strdup(state);
+	connman_interface_manager_emit_property_changed(manager_skeleton, "State",
+			g_variant_new_variant(g_variant_new_string(state)));
+	signals_emitted++;
+}
+
+static void set_service_state(mock_service_t *service, const gchar *state)
+{
+	g_free(service->state);
+	service->state = g_strdup(state);
+	connman_interface_service_emit_property_changed(service->skeleton, "State",
+			g_variant_new_variant(g_variant_new_string(state)));
+	signals_emitted++;
+}
+
+/**
+ * Walk a connecting service through association, configuration, ready and online
+ */
+
+static gboolean advance_service_state(gpointer user_data)
+{
+	mock_service_t *service = user_data;
+
+	if(g_str_equal(service->state, "association"))
+		set_service_state(service, "configuration");
+	else if(g_str_equal(service->state, "configuration"))
+	{
+		set_service_state(service, "ready");
+		set_manager_state("ready");
+	}
+	else if(g_str_equal(service->state, "ready"))
+	{
+		set_service_state(service, "online");
+		set_manager_state("online");
+		return FALSE;
+	}
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+static gboolean handle_service_get_properties(ConnmanInterfaceService *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Service.GetProperties");
+	connman_interface_service_complete_get_properties(object, invocation, service_properties(user_data));
+	return TRUE;
+}
+
+static gboolean handle_service_set_property(ConnmanInterfaceService *object, GDBusMethodInvocation *invocation,
+			const gchar *name, GVariant *value, gpointer user_data)
+{
+	count_call("Service.SetProperty");
+	connman_interface_service_complete_set_property(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_service_connect(ConnmanInterfaceService *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	mock_service_t *service = user_data;
+	guint i;
+
+	count_call("Service.Connect");
+
+	if(g_str_equal(service->state, "ready") || g_str_equal(service->state, "online"))
+	{
+		g_dbus_method_invocation_return_dbus_error(invocation, "net.connman.Error.AlreadyConnected", "Already connected");
+		return TRUE;
+	}
+
+	/* connman only keeps a single wifi service connected */
+	for (i = 0; i < services->len; i++)
+	{
+		mock_service_t *other = g_ptr_array_index(services, i);
+		if(other != service && g_str_equal(other->type, service->type) && !g_str_equal(other->state, "idle"))
+			set_service_state(other, "idle");
+	}
+
+	set_service_state(service, "association");
+	g_timeout_add(MOCK_STATE_STEP_MS, advance_service_state, service);
+
+	connman_interface_service_complete_connect(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_service_disconnect(ConnmanInterfaceService *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Service.Disconnect");
+	set_service_state(user_data, "idle");
+	connman_interface_service_complete_disconnect(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_service_remove(ConnmanInterfaceService *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Service.Remove");
+	set_service_state(user_data, "idle");
+	connman_interface_service_complete_remove(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_technology_get_properties(ConnmanInterfaceTechnology *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Technology.GetProperties");
+	connman_interface_technology_complete_get_properties(object, invocation, technology_properties(user_data));
+	return TRUE;
+}
+
+static gboolean handle_technology_set_property(ConnmanInterfaceTechnology *object, GDBusMethodInvocation *invocation,
+			const gchar *name, GVariant *value, gpointer user_data)
+{
+	mock_technology_t *technology = user_data;
+
+	count_call("Technology.SetProperty");
+
+	if(g_str_equal(name, "Powered"))
+	{
+		GVariant *v = g_variant_get_variant(value);
+		technology->powered = g_variant_get_boolean(v);
+		g_variant_unref(v);
+		connman_interface_technology_emit_property_changed(object, "Powered",
+				g_variant_new_variant(g_variant_new_boolean(technology->powered)));
+		signals_emitted++;
+	}
+
+	connman_interface_technology_complete_set_property(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_technology_scan(ConnmanInterfaceTechnology *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Technology.Scan");
+
+	/* A real scan reports every service again with fresh properties */
+	const gchar *removed[] = { NULL };
+	connman_interface_manager_emit_services_changed(manager_skeleton, all_services(), removed);
+	signals_emitted++;
+
+	connman_interface_technology_complete_scan(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_manager_get_properties(ConnmanInterfaceManager *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Manager.GetProperties");
+	connman_interface_manager_complete_get_properties(object, invocation, manager_properties());
+	return TRUE;
+}
+
+static gboolean handle_manager_set_property(ConnmanInterfaceManager *object, GDBusMethodInvocation *invocation,
+			const gchar *name, GVariant *value, gpointer user_data)
+{
+	count_call("Manager.SetProperty");
+
+	if(g_str_equal(name, "OfflineMode"))
+	{
+		GVariant *v = g_variant_get_variant(value);
+		offline_mode = g_variant_get_boolean(v);
+		g_variant_unref(v);
+	}
+
+	connman_interface_manager_complete_set_property(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_manager_get_services(ConnmanInterfaceManager *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	count_call("Manager.GetServices");
+	connman_interface_manager_complete_get_services(object, invocation, all_services());
+	return TRUE;
+}
+
+static gboolean handle_manager_get_technologies(ConnmanInterfaceManager *object, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	count_call("Manager.GetTechnologies");
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+	for (i = 0; i < technologies->len; i++)
+	{
+		mock_technology_t *technology = g_ptr_array_index(technologies, i);
+		g_variant_builder_add(&builder, "(o@a{sv})", technology->path, technology_properties(technology));
+	}
+
+	connman_interface_manager_complete_get_technologies(object, invocation, g_variant_builder_end(&builder));
+	return TRUE;
+}
+
+static gboolean handle_manager_register_agent(ConnmanInterfaceManager *object, GDBusMethodInvocation *invocation,
+			const gchar *path, gpointer user_data)
+{
+	count_call("Manager.RegisterAgent");
+	connman_interface_manager_complete_register_agent(object, invocation);
+	return TRUE;
+}
+
+static gboolean handle_manager_unregister_agent(ConnmanInterfaceManager *object, GDBusMethodInvocation *invocation,
+			const gchar *path, gpointer user_data)
+{
+	count_call("Manager.UnregisterAgent");
+	connman_interface_manager_complete_unregister_agent(object, invocation);
+	return TRUE;
+}
+
+static void export_object(gpointer skeleton, const gchar *path)
+{
+	GError *error = NULL;
+
+	if (!g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skeleton), connection, path, &error))
+	{
+		g_printerr("Could not export %s: %s\n", path, error->message);
+		g_error_free(error);
+	}
+}
+
+static mock_service_t *add_service(const gchar *type, const gchar *name, guchar strength, gboolean secured)
+{
+	mock_service_t *service = g_new0(mock_service_t, 1);
+	guint index = services->len;
+
+	service->index = index;
+	service->name = g_strdup(name);
+	service->type = g_strdup(type);
+	service->state = g_strdup("idle");
+	service->strength = strength;
+	service->secured = secured;
+	service->path = g_strdup_printf(MOCK_SERVICE_PATH_PREFIX "%s_mock_%u_%s", type, index, secured ? "managed_psk" : "managed_none");
+	service->skeleton = connman_interface_service_skeleton_new();
+
+	g_signal_connect(service->skeleton, "handle-get-properties", G_CALLBACK(handle_service_get_properties), service);
+	g_signal_connect(service->skeleton, "handle-set-property", G_CALLBACK(handle_service_set_property), service);
+	g_signal_connect(service->skeleton, "handle-connect", G_CALLBACK(handle_service_connect), service);
+	g_signal_connect(service->skeleton, "handle-disconnect", G_CALLBACK(handle_service_disconnect), service);
+	g_signal_connect(service->skeleton, "handle-remove", G_CALLBACK(handle_service_remove), service);
+
+	export_object(service->skeleton, service->path);
+	g_ptr_array_add(services, service);
+
+	return service;
+}
+
+static void add_technology(const gchar *type, const gchar *name)
+{
+	mock_technology_t *technology = g_new0(mock_technology_t, 1);
+
+	technology->type = g_strdup(type);
+	technology->name = g_strdup(name);
+	technology->powered = TRUE;
+	technology->path = g_strconcat(MOCK_TECHNOLOGY_PATH_PREFIX, type, NULL);
+	technology->skeleton = connman_interface_technology_skeleton_new();
+
+	g_signal_connect(technology->skeleton, "handle-get-properties", G_CALLBACK(handle_technology_get_properties), technology);
+	g_signal_connect(technology->skeleton, "handle-set-property", G_CALLBACK(handle_technology_set_property), technology);
+	g_signal_connect(technology->skeleton, "handle-scan", G_CALLBACK(handle_technology_scan), technology);
+
+	export_object(technology->skeleton, technology->path);
+	g_ptr_array_add(technologies, technology);
+}
+
+/**
+ * Emit a batch of Strength changes, and every tenth batch a ServicesChanged
+ * carrying the changed services, until the storm is over
+ */
+
+static gboolean storm_tick_cb(gpointer user_data)
+{
+	static guint tick = 0;
+	GVariantBuilder changed;
+	guint per_tick = MAX(1, option_storm_rate * MOCK_STORM_TICK_MS / 1000);
+	guint i;
+
+	if(g_get_monotonic_time() >= storm_end_time)
+	{
+		storm_source = 0;
+		return FALSE;
+	}
+
+	g_variant_builder_init(&changed, G_VARIANT_TYPE("a(oa{sv})"));
+	for (i = 0; i < per_tick; i++)
+	{
+		mock_service_t *service = g_ptr_array_index(services, g_random_int_range(0, services->len));
+		service->strength = (guchar) g_random_int_range(10, 100);
+		connman_interface_service_emit_property_changed(service->skeleton, "Strength",
+				g_variant_new_variant(g_variant_new_byte(service->strength)));
+		signals_emitted++;
+		g_variant_builder_add(&changed, "(o@a{sv})", service->path, service_properties(service));
+	}
+
+	if((++tick % 10) == 0)
+	{
+		const gchar *removed[] = { NULL };
+		connman_interface_manager_emit_services_changed(manager_skeleton, g_variant_builder_end(&changed), removed);
+		signals_emitted++;
+	}
+	else
+		g_variant_builder_clear(&changed);
+
+	return TRUE;
+}
+
+static gboolean start_storm_cb(gpointer user_data)
+{
+	storm_end_time = g_get_monotonic_time() + (gint64) option_storm_seconds * G_USEC_PER_SEC;
+	if(0 == storm_source)
+		storm_source = g_timeout_add(MOCK_STORM_TICK_MS, storm_tick_cb, NULL);
+	return TRUE;
+}
+
+/**
+ * Load a trace written by webos-connman-adapter --record
+ */
+
+static gboolean load_replay_trace(const gchar *path)
+{
+	gchar *contents = NULL;
+	gsize length = 0, offset;
+	GError *error = NULL;
+	guint32 version;
+
+	if (!g_file_get_contents(path, &contents, &length, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	offset = CONNMAN_TRACE_MAGIC_LEN + sizeof(version);
+	if(length < offset || memcmp(contents, CONNMAN_TRACE_MAGIC, CONNMAN_TRACE_MAGIC_LEN))
+	{
+		g_printerr("%s is not a connman trace\n", path);
+		g_free(contents);
+		return FALSE;
+	}
+
+	memcpy(&version, contents + CONNMAN_TRACE_MAGIC_LEN, sizeof(version));
+	if(version != CONNMAN_TRACE_VERSION)
+	{
+		g_printerr("Unsupported trace version %u\n", version);
+		g_free(contents);
+		return FALSE;
+	}
+
+	replay_records = g_ptr_array_new();
+	while (offset + sizeof(connman_trace_record_t) <= length)
+	{
+		connman_trace_record_t header;
+		memcpy(&header, contents + offset, sizeof(header));
+		offset += sizeof(header);
+		if(offset + header.length > length)
+			break;
+
+		GDBusMessage *message = g_dbus_message_new_from_blob((guchar *) contents + offset, header.length,
+								G_DBUS_CAPABILITY_FLAGS_NONE, &error);
+		offset += header.length;
+		if(NULL == message)
+		{
+			g_printerr("Skipping undecodable message: %s\n", error->message);
+			g_clear_error(&error);
+			continue;
+		}
+
+		mock_replay_record_t *record = g_new0(mock_replay_record_t, 1);
+		record->timestamp = header.timestamp;
+		record->message = message;
+		g_ptr_array_add(replay_records, record);
+	}
+
+	g_free(contents);
+	g_print("Loaded %u messages from %s\n", replay_records->len, path);
+
+	return TRUE;
+}
+
+static void replay_emit(const gchar *path, const gchar *interface, const gchar *member, GVariant *parameters)
+{
+	GError *error = NULL;
+
+	if (!g_dbus_connection_emit_signal(connection, NULL, path, interface, member, parameters, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return;
+	}
+	signals_emitted++;
+}
+
+/**
+ * Turn a recorded reply into the signals which carry the same state
+ */
+
+static void replay_reply(GDBusMessage *call, GDBusMessage *reply)
+{
+	GVariant *body = g_dbus_message_get_body(reply);
+	const gchar *member = g_dbus_message_get_member(call);
+	const gchar *path = g_dbus_message_get_path(call);
+	const gchar *interface = g_dbus_message_get_interface(call);
+	GVariantIter iter;
+	GVariant *child, *list;
+
+	if(NULL == body || g_dbus_message_get_message_type(reply) != G_DBUS_MESSAGE_TYPE_METHOD_RETURN)
+		return;
+
+	if(!g_strcmp0(member, "GetServices"))
+	{
+		list = g_variant_get_child_value(body, 0);
+		replay_emit("/", "net.connman.Manager", "ServicesChanged",
+			g_variant_new("(@a(oa{sv})@ao)", list, g_variant_new_array(G_VARIANT_TYPE_OBJECT_PATH, NULL, 0)));
+		g_variant_unref(list);
+	}
+	else if(!g_strcmp0(member, "GetTechnologies"))
+	{
+		list = g_variant_get_child_value(body, 0);
+		g_variant_iter_init(&iter, list);
+		while (NULL != (child = g_variant_iter_next_value(&iter)))
+		{
+			replay_emit("/", "net.connman.Manager", "TechnologyAdded", child);
+			g_variant_unref(child);
+		}
+		g_variant_unref(list);
+	}
+	else if(!g_strcmp0(member, "GetProperties"))
+	{
+		list = g_variant_get_child_value(body, 0);
+		g_variant_iter_init(&iter, list);
+		while (NULL != (child = g_variant_iter_next_value(&iter)))
+		{
+			GVariant *key = g_variant_get_child_value(child, 0);
+			GVariant *value = g_variant_get_child_value(child, 1);
+			replay_emit(path, interface, "PropertyChanged", g_variant_new("(@s@v)", key, value));
+			g_variant_unref(key);
+			g_variant_unref(value);
+			g_variant_unref(child);
+		}
+		g_variant_unref(list);
+	}
+}
+
+static void replay_message(GDBusMessage *message)
+{
+	GDBusMessage *call;
+
+	switch(g_dbus_message_get_message_type(message))
+	{
+		case G_DBUS_MESSAGE_TYPE_SIGNAL:
+			replay_emit(g_dbus_message_get_path(message), g_dbus_message_get_interface(message),
+					g_dbus_message_get_member(message), g_dbus_message_get_body(message));
+			break;
+		case G_DBUS_MESSAGE_TYPE_METHOD_CALL:
+			g_hash_table_replace(replay_calls, GUINT_TO_POINTER(g_dbus_message_get_serial(message)),
+					g_object_ref(message));
+			break;
+		case G_DBUS_MESSAGE_TYPE_METHOD_RETURN:
+		case G_DBUS_MESSAGE_TYPE_ERROR:
+			call = g_hash_table_lookup(replay_calls, GUINT_TO_POINTER(g_dbus_message_get_reply_serial(message)));
+			if(NULL != call)
+				replay_reply(call, message);
+			break;
+		default:
+			break;
+	}
+}
+
+static gboolean replay_tick_cb(gpointer user_data)
+{
+	guint64 base = ((mock_replay_record_t *) g_ptr_array_index(replay_records, 0))->timestamp;
+	guint batch = 0;
+
+	replay_source = 0;
+
+	while (replay_next < replay_records->len)
+	{
+		mock_replay_record_t *record = g_ptr_array_index(replay_records, replay_next);
+
+		if(option_replay_speed > 0)
+		{
+			gint64 due = replay_start_time + (gint64) ((record->timestamp - base) / option_replay_speed);
+			gint64 now = g_get_monotonic_time();
+			if(due > now)
+			{
+				replay_source = g_timeout_add((due - now + 999) / 1000, replay_tick_cb, NULL);
+				return FALSE;
+			}
+		}
+		else if(batch++ == MOCK_REPLAY_BATCH)
+		{
+			/* give pending method calls a chance */
+			replay_source = g_idle_add(replay_tick_cb, NULL);
+			return FALSE;
+		}
+
+		replay_message(record->message);
+		replay_next++;
+	}
+
+	g_print("Replay finished after %.3f s\n", (g_get_monotonic_time() - replay_start_time) / (gdouble) G_USEC_PER_SEC);
+	return FALSE;
+}
+
+static gboolean start_replay_cb(gpointer user_data)
+{
+	if(0 != replay_source || 0 == replay_records->len)
+		return TRUE;
+
+	g_hash_table_remove_all(replay_calls);
+	replay_next = 0;
+	replay_start_time = g_get_monotonic_time();
+	replay_source = g_idle_add(replay_tick_cb, NULL);
+
+	return TRUE;
+}
+
+/**
+ * Write the call statistics as a single JSON object
+ */
+
+static gboolean write_stats_cb(gpointer user_data)
+{
+	GString *json = g_string_new(NULL);
+	GHashTableIter iter;
+	gpointer key, value;
+	gboolean first = TRUE;
+
+	g_string_append_printf(json, "{\"services\":%u,\"totalCalls\":%" G_GUINT64_FORMAT ",\"signalsEmitted\":%" G_GUINT64_FORMAT ",\"calls\":{",
+			services->len, total_calls, signals_emitted);
+
+	g_hash_table_iter_init(&iter, call_counts);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		g_string_append_printf(json, "%s\"%s\":%u", first ? "" : ",", (const gchar *) key, GPOINTER_TO_UINT(value));
+		first = FALSE;
+	}
+	g_string_append(json, "}}\n");
+
+	if(NULL != option_stats_file)
+		g_file_set_contents(option_stats_file, json->str, json->len, NULL);
+	else
+		fputs(json->str, stdout);
+
+	g_string_free(json, TRUE);
+	return TRUE;
+}
+
+static gboolean quit_cb(gpointer user_data)
+{
+	g_main_loop_quit(mainloop);
+	return FALSE;
+}
+
+static void bus_acquired_cb(GDBusConnection *conn, const gchar *name, gpointer user_data)
+{
+	gint i;
+
+	connection = conn;
+
+	manager_skeleton = connman_interface_manager_skeleton_new();
+	g_signal_connect(manager_skeleton, "handle-get-properties", G_CALLBACK(handle_manager_get_properties), NULL);
+	g_signal_connect(manager_skeleton, "handle-set-property", G_CALLBACK(handle_manager_set_property), NULL);
+	g_signal_connect(manager_skeleton, "handle-get-services", G_CALLBACK(handle_manager_get_services), NULL);
+	g_signal_connect(manager_skeleton, "handle-get-technologies", G_CALLBACK(handle_manager_get_technologies), NULL);
+	g_signal_connect(manager_skeleton, "handle-register-agent", G_CALLBACK(handle_manager_register_agent), NULL);
+	g_signal_connect(manager_skeleton, "handle-unregister-agent", G_CALLBACK(handle_manager_unregister_agent), NULL);
+	export_object(manager_skeleton, "/");
+
+	add_technology("wifi", "WiFi");
+	add_technology("ethernet", "Wired");
+
+	add_service("ethernet", "Wired", 100, FALSE);
+	for (i = 0; i < option_services; i++)
+	{
+		gchar *name = g_strdup_printf("mock-ap-%d", i);
+		add_service("wifi", name, (guchar) g_random_int_range(10, 100), (i % 2) == 1);
+		g_free(name);
+	}
+}
+
+static void name_lost_cb(GDBusConnection *conn, const gchar *name, gpointer user_data)
+{
+	g_printerr("Could not own %s on the bus\n", name);
+	g_main_loop_quit(mainloop);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+
+	context = g_option_context_new("- connman stand-in for benchmarking webos-connman-adapter");
+	g_option_context_add_main_entries(context, option_entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	g_type_init();
+
+	mainloop = g_main_loop_new(NULL, FALSE);
+	services = g_ptr_array_new();
+	technologies = g_ptr_array_new();
+	call_counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	manager_state = g_strdup("idle");
+
+	if(NULL != option_replay_file)
+	{
+		if(!load_replay_trace(option_replay_file))
+			return 1;
+		replay_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+	}
+
+	g_unix_signal_add(SIGUSR1, write_stats_cb, NULL);
+	g_unix_signal_add(SIGUSR2, NULL != replay_records ? start_replay_cb : start_storm_cb, NULL);
+	g_unix_signal_add(SIGTERM, quit_cb, NULL);
+	g_unix_signal_add(SIGINT, quit_cb, NULL);
+
+	guint owner_id = g_bus_own_name(G_BUS_TYPE_SYSTEM, "net.connman", G_BUS_NAME_OWNER_FLAGS_NONE,
+				bus_acquired_cb, NULL, name_lost_cb, NULL, NULL);
+
+	g_main_loop_run(mainloop);
+
+	write_stats_cb(NULL);
+	g_bus_unown_name(owner_id);
+	g_main_loop_unref(mainloop);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+# @@@LICENSE
+#
+# Copyright (c) 2012-2013 LG Electronics, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# LICENSE@@@
+#
+# Run the end-to-end benchmark for a range of service counts.
+#
+# Usage: run_bench.sh <build-dir> [service counts...]
+#
+# Starts a private system bus for mock-connman and the adapter. The Luna hub
+# must already be running so that adapter-bench can reach com.palm.wifi and
+# com.palm.connectionmanager.
+
+BUILD_DIR=${1:?build directory required}
+shift
+COUNTS=${*:-10 100 1000 5000}
+STATS=$(mktemp)
+
+eval $(dbus-launch --sh-syntax)
+export DBUS_SYSTEM_BUS_ADDRESS=$DBUS_SESSION_BUS_ADDRESS
+
+for count in $COUNTS; do
+	$BUILD_DIR/bench/mock-connman --services $count --stats-file $STATS &
+	MOCK_PID=$!
+	sleep 1
+	$BUILD_DIR/webos-connman-adapter &
+	ADAPTER_PID=$!
+	sleep 2
+
+	$BUILD_DIR/bench/adapter-bench --services $count --adapter-pid $ADAPTER_PID \
+		--mock-pid $MOCK_PID --mock-stats $STATS --storm
+
+	kill $ADAPTER_PID $MOCK_PID
+	wait $ADAPTER_PID $MOCK_PID 2>/dev/null
+done
+
+kill $DBUS_SESSION_BUS_PID
+rm -f $STATS
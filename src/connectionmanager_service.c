@@ -49,6 +49,7 @@ errorText | Yes | String | Error description
 #include <string.h>
 #include <sys/ioctl.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <linux/if.h>
 #include <pbnjson.h>
 
@@ -57,49 +58,62 @@ errorText | Yes | String | Error description
 #include "connectionmanager_service.h"
 #include "lunaservice_utils.h"
 #include "logging.h"
+#include "interface_facts.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "flight_recorder.h"
+#include "network_state.h"
+#include "technology_registry.h"
+#include "netlink_monitor.h"
+#include "status_journal.h"
 
 static LSHandle *pLsHandle, *pLsPublicHandle;
 
+/* Context the service is attached to, NULL if it shares the main one */
+static GMainContext *service_context = NULL;
+
 /**
  * @brief Fill in information about the system's connection status
  *
+ * Connected state and address are taken as network_state_get_effective_link()
+ * decides, so a lost link is reported as disconnected before connman notices.
+ *
  * @param status
  */
 
-static void update_connection_status(connman_service_t *connected_service, jvalue_ref *status)
+static void update_connection_status(const network_state_t *state,
+				const network_service_state_t *connected_service, jvalue_ref *status)
 {
 	if(NULL == connected_service || NULL == status)
 		return;
 
+	network_service_ipv4_t ipv4;
 	int connman_state = 0;
 	connman_state = connman_service_get_state(connected_service->state);
-	if(connman_state == CONNMAN_SERVICE_STATE_ONLINE
-		|| connman_state == CONNMAN_SERVICE_STATE_READY)
+	if(network_state_get_effective_link(state, connected_service, &ipv4))
 	{
-		connman_service_get_ipinfo(connected_service);
-
 		jobject_put(*status, J_CSTR_TO_JVAL("state"), jstring_create("connected"));
-		if(NULL != connected_service->ipinfo.iface)
-			jobject_put(*status, J_CSTR_TO_JVAL("interfaceName"), jstring_create(connected_service->ipinfo.iface));
-		if(NULL != connected_service->ipinfo.ipv4.address)
-			jobject_put(*status, J_CSTR_TO_JVAL("ipAddress"), jstring_create(connected_service->ipinfo.ipv4.address));
-		if(NULL != connected_service->ipinfo.ipv4.netmask)
-			jobject_put(*status, J_CSTR_TO_JVAL("netmask"), jstring_create(connected_service->ipinfo.ipv4.netmask));
-		if(NULL != connected_service->ipinfo.ipv4.gateway)
-			jobject_put(*status, J_CSTR_TO_JVAL("gateway"), jstring_create(connected_service->ipinfo.ipv4.gateway));
+		if(NULL != connected_service->iface)
+			jobject_put(*status, J_CSTR_TO_JVAL("interfaceName"), jstring_create(connected_service->iface));
+		if(ipv4.address[0] != '\0')
+			jobject_put(*status, J_CSTR_TO_JVAL("ipAddress"), jstring_create(ipv4.address));
+		if(ipv4.netmask[0] != '\0')
+			jobject_put(*status, J_CSTR_TO_JVAL("netmask"), jstring_create(ipv4.netmask));
+		if(NULL != connected_service->ipv4_gateway)
+			jobject_put(*status, J_CSTR_TO_JVAL("gateway"), jstring_create(connected_service->ipv4_gateway));
 
 		gsize i;
 		char dns_str[16];
-		for (i = 0; i < g_strv_length(connected_service->ipinfo.dns); i++)
+		for (i = 0; NULL != connected_service->nameservers && i < g_strv_length(connected_service->nameservers); i++)
 		{
 			sprintf(dns_str,"dns%d",i+1);
-			jobject_put(*status, jstring_create(dns_str), jstring_create(connected_service->ipinfo.dns[i]));
+			jobject_put(*status, jstring_create(dns_str), jstring_create(connected_service->nameservers[i]));
 		}
 
-		if(NULL != connected_service->ipinfo.ipv4.method)
-			jobject_put(*status, J_CSTR_TO_JVAL("method"), jstring_create(connected_service->ipinfo.ipv4.method));
+		if(NULL != connected_service->ipv4_method)
+			jobject_put(*status, J_CSTR_TO_JVAL("method"), jstring_create(connected_service->ipv4_method));
 
-		if(connman_service_type_wifi(connected_service))
+		if(connected_service->type == CONNMAN_SERVICE_TYPE_WIFI)
 		{
 			if(NULL != connected_service->name)
 				jobject_put(*status, J_CSTR_TO_JVAL("ssid"), jstring_create(connected_service->name));
@@ -119,86 +133,57 @@ static void update_connection_status(connman_service_t *connected_service, jvalu
 }
 
 /**
- * @brief Fill in all the status information to be sent with 'getstatus' method
+ * @brief Add the status of the connected service of a list, or a disconnected state
  */
 
-static void send_connection_status(jvalue_ref *reply)
+static void add_technology_status(const network_state_t *state, const GPtrArray *services,
+				const char *key, jvalue_ref *reply)
 {
-        if(NULL == reply)
-                return;
-
-	gboolean online = connman_manager_is_manager_online(manager);
-	jobject_put(*reply, J_CSTR_TO_JVAL("isInternetConnectionAvailable"), jboolean_create(online));
-	jobject_put(*reply, J_CSTR_TO_JVAL("offlineMode"), jstring_create(!connman_manager_is_manager_available(manager) ? "enabled" : "disabled"));
-
-	jvalue_ref connected_wired_status = jobject_create();
-	jvalue_ref disconnected_wired_status = jobject_create();
-	jvalue_ref connected_wifi_status = jobject_create();
-	jvalue_ref disconnected_wifi_status = jobject_create();
-	jvalue_ref connected_cellular_status = jobject_create();
-	jvalue_ref disconnected_cellular_status = jobject_create();
-
-	jobject_put(disconnected_wired_status, J_CSTR_TO_JVAL("state"), jstring_create("disconnected"));
-	jobject_put(disconnected_wifi_status, J_CSTR_TO_JVAL("state"), jstring_create("disconnected"));
-	jobject_put(disconnected_cellular_status, J_CSTR_TO_JVAL("state"), jstring_create("disconnected"));
+	jvalue_ref status = jobject_create();
 
 	/* Get the service which is connecting or already in connected state */
-	connman_service_t *connected_wired_service = connman_manager_get_connected_service(manager->wired_services);
-	if(NULL != connected_wired_service)
-	{
-		update_connection_status(connected_wired_service, &connected_wired_status);
-		jobject_put(*reply, J_CSTR_TO_JVAL("wired"), connected_wired_status);
-		j_release(&disconnected_wired_status);
-	}
+	const network_service_state_t *connected_service = network_state_get_connected_service(services);
+	if(NULL != connected_service)
+		update_connection_status(state, connected_service, &status);
 	else
-	{
-		jobject_put(*reply, J_CSTR_TO_JVAL("wired"), disconnected_wired_status);
-		j_release(&connected_wired_status);
-	}
+		jobject_put(status, J_CSTR_TO_JVAL("state"), jstring_create("disconnected"));
 
-	connman_service_t *connected_wifi_service = connman_manager_get_connected_service(manager->wifi_services);
-	if(NULL != connected_wifi_service)
-	{
-		update_connection_status(connected_wifi_service, &connected_wifi_status);
-		jobject_put(*reply, J_CSTR_TO_JVAL("wifi"), connected_wifi_status);
-		j_release(&disconnected_wifi_status);
-	}
-	else
-	{
-		jobject_put(*reply, J_CSTR_TO_JVAL("wifi"), disconnected_wifi_status);
-		j_release(&connected_wifi_status);
-	}
+	jobject_put(*reply, jstring_create(key), status);
+}
 
-	connman_service_t *connected_cellular_service = connman_manager_get_connected_service(manager->cellular_services);
-	if (NULL != connected_cellular_service)
-	{
-		update_connection_status(connected_cellular_service, &connected_cellular_status);
-		jobject_put(*reply, J_CSTR_TO_JVAL("cellular"), connected_cellular_status);
-		j_release(&disconnected_cellular_status);
-	}
-	else
-	{
-		jobject_put(*reply, J_CSTR_TO_JVAL("cellular"), disconnected_cellular_status);
-		j_release(&connected_cellular_status);
-	}
+/**
+ * @brief Fill in all the status information to be sent with 'getstatus' method
+ *
+ * Only reads the given snapshot, so it can run on the connectionmanager
+ * context when that is separate from the main one.
+ */
 
-}
+static void send_connection_status(const network_state_t *state, jvalue_ref *reply)
+{
+        if(NULL == reply)
+                return;
+
+	gboolean online = !g_strcmp0(state->manager_state, "online");
+	jobject_put(*reply, J_CSTR_TO_JVAL("isInternetConnectionAvailable"), jboolean_create(online));
+	jobject_put(*reply, J_CSTR_TO_JVAL("offlineMode"), jstring_create(state->offline ? "enabled" : "disabled"));
 
+	add_technology_status(state, state->wired_services, "wired", reply);
+	add_technology_status(state, state->wifi_services, "wifi", reply);
+	add_technology_status(state, state->cellular_services, "cellular", reply);
+}
 
 /**
- *  @brief Callback function registered with connman manager whenever any of its properties change
- *
+ *  @brief Post the status in a snapshot to all getstatus subscribers
  */
 
-void connectionmanager_send_status(void)
+static void post_connection_status(const network_state_t *state)
 {
 	jvalue_ref reply = jobject_create();
 	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
 
-	if (manager)
-		send_connection_status(&reply);
-
-	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	send_connection_status(state, &reply);
+	jobject_put(reply, J_CSTR_TO_JVAL("seq"), jnumber_create_i64(status_journal_record(reply)));
+	jobject_put(reply, J_CSTR_TO_JVAL("epoch"), jstring_create(status_journal_epoch()));
 
 	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
 	if(response_schema)
@@ -207,12 +192,12 @@ void connectionmanager_send_status(void)
 		LSError lserror;
 		LSErrorInit(&lserror);
 		WCA_LOG_INFO("Sending payload %s",payload);
-		if (!LSSubscriptionPost(pLsHandle, "/", "getstatus", payload, &lserror))
+		if (!luna_service_subscription_post(pLsHandle, "/", "getstatus", payload, &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
 		}
-		if (!LSSubscriptionPost(pLsHandle, "/", "getStatus", payload, &lserror))
+		if (!luna_service_subscription_post(pLsHandle, "/", "getStatus", payload, &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
@@ -222,6 +207,49 @@ void connectionmanager_send_status(void)
 	j_release(&reply);
 }
 
+/* Latest snapshot waiting to be posted on the connectionmanager context */
+static network_state_t *pending_status = NULL;
+
+static gboolean post_pending_status_cb(gpointer user_data)
+{
+	network_state_t *state = __atomic_exchange_n(&pending_status, NULL, __ATOMIC_SEQ_CST);
+
+	if(NULL != state)
+	{
+		post_connection_status(state);
+		network_state_release(state);
+	}
+
+	return FALSE;
+}
+
+/**
+ *  @brief Callback function registered with connman manager whenever any of its properties change
+ *
+ *  The snapshot is taken here, on the main context, so it holds the change
+ *  which triggered this call. When the service runs its own context the
+ *  fan-out happens there, and back to back changes coalesce into one post
+ *  of the latest status.
+ */
+
+void connectionmanager_send_status(void)
+{
+	network_state_t *state = network_state_acquire();
+
+	if(NULL == service_context)
+	{
+		post_connection_status(state);
+		network_state_release(state);
+		return;
+	}
+
+	network_state_t *previous = __atomic_exchange_n(&pending_status, state, __ATOMIC_SEQ_CST);
+	if(NULL != previous)
+		network_state_release(previous);
+	else
+		g_main_context_invoke(service_context, post_pending_status_cb, NULL);
+}
+
 
 //->Start of API documentation comment block
 /**
@@ -234,15 +262,29 @@ Gets the current status of network connections (both wifi and wired) on the syst
 Callers of this method can subscribe to it so that they are notified whenever the
 network status changes.
 
+Cable plug and unplug and address changes are picked up from the kernel as
+they happen, so subscribers hear about them without waiting for connman.
+
+Every change of the status gets a sequence number. A subscriber coming back
+after losing its subscription passes the last "seq" and "epoch" it saw as
+"since" and "epoch" and gets only the changes it missed, as long as they are
+among the last 64. Sequence numbers start over when the adapter restarts,
+which changes the epoch. Otherwise it gets the full status, as without "since".
+
 @par Parameters
 Name | Required | Type | Description
 -----|--------|------|----------
 subcribe | no | Boolean | Subscribe to this method
+since | no | Integer | Sequence number of the last status seen
+epoch | no | String | Epoch of the last status seen, "since" is ignored unless it matches
 
 @par Returns(Call)
 Name | Required | Type | Description
 -----|--------|------|----------
 returnValue | yes | Boolean | True
+seq | yes | Integer | Sequence number of the latest change
+epoch | yes | String | Id of this run of the adapter, which "seq" belongs to
+changes | no | Array of Object | Only when "since" was given and the changes after it are known: the changes oldest first, each with its "seq" and the fields below which changed. The fields below are then left out.
 isInternetConnectionAvailable | Yes | Boolean | Indicates if any internet connection is available
 wired | yes | Object | State of wired connection (see below)
 wifi | yes | Object | State of wifi connection (see below)
@@ -276,7 +318,8 @@ isWakeOnWiFiEnabled | no | Boolean | True if "Wake on WIFI" is enabled
 onInternet | no | String | "yes" or "no" to indicate if the service is "online"
 
 @par Returns(Subscription)
-The subcription update contains the same information as the initial call.
+The subcription update contains the same information as the initial call,
+always with the full status and without "changes".
 
 @}
 */
@@ -290,6 +333,7 @@ The subcription update contains the same information as the initial call.
  *
  *  luna://com.palm.connectionmanager/getstatus {}
  *  luna://com.palm.connectionmanager/getstatus {"subscribed":true}
+ *  luna://com.palm.connectionmanager/getstatus {"subscribe":true,"since":<seq>,"epoch":<epoch>}
  *
  *  @param sh
  *  @param message
@@ -304,9 +348,9 @@ static bool handle_get_status_command(LSHandle* sh, LSMessage *message, void* co
 	LSErrorInit(&lserror);
 	bool subscribed = false;
 
-	if (LSMessageIsSubscription(message))
+	if (luna_service_message_is_subscription(message))
 	{
-		if (!LSSubscriptionProcess(sh, message, &subscribed, &lserror))
+		if (!luna_service_subscription_process(sh, message, &subscribed, &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
@@ -314,8 +358,42 @@ static bool handle_get_status_command(LSHandle* sh, LSMessage *message, void* co
 		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(subscribed));
 	}
 
-	if (manager)
-		send_connection_status(&reply);
+	jvalue_ref changes = NULL;
+	jvalue_ref parsedObj = {0}, sinceObj = {0}, epochObj = {0};
+	jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(input_schema)
+	{
+		JSchemaInfo schemaInfo;
+		jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
+		parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
+		jschema_release(&input_schema);
+
+		/* Sequence numbers from another run mean nothing here */
+		if(!jis_null(parsedObj) && jobject_get_exists(parsedObj, J_CSTR_TO_BUF("since"), &sinceObj)
+			&& jis_number(sinceObj)
+			&& jobject_get_exists(parsedObj, J_CSTR_TO_BUF("epoch"), &epochObj)
+			&& jis_string(epochObj)
+			&& jstring_equal2(epochObj, j_cstr_to_buffer(status_journal_epoch())))
+		{
+			int64_t since = 0;
+			jnumber_get_i64(sinceObj, &since);
+			changes = status_journal_changes_since(since);
+		}
+		j_release(&parsedObj);
+	}
+
+	jobject_put(reply, J_CSTR_TO_JVAL("seq"), jnumber_create_i64(status_journal_seq()));
+	jobject_put(reply, J_CSTR_TO_JVAL("epoch"), jstring_create(status_journal_epoch()));
+
+	/* Without the changes, or if they are gone, the full status */
+	if(NULL != changes)
+		jobject_put(reply, J_CSTR_TO_JVAL("changes"), changes);
+	else
+	{
+		network_state_t *state = network_state_acquire();
+		send_connection_status(state, &reply);
+		network_state_release(state);
+	}
 
 	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
 
@@ -327,7 +405,7 @@ response:
 			LSMessageReplyErrorUnknown(sh,message);
 			goto cleanup;
 		}
-		if (!LSMessageReply(sh, message, jvalue_tostring(reply, response_schema), &lserror)) {
+		if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror)) {
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
 		}
@@ -436,7 +514,7 @@ static bool handle_set_ipv4_command(LSHandle *sh, LSMessage *message, void* cont
 
 	JSchemaInfo schemaInfo;
 	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-	parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
 	jschema_release(&input_schema);
 
 	if (jis_null(parsedObj))
@@ -570,7 +648,7 @@ static bool handle_set_dns_command(LSHandle *sh, LSMessage *message, void* conte
 
 	JSchemaInfo schemaInfo;
 	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-	parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
 	jschema_release(&input_schema);
 
 	if (jis_null(parsedObj))
@@ -725,7 +803,7 @@ static bool handle_set_state_command(LSHandle *sh, LSMessage *message, void* con
 
 	JSchemaInfo schemaInfo;
 	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-	parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
 	jschema_release(&input_schema);
 
 	if (jis_null(parsedObj))
@@ -832,83 +910,71 @@ cleanup:
 
 }
 
-//->Start of API documentation comment block
-/**
-@page com_webos_connectionmanager com.webos.connectionmanager
-@{
-@section com_webos_connectionmanager_getinfo getinfo
+static gboolean is_valid_ipv4_address(const gchar *address)
+{
+	struct in_addr addr;
 
-Lists information about the WiFi and wired interface (currently just lists MAC addresses for both interfaces).
+	return NULL != address && inet_pton(AF_INET, address, &addr) == 1;
+}
 
-@par Parameters
-None
+/**
+ *  @brief Check the netmask is an address made of leading ones only
+ */
 
-@par Returns(Call)
-Name | Required | Type | Description
------|--------|------|----------
-returnValue | yes | Boolean | True
-wiredInfo | no | Object | Object containing information for the current wired connection.
-wifiInfo | no | Object | Object containing information for the current wifi connection.
+static gboolean is_valid_netmask(const gchar *netmask)
+{
+	struct in_addr addr;
 
-@par Information Object
-Name | Required | Type | Description
------|--------|------|----------
-macAddress | yes | String | MAC address of the controller for the connection
+	if(NULL == netmask || inet_pton(AF_INET, netmask, &addr) != 1)
+		return FALSE;
 
-@par Returns(Subscription)
-None
+	guint32 mask = ntohl(addr.s_addr);
+	return (mask & (~mask >> 1)) == 0;
+}
 
-@}
-*/
-//->End of API documentation comment block
+static gboolean is_valid_nameserver(const gchar *address)
+{
+	struct in6_addr addr;
+
+	return NULL != address &&
+		(inet_pton(AF_INET, address, &addr) == 1 || inet_pton(AF_INET6, address, &addr) == 1);
+}
 
 /**
- * Handler for "getinfo" command.
- *
- * JSON format:
- * luna://com.palm.connectionmanager/getinfo {}
+ * A setnetworkconfig call waiting for its SetProperty calls to return
  */
-
-static bool handle_get_info_command(LSHandle *sh, LSMessage *message, void* context)
+typedef struct network_config_request {
+	luna_service_request_t *service_req;
+	guint pending;		/* SetProperty calls not returned yet */
+	gboolean success;	/* all returned calls succeeded */
+	jvalue_ref results;	/* per field result objects */
+} network_config_request_t;
+
+typedef struct network_config_field {
+	network_config_request_t *request;
+	const char *name;
+} network_config_field_t;
+
+static void network_config_request_reply(network_config_request_t *request)
 {
-	jvalue_ref reply = jobject_create();
 	LSError lserror;
 	LSErrorInit(&lserror);
 
-	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
-
-
-	connman_service_t *connected_wifi_service = connman_manager_get_connected_service(manager->wifi_services);
-	const gchar *wifi_mac_address = get_service_mac_address(connected_wifi_service);
-	if(wifi_mac_address != NULL)
-	{
-		jvalue_ref wifi_info = jobject_create();
-		jobject_put(wifi_info, J_CSTR_TO_JVAL("macAddress"),jstring_create(wifi_mac_address));
-		jobject_put(reply, J_CSTR_TO_JVAL("wifiInfo"), wifi_info);
-	}
-	else
-		WCA_LOG_ERROR("Error in fetching mac address for wifi interface");
-
-
-	connman_service_t *connected_wired_service = connman_manager_get_connected_service(manager->wired_services);
-	const gchar *wired_mac_address = get_service_mac_address(connected_wired_service);
-	if(wired_mac_address != NULL)
-	{
-		jvalue_ref wired_info = jobject_create();
-		jobject_put(wired_info, J_CSTR_TO_JVAL("macAddress"),jstring_create(wired_mac_address));
-		jobject_put(reply, J_CSTR_TO_JVAL("wiredInfo"), wired_info);
-	}
-	else
-		WCA_LOG_ERROR("Error in fetching mac address for wired interface");
+	jvalue_ref reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(request->success));
+	if(!request->success)
+		jobject_put(reply, J_CSTR_TO_JVAL("errorText"), jstring_create("Failed to apply network configuration"));
+	jobject_put(reply, J_CSTR_TO_JVAL("results"), request->results);
 
 	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
 	if(!response_schema)
 	{
-		LSMessageReplyErrorUnknown(sh,message);
+		LSMessageReplyErrorUnknown(request->service_req->handle, request->service_req->message);
 		goto cleanup;
 	}
 
-	if (!LSMessageReply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	if (!luna_service_message_reply(request->service_req->handle, request->service_req->message,
+				jvalue_tostring(reply, response_schema), &lserror))
 	{
 		LSErrorPrint(&lserror, stderr);
 		LSErrorFree(&lserror);
@@ -917,135 +983,1004 @@ static bool handle_get_info_command(LSHandle *sh, LSMessage *message, void* cont
 	jschema_release(&response_schema);
 
 cleanup:
-	if (LSErrorIsSet(&lserror))
-	{
-		LSErrorPrint(&lserror, stderr);
-		LSErrorFree(&lserror);
-	}
-
 	j_release(&reply);
-	return true;
+	luna_service_message_unref(request->service_req->message);
+	g_free(request->service_req);
+	g_free(request);
 }
 
 /**
- *  @brief Callback function registered with connman technology whenever any of its properties change
- *
- *  @param data
- *  @param property
- *  @param value
+ *  @brief Record the result of one SetProperty call, reply once the last one is in
  */
 
-static void technology_property_changed_callback(gpointer data, const gchar *property, GVariant *value)
+static void network_config_field_cb(gboolean success, const gchar *error_message, gpointer user_data)
 {
-	connman_technology_t *technology = (connman_technology_t *)data;
+	network_config_field_t *field = user_data;
+	network_config_request_t *request = field->request;
 
-	if(NULL == technology)
-		return;
+	jvalue_ref result = jobject_create();
+	jobject_put(result, J_CSTR_TO_JVAL("returnValue"), jboolean_create(success));
+	if(!success && NULL != error_message)
+		jobject_put(result, J_CSTR_TO_JVAL("errorText"), jstring_create(error_message));
+	jobject_put(request->results, jstring_create(field->name), result);
 
-	/* Need to send getstatus method to all com.palm.connectionmanager subscribers whenever the
-	   "powered" or "connected" state of the technology changes */
+	if(!success)
+		request->success = FALSE;
 
-	if(g_str_equal(property,"Powered") || g_str_equal(property,"Connected"))
-	{
-		connectionmanager_send_status();
-	}
+	g_free(field);
+
+	if(--request->pending == 0)
+		network_config_request_reply(request);
 }
 
 /**
- * com.palm.connectionmanager service Luna Method Table
+ *  @brief Start tracking the SetProperty call for one field
  */
 
-static LSMethod connectionmanager_methods[] = {
-    { LUNA_METHOD_GETSTATUS,            handle_get_status_command },
-    { LUNA_METHOD_GETSTATUS2,            handle_get_status_command },
-    { LUNA_METHOD_SETIPV4,              handle_set_ipv4_command },
-    { LUNA_METHOD_SETDNS,               handle_set_dns_command },
-    { LUNA_METHOD_SETSTATE,             handle_set_state_command },
-    { LUNA_METHOD_GETINFO,		handle_get_info_command },
-    { },
-};
+static network_config_field_t *network_config_field_new(network_config_request_t *request, const char *name)
+{
+	network_config_field_t *field = g_new0(network_config_field_t, 1);
 
-static LSMethod connectionmanager_public_methods[] = {
-    { LUNA_METHOD_GETSTATUS,            handle_get_status_command },
-    { LUNA_METHOD_GETSTATUS2,            handle_get_status_command },
-    { },
-};
+	field->request = request;
+	field->name = name;
+	request->pending++;
 
-static gboolean check_cellular_status_cb(gpointer user_data)
-{
-	connman_technology_t *technology = connman_manager_find_cellular_technology(manager);
-	if (technology)
-		connman_technology_register_property_changed_cb(technology, technology_property_changed_callback);
+	return field;
 }
 
+//->Start of API documentation comment block
 /**
- *  @brief Initialize com.palm.connectionmanager service and all of its methods
- *  Also initialize a manager instance
+@page com_webos_connectionmanager com.webos.connectionmanager
+@{
+@section com_webos_connectionmanager_setnetworkconfig setnetworkconfig
+
+Change the IPv4 settings, the DNS servers and the autoconnect flag of a
+network (wired or WIFI) in one call.
+
+All fields are checked before anything is applied; an invalid field fails
+the whole call. The changes are then sent to connman back to back, without
+waiting for each other, and the call returns once all of them are done.
+
+If an SSID field is not provided in the request, the modifications are
+applied to the wired connection.
+
+@par Parameters
+Name | Required | Type | Description
+-----|--------|------|----------
+ipv4 | no | Object | Same fields as the setipv4 method: "method", "address", "netmask", "gateway"
+dns | no | Array of String | Each string provides the IP address of a dns server
+autoConnect | no | Boolean | Whether connman connects the network on its own
+ssid | no | String | Select the WIFI connection to modify. If absent, the wired connection is changed.
+
+At least one of ipv4, dns or autoConnect is required. With "method" set to
+"manual", "address" and "netmask" are required.
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True if every field was applied
+errorText | no | String | Set when a field failed
+results | yes | Object | One object per field given, keyed "ipv4", "dns" and "autoConnect", holding "returnValue" and, on failure, "errorText"
+
+@par Returns(Subscription)
+None
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ *  @brief Handler for "setnetworkconfig" command.
+ *  Change the ipv4 settings, dns servers and autoconnect flag of the given wifi ssid
+ *  or of the wired connection together
+ *
+ *  JSON format:
+ *
+ *  luna://com.palm.connectionmanager/setnetworkconfig '{"ipv4":{"method":"manual","address":"<address>",
+ *		"netmask":"<netmask>","gateway":"<gateway>"},"dns":["<server>"],"autoConnect":true,"ssid":"<ssid value>"}'
+ *
+ *  @param sh
+ *  @param message
+ *  @param context
  */
 
-int initialize_connectionmanager_ls2_calls( GMainLoop *mainloop )
+static bool handle_set_network_config_command(LSHandle *sh, LSMessage *message, void* context)
 {
-	LSError lserror;
-	LSErrorInit (&lserror);
-	pLsHandle       = NULL;
-	pLsPublicHandle = NULL;
+	if(!connman_status_check(manager, sh, message))
+		return true;
 
-	if(NULL == mainloop)
-		goto Exit;
+	jvalue_ref parsedObj = {0};
+	jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!input_schema)
+		return false;
 
-	if (LSRegisterPubPriv(CONNECTIONMANAGER_LUNA_SERVICE_NAME, &pLsHandle, false, &lserror) == false)
-	{
-		WCA_LOG_FATAL("LSRegister() private returned error");
-		goto Exit;
-	}
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
+	jschema_release(&input_schema);
 
-	if (LSRegisterPubPriv(CONNECTIONMANAGER_LUNA_SERVICE_NAME, &pLsPublicHandle, true, &lserror) == false)
+	if (jis_null(parsedObj))
 	{
-		WCA_LOG_FATAL("LSRegister() public returned error");
-		goto Exit;
+		LSMessageReplyErrorBadJSON(sh, message);
+		return true;
 	}
 
-	if (LSRegisterCategory(pLsHandle, NULL, connectionmanager_methods, NULL, NULL, &lserror) == false)
-	{
-		WCA_LOG_FATAL("LSRegisterCategory() returned error");
-		goto Exit;
-	}
+	jvalue_ref ssidObj = {0}, ipv4Obj = {0}, dnsObj = {0}, autoConnectObj = {0}, fieldObj = {0};
+	ipv4info_t ipv4 = {0};
+	GStrv dns = NULL;
+	gchar *ssid = NULL;
+	gboolean has_ipv4 = FALSE, has_dns = FALSE, has_autoconnect = FALSE;
+	bool autoconnect = false;
 
-	if (LSRegisterCategory(pLsPublicHandle, NULL, connectionmanager_public_methods, NULL, NULL, &lserror) == false)
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("ipv4"), &ipv4Obj))
 	{
-		WCA_LOG_FATAL("LSRegisterCategory() returned error");
-		goto Exit;
-	}
+		if(!jis_object(ipv4Obj) || !jobject_get_exists(ipv4Obj, J_CSTR_TO_BUF("method"), &fieldObj)
+			|| !jis_string(fieldObj))
+			goto invalid_params;
 
-	if (LSGmainAttach(pLsHandle, mainloop, &lserror) == false)
-	{
-		WCA_LOG_FATAL("LSGmainAttach() private returned error");
-		goto Exit;
-	}
+		raw_buffer method_buf = jstring_get(fieldObj);
+		ipv4.method = g_strdup(method_buf.m_str);
+		jstring_free_buffer(method_buf);
 
-	if (LSGmainAttach(pLsPublicHandle, mainloop, &lserror) == false)
-	{
-		WCA_LOG_FATAL("LSGmainAttach() public returned error");
-		goto Exit;
-	}
+		if(jobject_get_exists(ipv4Obj, J_CSTR_TO_BUF("address"), &fieldObj))
+		{
+			if(!jis_string(fieldObj))
+				goto invalid_params;
+			raw_buffer address_buf = jstring_get(fieldObj);
+			ipv4.address = g_strdup(address_buf.m_str);
+			jstring_free_buffer(address_buf);
+		}
+		if(jobject_get_exists(ipv4Obj, J_CSTR_TO_BUF("netmask"), &fieldObj))
+		{
+			if(!jis_string(fieldObj))
+				goto invalid_params;
+			raw_buffer netmask_buf = jstring_get(fieldObj);
+			ipv4.netmask = g_strdup(netmask_buf.m_str);
+			jstring_free_buffer(netmask_buf);
+		}
+		if(jobject_get_exists(ipv4Obj, J_CSTR_TO_BUF("gateway"), &fieldObj))
+		{
+			if(!jis_string(fieldObj))
+				goto invalid_params;
+			raw_buffer gateway_buf = jstring_get(fieldObj);
+			ipv4.gateway = g_strdup(gateway_buf.m_str);
+			jstring_free_buffer(gateway_buf);
+		}
 
-	/* Register for Wired technology's "PropertyChanged" signal (For wifi its being done in wifi_service.c*/
-	connman_technology_t *technology = connman_manager_find_ethernet_technology(manager);
-	if(technology)
+		if(g_str_equal(ipv4.method, "manual"))
+		{
+			if(!is_valid_ipv4_address(ipv4.address) || !is_valid_netmask(ipv4.netmask))
+				goto invalid_params;
+		}
+		else if(!g_str_equal(ipv4.method, "dhcp"))
+			goto invalid_params;
+
+		if((NULL != ipv4.address && !is_valid_ipv4_address(ipv4.address))
+			|| (NULL != ipv4.netmask && !is_valid_netmask(ipv4.netmask))
+			|| (NULL != ipv4.gateway && !is_valid_ipv4_address(ipv4.gateway)))
+			goto invalid_params;
+
+		has_ipv4 = TRUE;
+	}
+
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("dns"), &dnsObj))
+	{
+		if(!jis_array(dnsObj))
+			goto invalid_params;
+
+		int i, dns_arrsize = jarray_size(dnsObj);
+		dns = g_new0(gchar *, dns_arrsize + 1);
+		for(i = 0; i < dns_arrsize; i++)
+		{
+			if(!jis_string(jarray_get(dnsObj, i)))
+				goto invalid_params;
+			raw_buffer dns_buf = jstring_get(jarray_get(dnsObj, i));
+			dns[i] = g_strdup(dns_buf.m_str);
+			jstring_free_buffer(dns_buf);
+			if(!is_valid_nameserver(dns[i]))
+				goto invalid_params;
+		}
+		has_dns = TRUE;
+	}
+
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("autoConnect"), &autoConnectObj))
+	{
+		if(!jis_boolean(autoConnectObj))
+			goto invalid_params;
+		jboolean_get(autoConnectObj, &autoconnect);
+		has_autoconnect = TRUE;
+	}
+
+	if(!has_ipv4 && !has_dns && !has_autoconnect)
+		goto invalid_params;
+
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("ssid"), &ssidObj))
+	{
+		if(!jis_string(ssidObj))
+			goto invalid_params;
+		raw_buffer ssid_buf = jstring_get(ssidObj);
+		ssid = g_strdup(ssid_buf.m_str);
+		jstring_free_buffer(ssid_buf);
+	}
+
+	connman_service_t *service = get_connman_service(ssid);
+	if(NULL == service)
+	{
+		LSMessageReplyCustomError(sh, message, "Network not found");
+		goto Exit;
+	}
+
+	network_config_request_t *request = g_new0(network_config_request_t, 1);
+	request->service_req = luna_service_request_new(sh, message);
+	luna_service_message_ref(message);
+	request->success = TRUE;
+	request->results = jobject_create();
+
+	/* Hold the reply back until every call has been sent */
+	request->pending = 1;
+
+	network_config_field_t *field;
+	if(has_ipv4)
+	{
+		field = network_config_field_new(request, "ipv4");
+		if(!connman_service_set_ipv4_async(service, &ipv4, network_config_field_cb, field))
+			network_config_field_cb(FALSE, "Could not send the request", field);
+	}
+	if(has_dns)
+	{
+		field = network_config_field_new(request, "dns");
+		if(!connman_service_set_nameservers_async(service, dns, network_config_field_cb, field))
+			network_config_field_cb(FALSE, "Could not send the request", field);
+	}
+	if(has_autoconnect)
+	{
+		field = network_config_field_new(request, "autoConnect");
+		if(!connman_service_set_autoconnect_async(service, autoconnect, network_config_field_cb, field))
+			network_config_field_cb(FALSE, "Could not send the request", field);
+	}
+
+	if(--request->pending == 0)
+		network_config_request_reply(request);
+
+	goto Exit;
+
+invalid_params:
+	LSMessageReplyErrorInvalidParams(sh, message);
+Exit:
+	g_free(ipv4.method);
+	g_free(ipv4.address);
+	g_free(ipv4.netmask);
+	g_free(ipv4.gateway);
+	g_strfreev(dns);
+	g_free(ssid);
+	j_release(&parsedObj);
+	return true;
+}
+
+//->Start of API documentation comment block
+/**
+@page com_webos_connectionmanager com.webos.connectionmanager
+@{
+@section com_webos_connectionmanager_getinfo getinfo
+
+Lists information about the WiFi, wired and cellular interfaces.
+
+The information is read from the kernel and cached, so it is available
+whether or not the interface is connected. An interface the device does not
+have is left out of the reply.
+
+@par Parameters
+None
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+wiredInfo | no | Object | Object containing information for the wired interface.
+wifiInfo | no | Object | Object containing information for the wifi interface.
+cellularInfo | no | Object | Object containing information for the cellular interface.
+
+@par Information Object
+Name | Required | Type | Description
+-----|--------|------|----------
+interfaceName | yes | String | Name of the network interface
+macAddress | no | String | MAC address of the controller for the interface
+interfaceIndex | yes | Integer | Kernel index of the interface
+mtu | yes | Integer | MTU of the interface
+carrier | yes | Boolean | True if a link is detected on the interface
+
+@par Returns(Subscription)
+None
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ * Add the cached facts of an interface to the reply under the given key
+ */
+
+static void add_interface_info(jvalue_ref reply, const char *key, gint iface)
+{
+	const interface_facts_t *facts = interface_facts_get(iface);
+	if(NULL == facts || !facts->present)
+	{
+		WCA_LOG_DEBUG("No %s interface, leaving %s out", NULL != facts ? facts->name : "", key);
+		return;
+	}
+
+	jvalue_ref info = jobject_create();
+	jobject_put(info, J_CSTR_TO_JVAL("interfaceName"), jstring_create(facts->name));
+	if(facts->mac_address[0] != '\0')
+		jobject_put(info, J_CSTR_TO_JVAL("macAddress"), jstring_create(facts->mac_address));
+	jobject_put(info, J_CSTR_TO_JVAL("interfaceIndex"), jnumber_create_i32(facts->ifindex));
+	jobject_put(info, J_CSTR_TO_JVAL("mtu"), jnumber_create_i32(facts->mtu));
+	jobject_put(info, J_CSTR_TO_JVAL("carrier"), jboolean_create(facts->carrier));
+	jobject_put(reply, jstring_create(key), info);
+}
+
+/**
+ * Handler for "getinfo" command.
+ *
+ * JSON format:
+ * luna://com.palm.connectionmanager/getinfo {}
+ */
+
+static bool handle_get_info_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	jvalue_ref reply = jobject_create();
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+
+
+	add_interface_info(reply, "wifiInfo", INTERFACE_FACTS_WIFI);
+	add_interface_info(reply, "wiredInfo", INTERFACE_FACTS_WIRED);
+	add_interface_info(reply, "cellularInfo", INTERFACE_FACTS_CELLULAR);
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+	{
+		LSMessageReplyErrorUnknown(sh,message);
+		goto cleanup;
+	}
+
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	jschema_release(&response_schema);
+
+cleanup:
+	if (LSErrorIsSet(&lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	j_release(&reply);
+	return true;
+}
+
+/* Shortest and default sampling interval of a monitorActivity subscriber, in milliseconds */
+#define ACTIVITY_MIN_INTERVAL		250
+#define ACTIVITY_DEFAULT_INTERVAL	1000
+
+static const char *activity_keys[INTERFACE_FACTS_MAX] = { "wifi", "wired", "cellular" };
+
+/**
+ * The counters a monitorActivity subscriber was last sent
+ */
+typedef struct activity_subscriber {
+	gboolean subscribed;
+	gboolean valid[INTERFACE_FACTS_MAX];
+	interface_stats_t last[INTERFACE_FACTS_MAX];
+} activity_subscriber_t;
+
+static void activity_tick(GPtrArray *due, gint64 now);
+
+static luna_service_periodic_t activity_periodic = {
+	.method = LUNA_METHOD_MONITORACTIVITY,
+	.min_period = ACTIVITY_MIN_INTERVAL,
+	.tick = activity_tick,
+};
+
+/**
+ *  @brief Read the counters of all configured interfaces once, for every subscriber
+ */
+
+static void activity_sample(interface_stats_t *stats, gboolean *valid)
+{
+	gint iface;
+
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+		valid[iface] = interface_facts_read_stats(iface, &stats[iface]);
+}
+
+static guint64 counter_delta(guint64 now, guint64 last)
+{
+	/* Counters start over when the interface is recreated */
+	return now >= last ? now - last : now;
+}
+
+/**
+ *  @brief Send a subscriber the counters, and what changed since its previous update
+ */
+
+static void activity_send(luna_service_periodic_subscriber_t *subscriber, const interface_stats_t *stats,
+				const gboolean *valid, gint64 now)
+{
+	activity_subscriber_t *state = subscriber->data;
+	LSError lserror;
+	LSErrorInit(&lserror);
+	gint iface;
+
+	gdouble elapsed = (now - subscriber->last_sent) / (gdouble) G_USEC_PER_SEC;
+	gboolean initial = (0 == subscriber->last_sent);
+
+	jvalue_ref reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	if(initial)
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(state->subscribed));
+	jobject_put(reply, J_CSTR_TO_JVAL("interval"), jnumber_create_i32(subscriber->interval));
+
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+	{
+		if(!valid[iface])
+			continue;
+
+		const interface_stats_t *current = &stats[iface];
+		jvalue_ref activity = jobject_create();
+		jobject_put(activity, J_CSTR_TO_JVAL("interfaceName"), jstring_create(interface_facts_get(iface)->name));
+		jobject_put(activity, J_CSTR_TO_JVAL("rxBytes"), jnumber_create_i64(current->rx_bytes));
+		jobject_put(activity, J_CSTR_TO_JVAL("txBytes"), jnumber_create_i64(current->tx_bytes));
+		jobject_put(activity, J_CSTR_TO_JVAL("rxPackets"), jnumber_create_i64(current->rx_packets));
+		jobject_put(activity, J_CSTR_TO_JVAL("txPackets"), jnumber_create_i64(current->tx_packets));
+
+		if(!initial && state->valid[iface] && elapsed > 0)
+		{
+			const interface_stats_t *last = &state->last[iface];
+			guint64 rx_bytes = counter_delta(current->rx_bytes, last->rx_bytes);
+			guint64 tx_bytes = counter_delta(current->tx_bytes, last->tx_bytes);
+
+			jobject_put(activity, J_CSTR_TO_JVAL("rxBytesDelta"), jnumber_create_i64(rx_bytes));
+			jobject_put(activity, J_CSTR_TO_JVAL("txBytesDelta"), jnumber_create_i64(tx_bytes));
+			jobject_put(activity, J_CSTR_TO_JVAL("rxPacketsDelta"),
+					jnumber_create_i64(counter_delta(current->rx_packets, last->rx_packets)));
+			jobject_put(activity, J_CSTR_TO_JVAL("txPacketsDelta"),
+					jnumber_create_i64(counter_delta(current->tx_packets, last->tx_packets)));
+			jobject_put(activity, J_CSTR_TO_JVAL("rxBytesPerSecond"), jnumber_create_f64(rx_bytes / elapsed));
+			jobject_put(activity, J_CSTR_TO_JVAL("txBytesPerSecond"), jnumber_create_f64(tx_bytes / elapsed));
+		}
+
+		jobject_put(reply, jstring_create(activity_keys[iface]), activity);
+	}
+
+	memcpy(state->last, stats, sizeof(state->last));
+	memcpy(state->valid, valid, sizeof(state->valid));
+	subscriber->last_sent = now;
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+		goto cleanup;
+
+	if (!luna_service_message_reply(subscriber->handle, subscriber->message, jvalue_tostring(reply, response_schema), &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	jschema_release(&response_schema);
+
+cleanup:
+	j_release(&reply);
+}
+
+/**
+ *  @brief Read the counters once and send them to every due subscriber
+ */
+
+static void activity_tick(GPtrArray *due, gint64 now)
+{
+	interface_stats_t stats[INTERFACE_FACTS_MAX];
+	gboolean valid[INTERFACE_FACTS_MAX];
+	guint i;
+
+	activity_sample(stats, valid);
+
+	for (i = 0; i < due->len; i++)
+		activity_send(g_ptr_array_index(due, i), stats, valid, now);
+}
+
+//->Start of API documentation comment block
+/**
+@page com_webos_connectionmanager com.webos.connectionmanager
+@{
+@section com_webos_connectionmanager_monitoractivity monitorActivity
+
+Report the traffic counters of the WiFi, wired and cellular interfaces.
+
+Subscribers get an update every "interval" milliseconds with the counters,
+the change since their previous update and the byte rates. One timer reads
+the counters for all subscribers and only runs while there are any.
+
+@par Parameters
+Name | Required | Type | Description
+-----|--------|------|----------
+subscribe | no | Boolean | Subscribe to periodic updates
+interval | no | Integer | Milliseconds between updates, at least 250, default 1000
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+subscribed | yes | Boolean | True if subscribed
+interval | yes | Integer | Milliseconds between updates
+wifi | no | Object | Activity of the wifi interface (see below)
+wired | no | Object | Activity of the wired interface (see below)
+cellular | no | Object | Activity of the cellular interface (see below)
+
+@par Activity Object
+Name | Required | Type | Description
+-----|--------|------|----------
+interfaceName | yes | String | Name of the network interface
+rxBytes | yes | Integer | Bytes received since the interface was created
+txBytes | yes | Integer | Bytes sent since the interface was created
+rxPackets | yes | Integer | Packets received since the interface was created
+txPackets | yes | Integer | Packets sent since the interface was created
+rxBytesDelta | no | Integer | Bytes received since the previous update
+txBytesDelta | no | Integer | Bytes sent since the previous update
+rxPacketsDelta | no | Integer | Packets received since the previous update
+txPacketsDelta | no | Integer | Packets sent since the previous update
+rxBytesPerSecond | no | Number | Receive rate since the previous update
+txBytesPerSecond | no | Number | Send rate since the previous update
+
+The delta and rate fields are left out of the first reply.
+
+@par Returns(Subscription)
+The same fields as the call, without "subscribed".
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ *  @brief Handler for "monitorActivity" command.
+ *
+ *  JSON format:
+ *
+ *  luna://com.palm.connectionmanager/monitorActivity {"subscribe":true,"interval":<milliseconds>}
+ *
+ *  @param sh
+ *  @param message
+ *  @param context
+ */
+
+static bool handle_monitor_activity_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	LSError lserror;
+	LSErrorInit(&lserror);
+	bool subscribed = false;
+
+	jvalue_ref parsedObj = {0};
+	jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!input_schema)
+		return false;
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
+	jschema_release(&input_schema);
+
+	if (jis_null(parsedObj))
+	{
+		LSMessageReplyErrorBadJSON(sh, message);
+		return true;
+	}
+
+	jvalue_ref intervalObj = {0};
+	int interval = ACTIVITY_DEFAULT_INTERVAL;
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("interval"), &intervalObj))
+	{
+		if(!jis_number(intervalObj))
+		{
+			LSMessageReplyErrorInvalidParams(sh, message);
+			goto cleanup;
+		}
+		jnumber_get_i32(intervalObj, &interval);
+		if(interval < ACTIVITY_MIN_INTERVAL)
+		{
+			LSMessageReplyErrorInvalidParams(sh, message);
+			goto cleanup;
+		}
+	}
+
+	if (luna_service_message_is_subscription(message))
+	{
+		if (!luna_service_subscription_process(sh, message, &subscribed, &lserror))
+		{
+			LSErrorPrint(&lserror, stderr);
+			LSErrorFree(&lserror);
+		}
+	}
+
+	interface_stats_t stats[INTERFACE_FACTS_MAX];
+	gboolean valid[INTERFACE_FACTS_MAX];
+	activity_sample(stats, valid);
+
+	activity_subscriber_t *state = g_new0(activity_subscriber_t, 1);
+	state->subscribed = subscribed;
+	luna_service_periodic_subscriber_t *subscriber = luna_service_periodic_subscriber_new(sh, message, interval,
+											state, g_free);
+
+	activity_send(subscriber, stats, valid, g_get_monotonic_time());
+
+	if(!subscribed)
+	{
+		luna_service_periodic_subscriber_free(subscriber);
+		goto cleanup;
+	}
+
+	luna_service_periodic_add(&activity_periodic, subscriber);
+
+cleanup:
+	j_release(&parsedObj);
+	return true;
+}
+
+//->Start of API documentation comment block
+/**
+@page com_webos_connectionmanager com.webos.connectionmanager
+@{
+@section com_webos_connectionmanager_getmetrics getmetrics
+
+Returns the runtime metrics collected by the adapter: latency histograms of
+its luna methods, of the calls it makes to connman and of the connman signals
+it handles, plus the subscriber fan-out and payload sizes of its replies.
+
+@par Parameters
+Name | Required | Type | Description
+-----|--------|------|----------
+reset | no | Boolean | True to reset all counters after they are returned
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+lunaMethodsUs | yes | Object | Histogram of handling time in microseconds per "<service>/<method>"
+dbusCallsUs | yes | Object | Histogram of connman call latency in microseconds per "<interface>.<method>"
+signalsUs | yes | Object | Histogram of connman signal handling time in microseconds per signal
+subscriptionFanout | yes | Object | Histogram of subscribers reached per subscription post, per method
+payloadBytes | yes | Object | Histogram of reply and post payload sizes in bytes, per method
+mainLoopStallsMs | yes | Object | Histogram of main loop stalls in milliseconds, per handler running during the stall
+
+@par Histogram Object
+Name | Required | Type | Description
+-----|--------|------|----------
+count | yes | Integer | Number of recorded values
+errors | yes | Integer | Number of values recorded for failed calls
+sum | yes | Integer | Sum of all recorded values
+max | yes | Integer | Largest recorded value
+p50 | yes | Integer | Upper bound of the bucket holding the median
+p99 | yes | Integer | Upper bound of the bucket holding the 99th percentile
+buckets | yes | Array | Counts per power of two bucket, the first one counting zero values
+
+@par Returns(Subscription)
+None
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ * Handler for "getmetrics" command.
+ *
+ * JSON format:
+ * luna://com.palm.connectionmanager/getmetrics {"reset":true}
+ */
+
+static bool handle_get_metrics_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	jvalue_ref parsedObj = {0};
+	jvalue_ref resetObj = {0};
+	jvalue_ref reply = NULL;
+	bool reset = false;
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!input_schema)
+		return false;
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
+	jschema_release(&input_schema);
+
+	if (jis_null(parsedObj))
 	{
-		connman_technology_register_property_changed_cb(technology, technology_property_changed_callback);
+		LSMessageReplyErrorBadJSON(sh, message);
+		return true;
 	}
 
-	technology = connman_manager_find_cellular_technology(manager);
-	if (technology)
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("reset"), &resetObj))
 	{
-		connman_technology_register_property_changed_cb(technology, technology_property_changed_callback);
+		if(!jis_boolean(resetObj))
+		{
+			LSMessageReplyErrorInvalidParams(sh, message);
+			goto cleanup;
+		}
+		jboolean_get(resetObj, &reset);
 	}
-	else
+
+	reply = metrics_to_json();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+	{
+		LSMessageReplyErrorUnknown(sh,message);
+		goto cleanup;
+	}
+
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	jschema_release(&response_schema);
+
+	if(reset)
+		metrics_reset();
+
+cleanup:
+	if(NULL != reply)
+		j_release(&reply);
+	j_release(&parsedObj);
+	return true;
+}
+
+//->Start of API documentation comment block
+/**
+@page com_webos_connectionmanager com.webos.connectionmanager
+@{
+@section com_webos_connectionmanager_getflightrecorder getflightrecorder
+
+Returns the last events kept by the adapter's flight recorder: connman
+signals, calls to connman and their replies, luna requests and replies and
+subscription posts. The same events are written to
+/var/run/webos-connman-adapter/events when the adapter receives SIGUSR1.
+
+@par Parameters
+None
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+events | yes | Array of Object | Recorded events, oldest first
+
+@par "event" Object
+Name | Required | Type | Description
+-----|--------|------|----------
+timestamp | yes | Integer | Monotonic time of the event in microseconds
+type | yes | String | signal, dbusCall, dbusReply, dbusError, lunaRequest, lunaReply or subscriptionPost
+name | yes | String | Signal, method or error name, empty for D-Bus replies
+arg | yes | Integer | D-Bus serial for D-Bus events, payload size for luna requests and replies, number of subscribers for posts
+
+@par Returns(Subscription)
+None
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ * Handler for "getflightrecorder" command.
+ *
+ * JSON format:
+ * luna://com.palm.connectionmanager/getflightrecorder {}
+ */
+
+static bool handle_get_flight_recorder_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	jvalue_ref reply = jobject_create();
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("events"), flight_recorder_to_json());
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+	{
+		LSMessageReplyErrorUnknown(sh,message);
+		goto cleanup;
+	}
+
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	jschema_release(&response_schema);
+
+cleanup:
+	j_release(&reply);
+	return true;
+}
+
+/**
+ *  @brief Callback function registered with connman technology whenever any of its properties change
+ *
+ *  @param data
+ *  @param property
+ *  @param value
+ */
+
+static void technology_property_changed_callback(gpointer data, const gchar *property, GVariant *value)
+{
+	connman_technology_t *technology = (connman_technology_t *)data;
+
+	if(NULL == technology)
+		return;
+
+	/* Need to send getstatus method to all com.palm.connectionmanager subscribers whenever the
+	   "powered" or "connected" state of the technology changes */
+
+	if(g_str_equal(property,"Powered") || g_str_equal(property,"Connected"))
+	{
+		connectionmanager_send_status();
+	}
+}
+
+/**
+ *  @brief Callback function registered with the technology registry whenever a
+ *  wired or cellular technology appears or goes away
+ */
+
+static void technology_presence_callback(connman_technology_t *technology, gboolean present)
+{
+	connectionmanager_send_status();
+}
+
+/**
+ *  @brief Callback function registered with the netlink monitor, called after a burst
+ *  of carrier or address changes on a configured interface
+ */
+
+static void link_changed_callback(void)
+{
+	network_state_invalidate();
+	connectionmanager_send_status();
+}
+
+/**
+ * com.palm.connectionmanager service Luna Method Table
+ */
+
+static LSMethod connectionmanager_methods[] = {
+    { LUNA_METHOD_GETSTATUS,            handle_get_status_command },
+    { LUNA_METHOD_GETSTATUS2,            handle_get_status_command },
+    { LUNA_METHOD_SETIPV4,              handle_set_ipv4_command },
+    { LUNA_METHOD_SETDNS,               handle_set_dns_command },
+    { LUNA_METHOD_SETNETWORKCONFIG,	handle_set_network_config_command },
+    { LUNA_METHOD_SETSTATE,             handle_set_state_command },
+    { LUNA_METHOD_GETINFO,		handle_get_info_command },
+    { LUNA_METHOD_MONITORACTIVITY,	handle_monitor_activity_command },
+    { LUNA_METHOD_GETMETRICS,		handle_get_metrics_command },
+    { LUNA_METHOD_GETFLIGHTRECORDER,	handle_get_flight_recorder_command },
+    { },
+};
+
+static LSMethod connectionmanager_public_methods[] = {
+    { LUNA_METHOD_GETSTATUS,            handle_get_status_command },
+    { LUNA_METHOD_GETSTATUS2,            handle_get_status_command },
+    { },
+};
+
+/**
+ * Methods which only read network state snapshots or lock free registries
+ * and so can run on the service's own context
+ */
+
+static const char * const connectionmanager_local_methods[] = {
+    LUNA_METHOD_GETSTATUS,
+    LUNA_METHOD_GETSTATUS2,
+    LUNA_METHOD_GETMETRICS,
+    LUNA_METHOD_GETFLIGHTRECORDER,
+    NULL,
+};
+
+/**
+ *  @brief Initialize com.palm.connectionmanager service and all of its methods
+ *  Also initialize a manager instance
+ */
+
+int initialize_connectionmanager_ls2_calls( GMainLoop *mainloop )
+{
+	LSError lserror;
+	LSErrorInit (&lserror);
+	pLsHandle       = NULL;
+	pLsPublicHandle = NULL;
+
+	if(NULL == mainloop)
+		goto Exit;
+
+	if (LSRegisterPubPriv(CONNECTIONMANAGER_LUNA_SERVICE_NAME, &pLsHandle, false, &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSRegister() private returned error");
+		goto Exit;
+	}
+
+	if (LSRegisterPubPriv(CONNECTIONMANAGER_LUNA_SERVICE_NAME, &pLsPublicHandle, true, &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSRegister() public returned error");
+		goto Exit;
+	}
+
+	luna_service_category_t *category = luna_service_category_new(CONNECTIONMANAGER_LUNA_SERVICE_NAME, connectionmanager_methods);
+	luna_service_category_t *public_category = luna_service_category_new(CONNECTIONMANAGER_LUNA_SERVICE_NAME, connectionmanager_public_methods);
+
+	/* With a context of its own only the snapshot based methods run here, the others
+	   are handed over to the main context which owns the connman objects */
+	if (g_main_loop_get_context(mainloop) != g_main_context_default())
+	{
+		service_context = g_main_loop_get_context(mainloop);
+		luna_service_category_set_owner(category, g_main_context_default(), connectionmanager_local_methods);
+		luna_service_category_set_owner(public_category, g_main_context_default(), connectionmanager_local_methods);
+
+		/* Replies from the main context must still go out through the handles' context */
+		luna_service_handle_set_context(pLsHandle, service_context);
+		luna_service_handle_set_context(pLsPublicHandle, service_context);
+	}
+
+	if (luna_service_register_category(pLsHandle, category, &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSRegisterCategory() returned error");
+		goto Exit;
+	}
+
+	if (luna_service_register_category(pLsPublicHandle, public_category, &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSRegisterCategory() returned error");
+		goto Exit;
+	}
+
+	if (LSGmainAttach(pLsHandle, mainloop, &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSGmainAttach() private returned error");
+		goto Exit;
+	}
+
+	if (LSGmainAttach(pLsPublicHandle, mainloop, &lserror) == false)
 	{
-		g_timeout_add(500, check_cellular_status_cb, 0);
+		WCA_LOG_FATAL("LSGmainAttach() public returned error");
+		goto Exit;
+	}
+
+	/* Method calls go ahead of connman signals and background work */
+	if (LSGmainSetPriority(pLsHandle, scheduler_priority(SCHEDULER_CLASS_INTERACTIVE), &lserror) == false
+		|| LSGmainSetPriority(pLsPublicHandle, scheduler_priority(SCHEDULER_CLASS_INTERACTIVE), &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSGmainSetPriority() returned error");
+		goto Exit;
 	}
 
+	/* Observe the wired and cellular technologies' "PropertyChanged" signal whenever they
+	   exist (For wifi its being done in wifi_service.c) */
+	technology_registry_add_observer(CONNMAN_TECHNOLOGY_TYPE_ETHERNET, technology_property_changed_callback, technology_presence_callback);
+	technology_registry_add_observer(CONNMAN_TECHNOLOGY_TYPE_CELLULAR, technology_property_changed_callback, technology_presence_callback);
+
+	/* Without it cable and address changes still arrive, later, through connman */
+	if(!netlink_monitor_start(link_changed_callback))
+		WCA_LOG_ERROR("Could not start watching link changes");
+
 	return 0;
 
 Exit:
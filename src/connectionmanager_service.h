@@ -36,8 +36,12 @@
 #define LUNA_METHOD_GETSTATUS2		"getStatus"
 #define LUNA_METHOD_SETIPV4		"setipv4"
 #define LUNA_METHOD_SETDNS		"setdns"
+#define LUNA_METHOD_SETNETWORKCONFIG	"setnetworkconfig"
 #define LUNA_METHOD_SETSTATE		"setstate"
 #define LUNA_METHOD_GETINFO		"getinfo"
+#define LUNA_METHOD_MONITORACTIVITY	"monitorActivity"
+#define LUNA_METHOD_GETMETRICS		"getmetrics"
+#define LUNA_METHOD_GETFLIGHTRECORDER	"getflightrecorder"
 
 extern void connectionmanager_send_status(void);
 extern int initialize_connectionmanager_ls2_calls(GMainLoop *mainloop);
@@ -28,6 +28,7 @@
 
 #include "connman_agent.h"
 #include "logging.h"
+#include "watchdog.h"
 
 #define AGENT_DBUS_PATH			"/"
 #define AGENT_ERROR_CANCELED	"net.connman.Agent.Error.Canceled"
@@ -39,11 +40,48 @@ struct connman_agent {
 	gpointer registered_data;
 	connman_agent_request_input_cb request_input_cb;
 	gpointer request_input_data;
+	GHashTable *requests;	/* service path -> struct agent_request */
 	connman_agent_report_error_cb report_error_cb;
 	gpointer report_error_data;
 	guint bus_id;
 };
 
+/**
+ * Credentials handler registered for one service
+ */
+struct agent_request {
+	connman_agent_t *agent;
+	gchar *path;
+	connman_agent_request_input_cb cb;
+	gpointer data;
+	GDestroyNotify destroy;
+	guint timeout_source;
+};
+
+static void agent_request_free(gpointer data)
+{
+	struct agent_request *request = data;
+
+	if (request->timeout_source > 0)
+		g_source_remove(request->timeout_source);
+	if (request->destroy != NULL)
+		request->destroy(request->data);
+	g_free(request->path);
+	g_free(request);
+}
+
+static gboolean agent_request_expired_cb(gpointer user_data)
+{
+	struct agent_request *request = user_data;
+
+	WCA_LOG_DEBUG("Agent request for %s expired", request->path);
+
+	request->timeout_source = 0;
+	g_hash_table_remove(request->agent->requests, request->path);
+
+	return FALSE;
+}
+
 static gboolean request_input_cb(ConnmanInterfaceAgent *interface,
 								 GDBusMethodInvocation *invocation,
 								 const gchar *path,
@@ -52,14 +90,25 @@ static gboolean request_input_cb(ConnmanInterfaceAgent *interface,
 {
 	connman_agent_t *agent = user_data;
 	GVariant *response = NULL;
+	connman_agent_request_input_cb cb = agent->request_input_cb;
+	gpointer data = agent->request_input_data;
+
+	/* A handler registered for the service takes precedence over the global one */
+	struct agent_request *request = g_hash_table_lookup(agent->requests, path);
+	if (request != NULL) {
+		cb = request->cb;
+		data = request->data;
+	}
 
-	if (agent->request_input_cb == NULL) {
+	if (cb == NULL) {
 		g_dbus_method_invocation_return_dbus_error(invocation, AGENT_ERROR_CANCELED,
 			"No handler available");
 	}
 	else {
-		response = agent->request_input_cb(fields, agent->request_input_data);
+		const gchar *previous_activity = watchdog_enter("Agent.RequestInput");
+		response = cb(fields, data);
 		connman_interface_agent_complete_request_input(agent->interface, invocation, response);
+		watchdog_leave(previous_activity);
 	}
 
 	return TRUE;
@@ -78,7 +127,9 @@ static gboolean report_error_cb(ConnmanInterfaceAgent *interface,
 			"No handler available");
 	}
 	else {
+		const gchar *previous_activity = watchdog_enter("Agent.ReportError");
 		agent->report_error_cb(error_message, agent->report_error_data);
+		watchdog_leave(previous_activity);
 	}
 
 	return TRUE;
@@ -121,6 +172,8 @@ connman_agent_t* connman_agent_new(void)
 		return NULL;
 	}
 
+	agent->requests = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, agent_request_free);
+
 	agent->bus_id = g_bus_own_name(G_BUS_TYPE_SYSTEM, "com.palm.wifi", G_BUS_NAME_OWNER_FLAGS_NONE,
 				bus_acquired_cb, NULL, NULL, agent, NULL);
 
@@ -134,6 +187,8 @@ void connman_agent_free(connman_agent_t *agent)
 
 	g_bus_unown_name(agent->bus_id);
 
+	g_hash_table_destroy(agent->requests);
+
 	if (agent->path)
 		g_free(agent->path);
 
@@ -170,6 +225,35 @@ void connman_agent_set_request_input_callback(connman_agent_t *agent, connman_ag
 	agent->request_input_data = user_data;
 }
 
+void connman_agent_add_request_input(connman_agent_t *agent, const gchar *service_path,
+		connman_agent_request_input_cb cb, gpointer user_data, GDestroyNotify destroy, guint timeout_ms)
+{
+	struct agent_request *request;
+
+	if (agent == NULL || service_path == NULL)
+		return;
+
+	request = g_new0(struct agent_request, 1);
+	request->agent = agent;
+	request->path = g_strdup(service_path);
+	request->cb = cb;
+	request->data = user_data;
+	request->destroy = destroy;
+	if (timeout_ms > 0)
+		request->timeout_source = g_timeout_add(timeout_ms, agent_request_expired_cb, request);
+
+	/* Replaces, and frees, an older handler for the same service */
+	g_hash_table_replace(agent->requests, request->path, request);
+}
+
+void connman_agent_remove_request_input(connman_agent_t *agent, const gchar *service_path)
+{
+	if (agent == NULL || service_path == NULL)
+		return;
+
+	g_hash_table_remove(agent->requests, service_path);
+}
+
 void connman_agent_set_report_error_callback(connman_agent_t *agent, connman_agent_report_error_cb cb, gpointer user_data)
 {
 	if (agent == NULL)
@@ -40,6 +40,14 @@ void connman_agent_free(connman_agent_t *agent);
 gchar *connman_agent_get_path(connman_agent_t *agent);
 void connman_agent_set_registered_callback(connman_agent_t *agent, connman_agent_registered_cb cb, gpointer user_data);
 void connman_agent_set_request_input_callback(connman_agent_t *agent, connman_agent_request_input_cb cb, gpointer user_data);
+
+/* Time connman waits for an answer to RequestInput */
+#define CONNMAN_AGENT_REQUEST_TIMEOUT	120000
+
+/* Handle RequestInput for one service path, until removed or timeout_ms (0 for never) expires */
+void connman_agent_add_request_input(connman_agent_t *agent, const gchar *service_path,
+		connman_agent_request_input_cb cb, gpointer user_data, GDestroyNotify destroy, guint timeout_ms);
+void connman_agent_remove_request_input(connman_agent_t *agent, const gchar *service_path);
 void connman_agent_set_report_error_cb(connman_agent_t *agent, connman_agent_report_error_cb cb, gpointer user_data);
 
 #endif
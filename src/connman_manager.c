@@ -26,6 +26,10 @@
 
 #include "connman_manager.h"
 #include "logging.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "network_state.h"
+#include "technology_registry.h"
 
 /**
  * Retrieve all the properties of the given manager instance
@@ -369,11 +373,65 @@ static void connman_manager_free_services(connman_manager_t *manager)
  *
  */
 
+/**
+ * Keep a technology in the slot of its type, unless another one of the same
+ * type holds it already
+ */
+
+static void add_technology(connman_manager_t *manager, connman_technology_t *technology)
+{
+	manager->technologies = g_slist_append(manager->technologies, technology);
+
+	if(CONNMAN_TECHNOLOGY_TYPE_UNKNOWN != technology->type_id &&
+		NULL == manager->technology_slots[technology->type_id])
+	{
+		manager->technology_slots[technology->type_id] = technology;
+		technology_registry_technology_added(technology);
+	}
+}
+
+/**
+ * Drop a technology from the list and its slot, handing the slot to another
+ * technology of the same type if there is one
+ */
+
+static void remove_technology(connman_manager_t *manager, connman_technology_t *technology)
+{
+	GSList *iter;
+
+	manager->technologies = g_slist_remove(manager->technologies, technology);
+
+	if(manager->technology_slots[technology->type_id] != technology)
+		return;
+
+	technology_registry_technology_removed(technology);
+	manager->technology_slots[technology->type_id] = NULL;
+
+	for (iter = manager->technologies; NULL != iter; iter = iter->next)
+	{
+		connman_technology_t *other = (connman_technology_t *)(iter->data);
+
+		if(other->type_id == technology->type_id)
+		{
+			manager->technology_slots[other->type_id] = other;
+			technology_registry_technology_added(other);
+			break;
+		}
+	}
+}
+
 static void connman_manager_free_technologies(connman_manager_t *manager)
 
 {
 	if(NULL == manager)
 		return;
+	gint type;
+	for (type = 0; type < CONNMAN_TECHNOLOGY_TYPE_MAX; type++)
+	{
+		if(NULL != manager->technology_slots[type])
+			technology_registry_technology_removed(manager->technology_slots[type]);
+		manager->technology_slots[type] = NULL;
+	}
 	g_slist_foreach(manager->technologies, (GFunc) connman_technology_free, NULL);
 	g_slist_free(manager->technologies);
 	manager->technologies = NULL;
@@ -457,7 +515,9 @@ static gboolean connman_manager_add_technologies (connman_manager_t *manager)
 		connman_technology_t *technology;
 
 		technology = connman_technology_new(technology_v);
-		manager->technologies = g_slist_append(manager->technologies, technology);
+		if(NULL == technology)
+			continue;
+		add_technology(manager, technology);
 	}
 
 	return TRUE;
@@ -525,19 +585,7 @@ connman_technology_t *connman_manager_find_wifi_technology (connman_manager_t *m
 	if(NULL == manager)
 		return NULL;
 
-	GSList *iter;
-
-	for (iter = manager->technologies; NULL != iter; iter = iter->next)
-	{
-		connman_technology_t *tech = (struct connman_technology *)(iter->data);
-
-		if (g_str_equal("wifi", tech->type))
-		{
-			return tech;
-		}
-	}
-
-	return NULL;
+	return manager->technology_slots[CONNMAN_TECHNOLOGY_TYPE_WIFI];
 }
 
 /**
@@ -550,19 +598,7 @@ connman_technology_t *connman_manager_find_ethernet_technology (connman_manager_
 	if(NULL == manager)
 		return NULL;
 
-	GSList *iter;
-
-	for (iter = manager->technologies; NULL != iter; iter = iter->next)
-	{
-		connman_technology_t *tech = (struct connman_technology *)(iter->data);
-
-		if (g_str_equal("ethernet", tech->type))
-		{
-			return tech;
-		}
-	}
-
-	return NULL;
+	return manager->technology_slots[CONNMAN_TECHNOLOGY_TYPE_ETHERNET];
 }
 
 connman_technology_t *connman_manager_find_cellular_technology (connman_manager_t *manager)
@@ -570,19 +606,7 @@ connman_technology_t *connman_manager_find_cellular_technology (connman_manager_
 	if(NULL == manager)
 		return NULL;
 
-	GSList *iter;
-
-	for (iter = manager->technologies; NULL != iter; iter = iter->next)
-	{
-		connman_technology_t *tech = (struct connman_technology *)(iter->data);
-
-		if (g_str_equal("cellular", tech->type))
-		{
-			return tech;
-		}
-	}
-
-	return NULL;
+	return manager->technology_slots[CONNMAN_TECHNOLOGY_TYPE_CELLULAR];
 }
 
 /**
@@ -629,15 +653,26 @@ static void
 property_changed_cb(ConnmanInterfaceManager *proxy,const gchar * property, GVariant *v,
 	      connman_manager_t      *manager)
 {
+	gint64 start = g_get_monotonic_time();
+	const gchar *previous_activity = watchdog_enter("Manager.PropertyChanged");
 	GVariant *va = g_variant_get_child_value(v, 0);
 	WCA_LOG_DEBUG("Manager property %s changed : %s",property, g_variant_get_string(va,NULL));
 	if(!g_strcmp0(property,"State"))
 	{
 		g_free(manager->state);
 		manager->state = g_strdup(g_variant_get_string(va, NULL));
+		network_state_invalidate();
+	}
+	else if(!g_strcmp0(property,"OfflineMode"))
+	{
+		manager->offline = g_variant_get_boolean(va);
+		network_state_invalidate();
 	}
 	if(NULL != manager->handle_property_change_fn)
 		(manager->handle_property_change_fn)((gpointer)manager, property, v);
+
+	metrics_record_since(METRICS_GROUP_SIGNAL, "Manager.PropertyChanged", start);
+	watchdog_leave(previous_activity);
 }
 
 
@@ -649,15 +684,24 @@ static void
 technology_added_cb(ConnmanInterfaceManager *proxy, gchar * path, GVariant *v,
 	      connman_manager_t      *manager)
 {
+	gint64 start = g_get_monotonic_time();
+	const gchar *previous_activity = watchdog_enter("Manager.TechnologyAdded");
 	WCA_LOG_DEBUG("Technology %s added", path);
 
 	if(NULL == find_technology_by_path(manager,path))
 	{
 		GVariant *technology_v = g_variant_new("(o@a{sv})",path, v);
 		connman_technology_t *technology = connman_technology_new(technology_v);
-		WCA_LOG_DEBUG("Updating manager's technology list");
-		manager->technologies = g_slist_append(manager->technologies, technology);
+		if(NULL != technology)
+		{
+			WCA_LOG_DEBUG("Updating manager's technology list");
+			add_technology(manager, technology);
+			network_state_invalidate();
+		}
 	}
+
+	metrics_record_since(METRICS_GROUP_SIGNAL, "Manager.TechnologyAdded", start);
+	watchdog_leave(previous_activity);
 }
 
 /**
@@ -668,13 +712,19 @@ static void
 technology_removed_cb(ConnmanInterfaceManager *proxy, gchar * path,
 	      connman_manager_t      *manager)
 {
+	gint64 start = g_get_monotonic_time();
+	const gchar *previous_activity = watchdog_enter("Manager.TechnologyRemoved");
 	WCA_LOG_DEBUG("Technology removed");
 	connman_technology_t *technology = find_technology_by_path(manager, path);
 	if(NULL != technology)
 	{
-		manager->technologies = g_slist_remove_link(manager->technologies, g_slist_find(manager->technologies, technology));
+		remove_technology(manager, technology);
 		connman_technology_free(technology, NULL);
+		network_state_invalidate();
 	}
+
+	metrics_record_since(METRICS_GROUP_SIGNAL, "Manager.TechnologyRemoved", start);
+	watchdog_leave(previous_activity);
 }
 
 /**
@@ -685,14 +735,20 @@ static void
 services_changed_cb(ConnmanInterfaceManager *proxy, GVariant *services_added,
 		gchar **services_removed, connman_manager_t *manager)
 {
+	gint64 start = g_get_monotonic_time();
+	const gchar *previous_activity = watchdog_enter("Manager.ServicesChanged");
 	WCA_LOG_DEBUG("Services_changed ");
 	gboolean update_status = connman_manager_update_services(manager, services_added);
 	gboolean remove_status = connman_manager_remove_old_services(manager, services_removed);
 	if(update_status || remove_status)
 	{
+		network_state_invalidate();
 		if(NULL != manager->handle_services_change_fn)
 			(manager->handle_services_change_fn)(manager);
 	}
+
+	metrics_record_since(METRICS_GROUP_SIGNAL, "Manager.ServicesChanged", start);
+	watchdog_leave(previous_activity);
 }
 
 gboolean connman_manager_set_offline(connman_manager_t *manager, gboolean state)
@@ -818,6 +874,12 @@ static void connman_manager_update_state(connman_manager_t *manager)
 			g_free(manager->state);
 			manager->state = g_strdup(g_variant_get_string(va, NULL));
 		}
+		else if (!g_strcmp0(key, "OfflineMode"))
+		{
+			GVariant *v = g_variant_get_child_value(property, 1);
+			GVariant *va = g_variant_get_variant(v);
+			manager->offline = g_variant_get_boolean(va);
+		}
 	}
 }
 
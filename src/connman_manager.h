@@ -49,10 +49,12 @@ typedef struct connman_manager
 {
 	ConnmanInterfaceManager	*remote;
 	gchar   *state;
+	gboolean offline;	/* cached "OfflineMode" property */
 	GSList	*wifi_services;
 	GSList	*wired_services;
 	GSList	*cellular_services;
-	GSList	*technologies;
+	GSList	*technologies;	/* for iteration, look up by type in technology_slots */
+	connman_technology_t *technology_slots[CONNMAN_TECHNOLOGY_TYPE_MAX];	/* indexed by type_id, NULL if none */
 	connman_property_changed_cb	handle_property_change_fn;
 	connman_services_changed_cb	handle_services_change_fn;
 }connman_manager_t;
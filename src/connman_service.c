@@ -26,10 +26,27 @@
 #include "connman_service.h"
 #include "utils.h"
 #include "logging.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "network_state.h"
 
 /* gdbus default timeout is 25 seconds */
 #define DBUS_CALL_TIMEOUT	(60 * 1000)
 
+/* Source of service generations, unique across services so a service
+   recreated at the same path never matches a stale snapshot entry */
+static guint service_generation = 0;
+
+/**
+ * Give the service a new generation and invalidate the network state snapshot
+ */
+
+static void service_changed(connman_service_t *service)
+{
+	service->generation = ++service_generation;
+	network_state_invalidate();
+}
+
 /**
  * Check if the type of the service is wifi (see header for API details)
  */
@@ -120,15 +137,15 @@ int connman_service_get_state(const gchar *state)
 /**
  * Asynchronous connect callback for a remote "connect" call
  */
-static void connect_callback(GDBusConnection *connection, GAsyncResult *res, gpointer user_data)
+static void connect_callback(GObject *source, GAsyncResult *res, gpointer user_data)
 {
 	GError *error = NULL;
 	struct cb_data *cbd = user_data;
-	connman_service_t *service = cbd->user;
 	connman_service_connect_cb cb = cbd->cb;
 	gboolean ret = FALSE;
 
-	ret = connman_interface_service_call_connect_finish(service->remote, res, &error);
+	/* The service may be gone by now, the proxy is kept alive by the call */
+	ret = connman_interface_service_call_connect_finish(CONNMAN_INTERFACE_SERVICE(source), res, &error);
 	if (error)
 	{
 		WCA_LOG_CRITICAL("Error: %s", error->message);
@@ -183,6 +200,48 @@ gboolean connman_service_disconnect(connman_service_t *service)
 	return TRUE;
 }
 
+/**
+ * Asynchronous disconnect callback for a remote "disconnect" call
+ */
+static void disconnect_callback(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	struct cb_data *cbd = user_data;
+	connman_service_connect_cb cb = cbd->cb;
+	gboolean ret = FALSE;
+
+	ret = connman_interface_service_call_disconnect_finish(CONNMAN_INTERFACE_SERVICE(source), res, &error);
+	if (error)
+	{
+		WCA_LOG_CRITICAL("Error: %s", error->message);
+		/* Not being connected anymore is what we asked for */
+		if (NULL != g_strrstr(error->message,"NotConnected"))
+			ret = TRUE;
+		g_error_free(error);
+	}
+
+	if (cb != NULL)
+		cb(ret, cbd->data);
+	g_free(cbd);
+}
+
+/**
+ * Disconnect from a remote connman service without waiting (see header for API details)
+ */
+
+gboolean connman_service_disconnect_async(connman_service_t *service, connman_service_connect_cb cb, gpointer user_data)
+{
+	struct cb_data *cbd;
+
+	if (NULL == service)
+		return FALSE;
+
+	cbd = cb_data_new(cb, user_data);
+	connman_interface_service_call_disconnect(service->remote, NULL, (GAsyncReadyCallback) disconnect_callback, cbd);
+
+	return TRUE;
+}
+
 /**
  * Remove a remote connman service (see header for API details)
  */
@@ -209,11 +268,8 @@ gboolean connman_service_remove(connman_service_t *service)
  * Sets ipv4 properties for the connman service (see header for API details)
  */
 
-gboolean connman_service_set_ipv4(connman_service_t *service, ipv4info_t *ipv4)
+static GVariant *ipv4_configuration(ipv4info_t *ipv4)
 {
-	if(NULL == service || NULL == ipv4)
-		return FALSE;
-
 	GVariantBuilder *ipv4_b;
 	GVariant *ipv4_v;
 
@@ -227,7 +283,17 @@ gboolean connman_service_set_ipv4(connman_service_t *service, ipv4info_t *ipv4)
 	if(NULL != ipv4->gateway)
 		g_variant_builder_add (ipv4_b, "{sv}", "Gateway", g_variant_new_string(ipv4->gateway));
 	ipv4_v = g_variant_builder_end (ipv4_b);
+	g_variant_builder_unref (ipv4_b);
+
+	return ipv4_v;
+}
 
+gboolean connman_service_set_ipv4(connman_service_t *service, ipv4info_t *ipv4)
+{
+	if(NULL == service || NULL == ipv4)
+		return FALSE;
+
+	GVariant *ipv4_v = ipv4_configuration(ipv4);
 	GError *error = NULL;
 
 	connman_interface_service_call_set_property_sync(service->remote, "IPv4.Configuration", g_variant_new_variant(ipv4_v), NULL, &error);
@@ -287,6 +353,82 @@ gboolean connman_service_set_autoconnect(connman_service_t *service, gboolean va
 	return TRUE;
 }
 
+/**
+ * Asynchronous callback for a remote "SetProperty" call
+ */
+static void set_property_callback(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	struct cb_data *cbd = user_data;
+	connman_service_set_property_cb cb = cbd->cb;
+
+	gboolean ret = connman_interface_service_call_set_property_finish(CONNMAN_INTERFACE_SERVICE(source), res, &error);
+	if (error)
+		WCA_LOG_CRITICAL("Error: %s", error->message);
+
+	if (cb != NULL)
+		cb(ret, (NULL != error) ? error->message : NULL, cbd->data);
+
+	if (error)
+		g_error_free(error);
+	g_free(cbd);
+}
+
+/**
+ * Send a SetProperty call without waiting for its reply. Calls sent
+ * back to back are handled by connman in the order they were sent.
+ */
+static gboolean set_property_async(connman_service_t *service, const gchar *name, GVariant *value,
+				connman_service_set_property_cb cb, gpointer user_data)
+{
+	struct cb_data *cbd = cb_data_new(cb, user_data);
+
+	connman_interface_service_call_set_property(service->remote, name, g_variant_new_variant(value), NULL,
+				(GAsyncReadyCallback) set_property_callback, cbd);
+
+	return TRUE;
+}
+
+/**
+ * Sets ipv4 properties without waiting (see header for API details)
+ */
+
+gboolean connman_service_set_ipv4_async(connman_service_t *service, ipv4info_t *ipv4,
+				connman_service_set_property_cb cb, gpointer user_data)
+{
+	if(NULL == service || NULL == ipv4)
+		return FALSE;
+
+	return set_property_async(service, "IPv4.Configuration", ipv4_configuration(ipv4), cb, user_data);
+}
+
+/**
+ * Sets nameservers without waiting (see header for API details)
+ */
+
+gboolean connman_service_set_nameservers_async(connman_service_t *service, GStrv dns,
+				connman_service_set_property_cb cb, gpointer user_data)
+{
+	if(NULL == service || NULL == dns)
+		return FALSE;
+
+	return set_property_async(service, "Nameservers.Configuration",
+			g_variant_new_strv((const gchar * const*)dns, g_strv_length(dns)), cb, user_data);
+}
+
+/**
+ * Set auto-connect property without waiting (see header for API details)
+ */
+
+gboolean connman_service_set_autoconnect_async(connman_service_t *service, gboolean value,
+				connman_service_set_property_cb cb, gpointer user_data)
+{
+	if(NULL == service)
+		return FALSE;
+
+	return set_property_async(service, "AutoConnect", g_variant_new_boolean(value), cb, user_data);
+}
+
 /**
  * Get all the network related information for a connected service (in online state)
  * (see header for API details)
@@ -383,6 +525,8 @@ gboolean connman_service_get_ipinfo(connman_service_t *service)
 			service->ipinfo.dns = g_variant_dup_strv(va, NULL);
 		}
 	}
+
+	service_changed(service);
 	return TRUE;
 }
 
@@ -428,6 +572,133 @@ const gchar *get_service_mac_address(connman_service_t *connected_service)
 }
 
 
+/**
+ * Update the cached IPv4 settings from an "IPv4" dictionary
+ *
+ * connman always sends the whole dictionary, so settings missing from it
+ * are gone, e.g. the address after losing the DHCP lease.
+ */
+
+static void update_ipv4(connman_service_t *service, GVariant *ipv4)
+{
+	GVariantIter iter;
+	gchar *key;
+	GVariant *value;
+
+	g_free(service->ipinfo.ipv4.method);
+	g_free(service->ipinfo.ipv4.address);
+	g_free(service->ipinfo.ipv4.netmask);
+	g_free(service->ipinfo.ipv4.gateway);
+	service->ipinfo.ipv4.method = NULL;
+	service->ipinfo.ipv4.address = NULL;
+	service->ipinfo.ipv4.netmask = NULL;
+	service->ipinfo.ipv4.gateway = NULL;
+
+	g_variant_iter_init(&iter, ipv4);
+	while (g_variant_iter_next(&iter, "{sv}", &key, &value))
+	{
+		gchar **field = NULL;
+
+		if(g_str_equal(key, "Method"))
+			field = &service->ipinfo.ipv4.method;
+		else if(g_str_equal(key, "Address"))
+			field = &service->ipinfo.ipv4.address;
+		else if(g_str_equal(key, "Netmask"))
+			field = &service->ipinfo.ipv4.netmask;
+		else if(g_str_equal(key, "Gateway"))
+			field = &service->ipinfo.ipv4.gateway;
+
+		if(NULL != field)
+		{
+			g_free(*field);
+			*field = g_variant_dup_string(value, NULL);
+		}
+
+		g_free(key);
+		g_variant_unref(value);
+	}
+}
+
+/**
+ * Update the cached interface name from an "Ethernet" dictionary
+ */
+
+static void update_ethernet(connman_service_t *service, GVariant *ethernet)
+{
+	gchar *iface = NULL;
+
+	if(g_variant_lookup(ethernet, "Interface", "s", &iface))
+	{
+		g_free(service->ipinfo.iface);
+		service->ipinfo.iface = iface;
+	}
+}
+
+/**
+ * Update a single cached property of the service
+ *
+ * @return TRUE if the property is one we cache
+ */
+
+static gboolean update_property(connman_service_t *service, const gchar *key, GVariant *val)
+{
+	if (g_str_equal(key, "Name"))
+	{
+		g_free(service->name);
+		service->name =  g_variant_dup_string(val, NULL);
+	}
+	else if (g_str_equal(key, "Type"))
+	{
+		const gchar *v = g_variant_get_string(val, NULL);
+
+		if (g_str_equal(v, "wifi"))
+			service->type = CONNMAN_SERVICE_TYPE_WIFI;
+
+		if (g_str_equal(v, "ethernet"))
+			service->type = CONNMAN_SERVICE_TYPE_ETHERNET;
+
+		if (g_str_equal(v, "cellular"))
+			service->type = CONNMAN_SERVICE_TYPE_CELLULAR;
+	}
+	else if (g_str_equal(key, "Strength"))
+	{
+		service->strength = g_variant_get_byte(val);
+		/* Exponentially weighted, each new reading counts for a quarter */
+		if (0 == service->smoothed_strength)
+			service->smoothed_strength = service->strength;
+		else
+			service->smoothed_strength = (3 * service->smoothed_strength + service->strength + 2) / 4;
+
+		if (NULL == service->signal_history)
+			service->signal_history = signal_history_new();
+		signal_history_add(service->signal_history, g_get_monotonic_time(), service->strength);
+	}
+	else if(g_str_equal(key, "Security"))
+	{
+		g_strfreev(service->security);
+		service->security = g_variant_dup_strv(val, NULL);
+	}
+	else if (g_str_equal(key, "AutoConnect"))
+		service->auto_connect = g_variant_get_boolean(val);
+	else if (g_str_equal(key, "Immutable"))
+		service->immutable = g_variant_get_boolean(val);
+	else if (g_str_equal(key, "Favorite"))
+		service->favorite = g_variant_get_boolean(val);
+	else if (g_str_equal(key, "IPv4"))
+		update_ipv4(service, val);
+	else if (g_str_equal(key, "Nameservers"))
+	{
+		g_strfreev(service->ipinfo.dns);
+		service->ipinfo.dns = g_variant_dup_strv(val, NULL);
+	}
+	else if (g_str_equal(key, "Ethernet"))
+		update_ethernet(service, val);
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
 /**
  * Callback for service's "property_changed" signal
  */
@@ -436,14 +707,30 @@ static void
 property_changed_cb(ConnmanInterfaceService *proxy, gchar * property, GVariant *v,
               connman_service_t      *service)
 {
+	gint64 start = g_get_monotonic_time();
+	const gchar *previous_activity = watchdog_enter("Service.PropertyChanged");
+
+	GVariant *value = g_variant_get_variant(v);
+
 	/* Invoke function pointers only for state changed */
-	if(g_str_equal(property, "State") == FALSE)
-		return;
-	g_free(service->state);
-	service->state = g_variant_dup_string(g_variant_get_variant(v), NULL);
+	if(g_str_equal(property, "State"))
+	{
+		g_free(service->state);
+		service->state = g_variant_dup_string(value, NULL);
+		service_changed(service);
 
-	if(NULL != service->handle_state_change_fn)
-		(service->handle_state_change_fn)((gpointer)service, service->state);
+		if(NULL != service->handle_state_change_fn)
+			(service->handle_state_change_fn)((gpointer)service, service->state);
+	}
+	else if(update_property(service, property, value))
+	{
+		service_changed(service);
+	}
+
+	g_variant_unref(value);
+
+	metrics_record_since(METRICS_GROUP_SIGNAL, "Service.PropertyChanged", start);
+	watchdog_leave(previous_activity);
 }
 
 /**
@@ -492,25 +779,7 @@ void connman_service_update_properties(connman_service_t *service, GVariant *pro
 		GVariant *val_v = g_variant_get_child_value(property, 1);
 		GVariant *val = g_variant_get_variant(val_v);
 		const gchar *key = g_variant_get_string(key_v, NULL);
-		if (g_str_equal(key, "Name"))
-		{
-			g_free(service->name);
-			service->name =  g_variant_dup_string(val, NULL);
-		}
-		else if (g_str_equal(key, "Type"))
-		{
-			const gchar *v = g_variant_get_string(val, NULL);
-
-			if (g_str_equal(v, "wifi"))
-				service->type = CONNMAN_SERVICE_TYPE_WIFI;
-
-			if (g_str_equal(v, "ethernet"))
-				service->type = CONNMAN_SERVICE_TYPE_ETHERNET;
-
-			if (g_str_equal(v, "cellular"))
-				service->type = CONNMAN_SERVICE_TYPE_CELLULAR;
-		}
-		else if (g_str_equal(key, "State"))
+		if (g_str_equal(key, "State"))
 		{
 			g_free(service->state);
 			service->state =  g_variant_dup_string(val, NULL);
@@ -518,20 +787,16 @@ void connman_service_update_properties(connman_service_t *service, GVariant *pro
 			if(g_str_equal(service->state, "association"))
 				service->hidden = TRUE;
 		}
-		else if (g_str_equal(key, "Strength"))
-			service->strength = g_variant_get_byte(val);
-		else if(g_str_equal(key, "Security"))
-		{
-			g_strfreev(service->security);
-			service->security = g_variant_dup_strv(val, NULL);
-		}
-		else if (g_str_equal(key, "AutoConnect"))
-			service->auto_connect = g_variant_get_boolean(val);
-		else if (g_str_equal(key, "Immutable"))
-			service->immutable = g_variant_get_boolean(val);
-		else if (g_str_equal(key, "Favorite"))
-			service->favorite = g_variant_get_boolean(val);
+		else
+			update_property(service, key, val);
+
+		g_variant_unref(val);
+		g_variant_unref(val_v);
+		g_variant_unref(key_v);
+		g_variant_unref(property);
 	}
+
+	service_changed(service);
 }
 
 /**
@@ -603,6 +868,7 @@ void connman_service_free(gpointer data, gpointer user_data)
 	g_free(service->ipinfo.ipv4.netmask);
 	g_free(service->ipinfo.ipv4.gateway);
 	g_strfreev(service->ipinfo.dns);
+	signal_history_free(service->signal_history);
 
 	if(service->sighandler_id)
 		g_signal_handler_disconnect(G_OBJECT(service->remote), service->sighandler_id);
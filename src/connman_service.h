@@ -27,6 +27,7 @@
 #define CONNMAN_SERVICE_H_
 
 #include "connman_common.h"
+#include "signal_history.h"
 
 /**
  * IPv4 information structure for the service
@@ -68,6 +69,10 @@ typedef struct connman_service
   	gchar *state;
 
   	guchar strength;
+	/** Strength smoothed over the recent readings */
+	guchar smoothed_strength;
+	/** Recent strength readings, NULL until the first one */
+	signal_history_t *signal_history;
 	GStrv security;
   	gboolean auto_connect;
   	gboolean immutable;
@@ -77,6 +82,8 @@ typedef struct connman_service
 	ipinfo_t ipinfo;
 	gulong sighandler_id;
 	connman_state_changed_cb handle_state_change_fn;
+	/** Incremented whenever any cached property changes */
+	guint generation;
 }connman_service_t;
 
 /**
@@ -109,6 +116,13 @@ enum {
  */
 typedef void (*connman_service_connect_cb)(gboolean success, gpointer user_data);
 
+/**
+ * Callback function letting callers handle remote "SetProperty" call responses
+ *
+ * error_message is NULL on success
+ */
+typedef void (*connman_service_set_property_cb)(gboolean success, const gchar *error_message, gpointer user_data);
+
 /**
  * Check if the type of the service is wifi
  *
@@ -169,6 +183,17 @@ extern gboolean connman_service_connect(connman_service_t *service, connman_serv
  */
 extern gboolean connman_service_disconnect(connman_service_t *service);
 
+/**
+ * Disconnect from a remote connman service without waiting for the result
+ *
+ * @param[IN]  service A service instance
+ * @param[IN]  cb Callback called when disconnect call returns, may be NULL
+ * @param[IN]  user_data User data (if any) to pass with the callback function
+ *
+ * @return FALSE if the disconnect call could not be issued, TRUE otherwise
+ */
+extern gboolean connman_service_disconnect_async(connman_service_t *service, connman_service_connect_cb cb, gpointer user_data);
+
 /**
  * remove a remote connman service
  *
@@ -209,6 +234,25 @@ extern gboolean connman_service_set_nameservers(connman_service_t *service, GStr
  */
 extern gboolean connman_service_set_autoconnect(connman_service_t *service, gboolean value);
 
+/**
+ * The following send the same "SetProperty" calls as their synchronous
+ * counterparts above, without waiting for the reply. Calls sent one after
+ * the other are applied by connman in that order.
+ *
+ * @param[IN]  cb Callback called when the call returns, may be NULL
+ * @param[IN]  user_data User data (if any) to pass with the callback function
+ *
+ * @return FALSE if the call could not be sent, cb is not called then
+ */
+extern gboolean connman_service_set_ipv4_async(connman_service_t *service, ipv4info_t *ipv4,
+				connman_service_set_property_cb cb, gpointer user_data);
+
+extern gboolean connman_service_set_nameservers_async(connman_service_t *service, GStrv dns,
+				connman_service_set_property_cb cb, gpointer user_data);
+
+extern gboolean connman_service_set_autoconnect_async(connman_service_t *service, gboolean value,
+				connman_service_set_property_cb cb, gpointer user_data);
+
 /**
  * Get all the network related information for a connected service (in online state)
  *
@@ -26,6 +26,10 @@
 
 #include "connman_technology.h"
 #include "logging.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "network_state.h"
+#include "utils.h"
 
 /**
  * Power on/off the given technology (see header for API details)
@@ -74,6 +78,46 @@ gboolean connman_technology_scan_network(connman_technology_t *technology)
 	return TRUE;
 }
 
+/**
+ * Asynchronous callback for a remote "scan" call
+ */
+
+static void scan_callback(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	struct cb_data *cbd = user_data;
+	connman_technology_scan_cb cb = cbd->cb;
+
+	/* The proxy is the source, the technology may have been removed meanwhile */
+	gboolean ret = connman_interface_technology_call_scan_finish(CONNMAN_INTERFACE_TECHNOLOGY(source), res, &error);
+	if (error)
+	{
+		WCA_LOG_CRITICAL("%s", error->message);
+		g_error_free(error);
+		ret = FALSE;
+	}
+
+	if (cb != NULL)
+		cb(ret, cbd->data);
+	g_free(cbd);
+}
+
+/**
+ * Scan the network without blocking (see header for API details)
+ */
+
+gboolean connman_technology_scan_network_async(connman_technology_t *technology,
+					connman_technology_scan_cb cb, gpointer user_data)
+{
+	if(NULL == technology)
+		return FALSE;
+
+	struct cb_data *cbd = cb_data_new(cb, user_data);
+	connman_interface_technology_call_scan(technology->remote, NULL, scan_callback, cbd);
+
+	return TRUE;
+}
+
 /**
  * Callback for technology's "property_changed" signal
  */
@@ -82,12 +126,20 @@ static void
 property_changed_cb(ConnmanInterfaceTechnology *proxy,const gchar * property, GVariant *v,
               connman_technology_t      *technology)
 {
+	gint64 start = g_get_monotonic_time();
+	const gchar *previous_activity = watchdog_enter("Technology.PropertyChanged");
 	GVariant *val = g_variant_get_variant(v);
 	if (g_str_equal(property, "Powered"))
+	{
 		technology->powered = g_variant_get_boolean(val);
+		network_state_invalidate();
+	}
 
 	if(NULL != technology->handle_property_change_fn)
                 (technology->handle_property_change_fn)((gpointer)technology, property, v);
+
+	metrics_record_since(METRICS_GROUP_SIGNAL, "Technology.PropertyChanged", start);
+	watchdog_leave(previous_activity);
 }
 
 
@@ -105,6 +157,24 @@ void connman_technology_register_property_changed_cb(connman_technology_t *techn
 }
 
 
+/**
+ * Convert the technology type string to its enum value (see header for API details)
+ */
+
+gint connman_technology_get_type(const gchar *type)
+{
+	if (NULL == type)
+		return CONNMAN_TECHNOLOGY_TYPE_UNKNOWN;
+	else if (g_str_equal(type, "wifi"))
+		return CONNMAN_TECHNOLOGY_TYPE_WIFI;
+	else if (g_str_equal(type, "ethernet"))
+		return CONNMAN_TECHNOLOGY_TYPE_ETHERNET;
+	else if (g_str_equal(type, "cellular"))
+		return CONNMAN_TECHNOLOGY_TYPE_CELLULAR;
+
+	return CONNMAN_TECHNOLOGY_TYPE_UNKNOWN;
+}
+
 /**
  * Create a new technology instance and set its properties (see header fpr API details)
  */
@@ -166,6 +236,8 @@ connman_technology_t *connman_technology_new(GVariant *variant)
 			technology->powered = g_variant_get_boolean(val);
 	}
 
+	technology->type_id = connman_technology_get_type(technology->type);
+
 	return technology;
 }
 
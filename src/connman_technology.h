@@ -33,6 +33,17 @@
 
 #include "connman_common.h"
 
+/**
+ * Enum for technology types
+ */
+enum {
+	CONNMAN_TECHNOLOGY_TYPE_UNKNOWN = 0,
+	CONNMAN_TECHNOLOGY_TYPE_ETHERNET,
+	CONNMAN_TECHNOLOGY_TYPE_WIFI,
+	CONNMAN_TECHNOLOGY_TYPE_CELLULAR,
+	CONNMAN_TECHNOLOGY_TYPE_MAX
+};
+
 /**
  * Local instance of a connman technology
  * Caches all required information for a technology
@@ -41,6 +52,8 @@ typedef struct connman_technology
 {
 	ConnmanInterfaceTechnology *remote;
   	gchar *type;
+	/** type parsed into one of the CONNMAN_TECHNOLOGY_TYPE_* values */
+	gint type_id;
   	gchar *name;
 	gchar *path;
 	gboolean powered;
@@ -48,6 +61,15 @@ typedef struct connman_technology
 	connman_property_changed_cb     handle_property_change_fn;
 }connman_technology_t;
 
+/**
+ * Convert the technology type string to its enum value
+ *
+ * @param[IN]  type Type string as reported by connman
+ *
+ * @return One of the CONNMAN_TECHNOLOGY_TYPE_* values
+ */
+extern gint connman_technology_get_type(const gchar *type);
+
 /**
  * Power on/off the given technology
  *
@@ -68,6 +90,23 @@ extern gboolean connman_technology_set_powered(connman_technology_t *technology,
  */
 extern gboolean connman_technology_scan_network(connman_technology_t *technology);
 
+typedef void (*connman_technology_scan_cb)(gboolean success, gpointer user_data);
+
+/**
+ * Scan the network for available services without blocking
+ *
+ * The callback is called once connman finished the scan and sent the
+ * resulting service changes, even if the technology went away meanwhile.
+ *
+ * @param[IN]  technology A technology instance
+ * @param[IN]  cb Callback called when the scan is done
+ * @param[IN]  user_data User data passed to the callback
+ *
+ * @return FALSE if the scan could not be started, TRUE otherwise
+ */
+extern gboolean connman_technology_scan_network_async(connman_technology_t *technology,
+						connman_technology_scan_cb cb, gpointer user_data);
+
 /**
  * Register for technology's "properties_changed" signal, calling the provided function whenever the callback function
  * for the signal is called
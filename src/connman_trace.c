@@ -0,0 +1,191 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  connman_trace.c
+ *
+ * @brief Records the D-Bus traffic between the adapter and connman
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "connman_trace.h"
+#include "logging.h"
+
+/* Flush the trace file at least this often (in microseconds) */
+#define TRACE_FLUSH_INTERVAL	G_USEC_PER_SEC
+
+static GDBusConnection *trace_connection = NULL;
+static guint trace_filter_id = 0;
+
+/* Everything below is accessed from the GDBus worker thread */
+static GMutex trace_lock;
+static FILE *trace_file = NULL;
+static gint64 trace_start_time = 0;
+static gint64 trace_last_flush = 0;
+static GHashTable *pending_calls = NULL;
+static guint64 trace_records = 0;
+
+static void write_record(GDBusMessage *message)
+{
+	connman_trace_record_t record;
+	GError *error = NULL;
+	gsize size = 0;
+	guchar *blob;
+
+	blob = g_dbus_message_to_blob(message, &size, G_DBUS_CAPABILITY_FLAGS_NONE, &error);
+	if(NULL == blob)
+	{
+		WCA_LOG_ERROR("Could not serialize message for trace: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	memset(&record, 0, sizeof(record));
+	record.timestamp = g_get_monotonic_time() - trace_start_time;
+	record.length = size;
+
+	if(fwrite(&record, sizeof(record), 1, trace_file) != 1 || fwrite(blob, size, 1, trace_file) != 1)
+		WCA_LOG_ERROR("Error in writing to connman trace");
+	else
+		trace_records++;
+
+	if(record.timestamp - trace_last_flush >= TRACE_FLUSH_INTERVAL)
+	{
+		fflush(trace_file);
+		trace_last_flush = record.timestamp;
+	}
+
+	g_free(blob);
+}
+
+/**
+ * Filter on the system bus connection picking out the connman traffic
+ */
+
+static GDBusMessage *trace_filter(GDBusConnection *connection, GDBusMessage *message,
+				gboolean incoming, gpointer user_data)
+{
+	g_mutex_lock(&trace_lock);
+
+	if(NULL == trace_file)
+		goto out;
+
+	switch(g_dbus_message_get_message_type(message))
+	{
+		case G_DBUS_MESSAGE_TYPE_METHOD_CALL:
+			if(!incoming && !g_strcmp0(g_dbus_message_get_destination(message), "net.connman"))
+			{
+				g_hash_table_add(pending_calls, GUINT_TO_POINTER(g_dbus_message_get_serial(message)));
+				write_record(message);
+			}
+			break;
+		case G_DBUS_MESSAGE_TYPE_METHOD_RETURN:
+		case G_DBUS_MESSAGE_TYPE_ERROR:
+			if(incoming && g_hash_table_remove(pending_calls,
+					GUINT_TO_POINTER(g_dbus_message_get_reply_serial(message))))
+				write_record(message);
+			break;
+		case G_DBUS_MESSAGE_TYPE_SIGNAL:
+			if(incoming && g_str_has_prefix(g_dbus_message_get_interface(message) ? : "", "net.connman."))
+				write_record(message);
+			break;
+		default:
+			break;
+	}
+
+out:
+	g_mutex_unlock(&trace_lock);
+	return message;
+}
+
+/**
+ * Start recording the connman traffic (see header for API details)
+ */
+
+gboolean connman_trace_start(const gchar *path)
+{
+	GError *error = NULL;
+	guint32 version = CONNMAN_TRACE_VERSION;
+
+	if(NULL != trace_connection || NULL == path)
+		return FALSE;
+
+	trace_connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if(error)
+	{
+		WCA_LOG_ERROR("Could not connect to system bus for tracing: %s", error->message);
+		g_error_free(error);
+		trace_connection = NULL;
+		return FALSE;
+	}
+
+	FILE *file = fopen(path, "wb");
+	if(NULL == file)
+	{
+		WCA_LOG_ERROR("Could not open connman trace file %s", path);
+		g_object_unref(trace_connection);
+		trace_connection = NULL;
+		return FALSE;
+	}
+
+	fwrite(CONNMAN_TRACE_MAGIC, CONNMAN_TRACE_MAGIC_LEN, 1, file);
+	fwrite(&version, sizeof(version), 1, file);
+
+	g_mutex_lock(&trace_lock);
+	trace_file = file;
+	trace_start_time = g_get_monotonic_time();
+	trace_last_flush = 0;
+	trace_records = 0;
+	pending_calls = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_mutex_unlock(&trace_lock);
+
+	trace_filter_id = g_dbus_connection_add_filter(trace_connection, trace_filter, NULL, NULL);
+
+	WCA_LOG_INFO("Recording connman traffic to %s", path);
+
+	return TRUE;
+}
+
+/**
+ * Stop recording (see header for API details)
+ */
+
+void connman_trace_stop(void)
+{
+	if(NULL == trace_connection)
+		return;
+
+	g_dbus_connection_remove_filter(trace_connection, trace_filter_id);
+	trace_filter_id = 0;
+
+	g_mutex_lock(&trace_lock);
+	fclose(trace_file);
+	trace_file = NULL;
+	g_hash_table_destroy(pending_calls);
+	pending_calls = NULL;
+	WCA_LOG_INFO("Recorded %" G_GUINT64_FORMAT " connman messages", trace_records);
+	g_mutex_unlock(&trace_lock);
+
+	g_object_unref(trace_connection);
+	trace_connection = NULL;
+}
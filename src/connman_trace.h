@@ -0,0 +1,74 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  connman_trace.h
+ *
+ * @brief Header file defining functions and the file format for recording
+ * the D-Bus traffic between the adapter and connman
+ *
+ */
+
+
+#ifndef CONNMAN_TRACE_H_
+#define CONNMAN_TRACE_H_
+
+#include <glib.h>
+
+/**
+ * Trace file format
+ *
+ * A trace starts with CONNMAN_TRACE_MAGIC followed by the format version
+ * as a 32 bit integer. Each message is then stored as a
+ * connman_trace_record_t header followed by the message in D-Bus wire
+ * format (see g_dbus_message_to_blob()). All integers are in host byte order.
+ *
+ * Recorded are the method calls the adapter sends to net.connman, the
+ * replies to those calls and every signal of a net.connman.* interface.
+ */
+
+#define CONNMAN_TRACE_MAGIC		"WCATRACE"
+#define CONNMAN_TRACE_MAGIC_LEN		8
+#define CONNMAN_TRACE_VERSION		1
+
+typedef struct connman_trace_record
+{
+	guint64 timestamp;	/* microseconds since the start of the recording */
+	guint32 length;		/* size of the message blob that follows */
+	guint32 reserved;
+}connman_trace_record_t;
+
+/**
+ * Start recording the connman traffic on the system bus
+ *
+ * Must be called before any connman proxy is created so the initial
+ * replies are part of the trace.
+ *
+ * @param[IN]  path File the trace is written to
+ *
+ * @return FALSE if the file or the system bus could not be opened
+ */
+extern gboolean connman_trace_start(const gchar *path);
+
+/**
+ * Stop recording and flush the trace file
+ */
+extern void connman_trace_stop(void);
+
+#endif /* CONNMAN_TRACE_H_ */
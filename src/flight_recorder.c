@@ -0,0 +1,257 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  flight_recorder.c
+ *
+ * @brief Fixed size ring buffer of compact D-Bus and luna events
+ *
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "flight_recorder.h"
+#include "logging.h"
+
+/**
+ * One event, 24 bytes
+ *
+ * seq is the position of the event in the stream plus one. It is written
+ * last so a reader can skip slots which are being overwritten.
+ */
+typedef struct flight_recorder_event
+{
+	guint64 timestamp;
+	guint32 seq;
+	guint16 type;
+	guint16 name;
+	guint32 arg;
+	guint32 reserved;
+}flight_recorder_event_t;
+
+static flight_recorder_event_t events[FLIGHT_RECORDER_SIZE];
+static guint32 next_seq = 0;
+
+/* Interned names, slot 0 stands for "no name" */
+static gchar *names[FLIGHT_RECORDER_MAX_NAMES];
+
+static const char *type_names[FLIGHT_RECORDER_TYPE_COUNT] = {
+	NULL,
+	"signal",
+	"dbusCall",
+	"dbusReply",
+	"dbusError",
+	"lunaRequest",
+	"lunaReply",
+	"subscriptionPost",
+};
+
+/**
+ * Map a name to its slot, copying it on first use only
+ */
+
+static guint16 intern_name(const gchar *name)
+{
+	guint hash, i;
+
+	if(NULL == name)
+		return 0;
+
+	hash = g_str_hash(name);
+	for (i = 0; i < FLIGHT_RECORDER_MAX_NAMES - 1; i++)
+	{
+		guint slot = 1 + (hash + i) % (FLIGHT_RECORDER_MAX_NAMES - 1);
+		gchar *interned = g_atomic_pointer_get(&names[slot]);
+
+		if(NULL == interned)
+		{
+			gchar *copy = g_strdup(name);
+			if(g_atomic_pointer_compare_and_exchange(&names[slot], NULL, copy))
+				return slot;
+
+			g_free(copy);
+			interned = g_atomic_pointer_get(&names[slot]);
+		}
+
+		if(g_str_equal(interned, name))
+			return slot;
+	}
+
+	return 0;
+}
+
+/**
+ * Record an event (see header for API details)
+ */
+
+void flight_recorder_add(flight_recorder_type_t type, const gchar *name, guint32 arg)
+{
+	guint32 seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+	flight_recorder_event_t *event = &events[seq & (FLIGHT_RECORDER_SIZE - 1)];
+
+	__atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	event->timestamp = g_get_monotonic_time();
+	event->type = type;
+	event->name = intern_name(name);
+	event->arg = arg;
+	__atomic_store_n(&event->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copy the recorded events in order, skipping slots being written
+ *
+ * @return Number of events copied to the buffer
+ */
+
+static guint snapshot(flight_recorder_event_t *buffer)
+{
+	guint32 end = __atomic_load_n(&next_seq, __ATOMIC_ACQUIRE);
+	guint32 start = end > FLIGHT_RECORDER_SIZE ? end - FLIGHT_RECORDER_SIZE : 0;
+	guint count = 0;
+	guint32 seq;
+
+	for (seq = start; seq != end; seq++)
+	{
+		flight_recorder_event_t *event = &events[seq & (FLIGHT_RECORDER_SIZE - 1)];
+
+		if(__atomic_load_n(&event->seq, __ATOMIC_ACQUIRE) != seq + 1)
+			continue;
+		buffer[count] = *event;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&event->seq, __ATOMIC_ACQUIRE) == seq + 1)
+			count++;
+	}
+
+	return count;
+}
+
+static const gchar *event_name(flight_recorder_event_t *event)
+{
+	const gchar *name = g_atomic_pointer_get(&names[event->name]);
+	return name ? name : "";
+}
+
+static const gchar *event_type(flight_recorder_event_t *event)
+{
+	return event->type < FLIGHT_RECORDER_TYPE_COUNT && type_names[event->type] ? type_names[event->type] : "unknown";
+}
+
+/**
+ * Write all events as text (see header for API details)
+ */
+
+void flight_recorder_dump(FILE *file)
+{
+	flight_recorder_event_t *buffer = g_new(flight_recorder_event_t, FLIGHT_RECORDER_SIZE);
+	guint count = snapshot(buffer), i;
+
+	for (i = 0; i < count; i++)
+	{
+		fprintf(file, "%" G_GUINT64_FORMAT " %s %s %u\n", buffer[i].timestamp,
+			event_type(&buffer[i]), event_name(&buffer[i]), buffer[i].arg);
+	}
+
+	g_free(buffer);
+}
+
+/**
+ * Build the JSON list of events (see header for API details)
+ */
+
+jvalue_ref flight_recorder_to_json(void)
+{
+	flight_recorder_event_t *buffer = g_new(flight_recorder_event_t, FLIGHT_RECORDER_SIZE);
+	guint count = snapshot(buffer), i;
+	jvalue_ref events_j = jarray_create(NULL);
+
+	for (i = 0; i < count; i++)
+	{
+		jvalue_ref event_j = jobject_create();
+		jobject_put(event_j, J_CSTR_TO_JVAL("timestamp"), jnumber_create_i64(buffer[i].timestamp));
+		jobject_put(event_j, J_CSTR_TO_JVAL("type"), jstring_create(event_type(&buffer[i])));
+		jobject_put(event_j, J_CSTR_TO_JVAL("name"), jstring_create(event_name(&buffer[i])));
+		jobject_put(event_j, J_CSTR_TO_JVAL("arg"), jnumber_create_i64(buffer[i].arg));
+		jarray_append(events_j, event_j);
+	}
+
+	g_free(buffer);
+	return events_j;
+}
+
+/**
+ * Filter on the system bus connection recording the connman traffic
+ */
+
+static GDBusMessage *flight_recorder_filter(GDBusConnection *connection, GDBusMessage *message,
+				gboolean incoming, gpointer user_data)
+{
+	const gchar *interface = g_dbus_message_get_interface(message);
+	gchar name[128];
+
+	switch(g_dbus_message_get_message_type(message))
+	{
+		case G_DBUS_MESSAGE_TYPE_METHOD_CALL:
+			if(incoming || g_strcmp0(g_dbus_message_get_destination(message), "net.connman"))
+				break;
+			g_snprintf(name, sizeof(name), "%s.%s", interface, g_dbus_message_get_member(message));
+			flight_recorder_add(FLIGHT_RECORDER_DBUS_CALL, name, g_dbus_message_get_serial(message));
+			break;
+		case G_DBUS_MESSAGE_TYPE_METHOD_RETURN:
+			if(incoming)
+				flight_recorder_add(FLIGHT_RECORDER_DBUS_REPLY, NULL, g_dbus_message_get_reply_serial(message));
+			break;
+		case G_DBUS_MESSAGE_TYPE_ERROR:
+			if(incoming)
+				flight_recorder_add(FLIGHT_RECORDER_DBUS_ERROR, g_dbus_message_get_error_name(message),
+						g_dbus_message_get_reply_serial(message));
+			break;
+		case G_DBUS_MESSAGE_TYPE_SIGNAL:
+			if(!incoming || !g_str_has_prefix(interface ? : "", "net.connman."))
+				break;
+			g_snprintf(name, sizeof(name), "%s.%s", interface, g_dbus_message_get_member(message));
+			flight_recorder_add(FLIGHT_RECORDER_SIGNAL, name, g_dbus_message_get_serial(message));
+			break;
+		default:
+			break;
+	}
+
+	return message;
+}
+
+/**
+ * Start recording the connman traffic (see header for API details)
+ */
+
+void flight_recorder_watch_dbus(void)
+{
+	GError *error = NULL;
+	GDBusConnection *connection;
+
+	connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if(error)
+	{
+		WCA_LOG_ERROR("Could not connect to system bus for the flight recorder: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	g_dbus_connection_add_filter(connection, flight_recorder_filter, NULL, NULL);
+}
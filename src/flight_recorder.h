@@ -0,0 +1,93 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  flight_recorder.h
+ *
+ * @brief Header file defining the always-on event ring buffer
+ *
+ */
+
+
+#ifndef FLIGHT_RECORDER_H_
+#define FLIGHT_RECORDER_H_
+
+#include <stdio.h>
+#include <glib.h>
+#include <pbnjson.h>
+
+/**
+ * Number of events kept, must be a power of two
+ */
+#define FLIGHT_RECORDER_SIZE		4096
+
+/**
+ * Number of distinct event names which can be interned
+ */
+#define FLIGHT_RECORDER_MAX_NAMES	256
+
+/**
+ * Directory only the adapter can write, holding the file written on SIGUSR1
+ */
+#define FLIGHT_RECORDER_DUMP_DIR	"/var/run/webos-connman-adapter"
+
+/**
+ * File written on SIGUSR1, readable by the adapter's user only
+ */
+#define FLIGHT_RECORDER_DUMP_PATH	FLIGHT_RECORDER_DUMP_DIR "/events"
+
+typedef enum {
+	FLIGHT_RECORDER_SIGNAL = 1,		/* connman signal received, arg: serial */
+	FLIGHT_RECORDER_DBUS_CALL,		/* call sent to connman, arg: serial */
+	FLIGHT_RECORDER_DBUS_REPLY,		/* reply from connman, arg: serial of the call */
+	FLIGHT_RECORDER_DBUS_ERROR,		/* error reply from connman, arg: serial of the call */
+	FLIGHT_RECORDER_LUNA_REQUEST,		/* luna method called, arg: payload size */
+	FLIGHT_RECORDER_LUNA_REPLY,		/* luna reply sent, arg: payload size */
+	FLIGHT_RECORDER_SUBSCRIPTION_POST,	/* subscription post, arg: number of subscribers */
+	FLIGHT_RECORDER_TYPE_COUNT
+} flight_recorder_type_t;
+
+/**
+ * Record an event
+ *
+ * Lock-free and allocation-free once the name has been interned; callable
+ * from any thread.
+ *
+ * @param[IN]  type Event type
+ * @param[IN]  name Name of the method or signal, may be NULL
+ * @param[IN]  arg  Type specific argument
+ */
+extern void flight_recorder_add(flight_recorder_type_t type, const gchar *name, guint32 arg);
+
+/**
+ * Record the connman traffic on the system bus
+ */
+extern void flight_recorder_watch_dbus(void);
+
+/**
+ * Write all recorded events to a file as text, oldest first
+ */
+extern void flight_recorder_dump(FILE *file);
+
+/**
+ * Build a JSON array of all recorded events, oldest first
+ */
+extern jvalue_ref flight_recorder_to_json(void);
+
+#endif /* FLIGHT_RECORDER_H_ */
@@ -0,0 +1,282 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  interface_facts.c
+ *
+ * @brief Reads MAC address, index, MTU, link state, IPv4 address and traffic
+ *        counters of the configured interfaces straight from the kernel
+ *
+ * A handful of ioctls on a datagram socket replace asking connman for the
+ * connected service's properties, and work whether or not anything is
+ * connected on the interface.
+ *
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <glib.h>
+
+#include "interface_facts.h"
+#include "connman_common.h"
+#include "logging.h"
+
+static interface_facts_t facts[INTERFACE_FACTS_MAX] = {
+	{ .name = CONNMAN_WIFI_INTERFACE_NAME },
+	{ .name = CONNMAN_WIRED_INTERFACE_NAME },
+	{ .name = CONNMAN_CELLULAR_INTERFACE_NAME },
+};
+
+static int ioctl_socket = -1;
+
+#define SYSFS_NET_DIR	"/sys/class/net"
+
+static gboolean interface_ioctl(unsigned long request, const gchar *name, struct ifreq *ifr)
+{
+	memset(ifr, 0, sizeof(*ifr));
+	g_strlcpy(ifr->ifr_name, name, IFNAMSIZ);
+
+	return ioctl(ioctl_socket, request, ifr) == 0;
+}
+
+void interface_facts_refresh(gint iface)
+{
+	struct ifreq ifr;
+
+	if(iface < 0 || iface >= INTERFACE_FACTS_MAX)
+		return;
+
+	interface_facts_t *entry = &facts[iface];
+
+	if(ioctl_socket < 0)
+	{
+		ioctl_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if(ioctl_socket < 0)
+		{
+			WCA_LOG_ERROR("Could not open socket for interface ioctls: %s", strerror(errno));
+			return;
+		}
+	}
+
+	entry->updated = g_get_monotonic_time();
+
+	if(!interface_ioctl(SIOCGIFINDEX, entry->name, &ifr))
+	{
+		entry->present = FALSE;
+		entry->ifindex = 0;
+		entry->mac_address[0] = '\0';
+		entry->mtu = 0;
+		entry->up = FALSE;
+		entry->carrier = FALSE;
+		entry->ipv4_address[0] = '\0';
+		entry->ipv4_prefixlen = 0;
+		return;
+	}
+
+	entry->present = TRUE;
+	entry->ifindex = ifr.ifr_ifindex;
+
+	if(interface_ioctl(SIOCGIFHWADDR, entry->name, &ifr))
+	{
+		const guchar *hw = (const guchar *) ifr.ifr_hwaddr.sa_data;
+		g_snprintf(entry->mac_address, sizeof(entry->mac_address), "%02x:%02x:%02x:%02x:%02x:%02x",
+				hw[0], hw[1], hw[2], hw[3], hw[4], hw[5]);
+	}
+	else
+		entry->mac_address[0] = '\0';
+
+	entry->mtu = interface_ioctl(SIOCGIFMTU, entry->name, &ifr) ? ifr.ifr_mtu : 0;
+
+	if(interface_ioctl(SIOCGIFFLAGS, entry->name, &ifr))
+	{
+		entry->up = (ifr.ifr_flags & IFF_UP) != 0;
+		entry->carrier = (ifr.ifr_flags & IFF_RUNNING) != 0;
+	}
+
+	entry->ipv4_address[0] = '\0';
+	entry->ipv4_prefixlen = 0;
+	if(interface_ioctl(SIOCGIFADDR, entry->name, &ifr))
+	{
+		struct sockaddr_in *address = (struct sockaddr_in *) &ifr.ifr_addr;
+		inet_ntop(AF_INET, &address->sin_addr, entry->ipv4_address, sizeof(entry->ipv4_address));
+
+		if(interface_ioctl(SIOCGIFNETMASK, entry->name, &ifr))
+		{
+			struct sockaddr_in *netmask = (struct sockaddr_in *) &ifr.ifr_netmask;
+			entry->ipv4_prefixlen = __builtin_popcount(ntohl(netmask->sin_addr.s_addr));
+		}
+	}
+}
+
+const interface_facts_t *interface_facts_get(gint iface)
+{
+	if(iface < 0 || iface >= INTERFACE_FACTS_MAX)
+		return NULL;
+
+	interface_facts_t *entry = &facts[iface];
+
+	if(0 == entry->updated
+		|| (!entry->monitored && g_get_monotonic_time() - entry->updated > INTERFACE_FACTS_MAX_AGE * 1000))
+		interface_facts_refresh(iface);
+
+	return entry;
+}
+
+void interface_facts_invalidate(void)
+{
+	gint iface;
+
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+		facts[iface].updated = 0;
+}
+
+gint interface_facts_lookup(const gchar *name)
+{
+	gint iface;
+
+	for (iface = 0; NULL != name && iface < INTERFACE_FACTS_MAX; iface++)
+	{
+		if(!g_strcmp0(facts[iface].name, name))
+			return iface;
+	}
+
+	return -1;
+}
+
+gint interface_facts_lookup_index(gint ifindex)
+{
+	gint iface;
+
+	for (iface = 0; ifindex > 0 && iface < INTERFACE_FACTS_MAX; iface++)
+	{
+		if(facts[iface].present && facts[iface].ifindex == ifindex)
+			return iface;
+	}
+
+	return -1;
+}
+
+gboolean interface_facts_update_link(gint iface, gboolean present, gint ifindex, guint flags,
+				guint mtu, const guchar *hwaddr)
+{
+	if(iface < 0 || iface >= INTERFACE_FACTS_MAX)
+		return FALSE;
+
+	interface_facts_t *entry = &facts[iface];
+	gboolean up = present && (flags & IFF_UP) != 0;
+	gboolean carrier = present && (flags & IFF_RUNNING) != 0;
+	gboolean changed = entry->present != present || entry->up != up || entry->carrier != carrier;
+
+	entry->present = present;
+	entry->ifindex = present ? ifindex : 0;
+	entry->up = up;
+	entry->carrier = carrier;
+	entry->updated = g_get_monotonic_time();
+
+	if(!present)
+	{
+		entry->mac_address[0] = '\0';
+		entry->mtu = 0;
+		entry->ipv4_address[0] = '\0';
+		entry->ipv4_prefixlen = 0;
+		return changed;
+	}
+
+	if(0 != mtu)
+		entry->mtu = mtu;
+
+	if(NULL != hwaddr)
+		g_snprintf(entry->mac_address, sizeof(entry->mac_address), "%02x:%02x:%02x:%02x:%02x:%02x",
+				hwaddr[0], hwaddr[1], hwaddr[2], hwaddr[3], hwaddr[4], hwaddr[5]);
+
+	return changed;
+}
+
+gboolean interface_facts_update_address(gint iface, const gchar *address, guint prefixlen,
+				gboolean added)
+{
+	if(iface < 0 || iface >= INTERFACE_FACTS_MAX || NULL == address)
+		return FALSE;
+
+	interface_facts_t *entry = &facts[iface];
+
+	if(!added)
+	{
+		if(g_strcmp0(entry->ipv4_address, address))
+			return FALSE;
+
+		entry->ipv4_address[0] = '\0';
+		entry->ipv4_prefixlen = 0;
+		return TRUE;
+	}
+
+	if(!g_strcmp0(entry->ipv4_address, address) && entry->ipv4_prefixlen == prefixlen)
+		return FALSE;
+
+	g_strlcpy(entry->ipv4_address, address, sizeof(entry->ipv4_address));
+	entry->ipv4_prefixlen = prefixlen;
+	return TRUE;
+}
+
+void interface_facts_set_monitored(gboolean monitored)
+{
+	gint iface;
+
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+		facts[iface].monitored = monitored;
+}
+
+static gboolean read_counter(const gchar *name, const gchar *counter, guint64 *value)
+{
+	gchar path[128], buffer[32];
+
+	g_snprintf(path, sizeof(path), SYSFS_NET_DIR "/%s/statistics/%s", name, counter);
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return FALSE;
+
+	ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if(len <= 0)
+		return FALSE;
+
+	buffer[len] = '\0';
+	*value = g_ascii_strtoull(buffer, NULL, 10);
+	return TRUE;
+}
+
+gboolean interface_facts_read_stats(gint iface, interface_stats_t *stats)
+{
+	if(iface < 0 || iface >= INTERFACE_FACTS_MAX || NULL == stats)
+		return FALSE;
+
+	const gchar *name = facts[iface].name;
+
+	return read_counter(name, "rx_bytes", &stats->rx_bytes)
+		&& read_counter(name, "tx_bytes", &stats->tx_bytes)
+		&& read_counter(name, "rx_packets", &stats->rx_packets)
+		&& read_counter(name, "tx_packets", &stats->tx_packets);
+}
@@ -0,0 +1,165 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  interface_facts.h
+ *
+ * @brief Header file defining a cache of what the kernel knows about the
+ *        wifi, wired and cellular network interfaces
+ *
+ */
+
+
+#ifndef INTERFACE_FACTS_H_
+#define INTERFACE_FACTS_H_
+
+#include <glib.h>
+#include <netinet/in.h>
+
+/**
+ * Facts older than this are read from the kernel again, unless the link
+ * monitor keeps them up to date
+ */
+#define INTERFACE_FACTS_MAX_AGE	5000
+
+/**
+ * Enum for the configured interfaces
+ */
+enum {
+	INTERFACE_FACTS_WIFI = 0,
+	INTERFACE_FACTS_WIRED,
+	INTERFACE_FACTS_CELLULAR,
+	INTERFACE_FACTS_MAX
+};
+
+/**
+ * Facts about one interface
+ */
+typedef struct interface_facts
+{
+	const gchar *name;	/* configured interface name */
+	gboolean present;	/* FALSE if the kernel has no such interface */
+	gint ifindex;
+	gchar mac_address[18];	/* "xx:xx:xx:xx:xx:xx" */
+	guint mtu;
+	gboolean up;		/* administratively up */
+	gboolean carrier;	/* link detected */
+	gchar ipv4_address[INET_ADDRSTRLEN];	/* empty if the interface has none */
+	guint ipv4_prefixlen;
+	gboolean monitored;	/* kept current by link notifications */
+	gint64 updated;		/* monotonic time of the last refresh, 0 if never */
+}interface_facts_t;
+
+/**
+ * Traffic counters of one interface
+ */
+typedef struct interface_stats
+{
+	guint64 rx_bytes;
+	guint64 tx_bytes;
+	guint64 rx_packets;
+	guint64 tx_packets;
+}interface_stats_t;
+
+/**
+ * Get the facts for an interface, reading them from the kernel when the
+ * cached ones are older than INTERFACE_FACTS_MAX_AGE
+ *
+ * @param[IN]  iface One of the INTERFACE_FACTS_* values
+ *
+ * @return Facts, valid until the next call for the same interface
+ */
+extern const interface_facts_t *interface_facts_get(gint iface);
+
+/**
+ * Read the facts for an interface from the kernel now
+ *
+ * @param[IN]  iface One of the INTERFACE_FACTS_* values
+ */
+extern void interface_facts_refresh(gint iface);
+
+/**
+ * Mark the cached facts of all interfaces as stale
+ */
+extern void interface_facts_invalidate(void);
+
+/**
+ * Find the configured interface with the given name
+ *
+ * @return One of the INTERFACE_FACTS_* values, or -1
+ */
+extern gint interface_facts_lookup(const gchar *name);
+
+/**
+ * Find the configured interface with the given kernel index
+ *
+ * @return One of the INTERFACE_FACTS_* values, or -1
+ */
+extern gint interface_facts_lookup_index(gint ifindex);
+
+/**
+ * Store the link state reported by a link notification
+ *
+ * @param[IN]  iface One of the INTERFACE_FACTS_* values
+ * @param[IN]  present FALSE if the interface was removed
+ * @param[IN]  ifindex Kernel index of the interface
+ * @param[IN]  flags IFF_* flags of the interface
+ * @param[IN]  mtu MTU, 0 to keep the cached one
+ * @param[IN]  hwaddr Hardware address of 6 bytes, NULL to keep the cached one
+ *
+ * @return TRUE if presence, carrier or the up flag changed
+ */
+extern gboolean interface_facts_update_link(gint iface, gboolean present, gint ifindex, guint flags,
+				guint mtu, const guchar *hwaddr);
+
+/**
+ * Store an IPv4 address added to or removed from an interface
+ *
+ * A removal only clears the cached address if it is the one removed.
+ *
+ * @param[IN]  iface One of the INTERFACE_FACTS_* values
+ * @param[IN]  address Address in dotted notation
+ * @param[IN]  prefixlen Prefix length of the address
+ * @param[IN]  added FALSE if the address was removed
+ *
+ * @return TRUE if the cached address changed
+ */
+extern gboolean interface_facts_update_address(gint iface, const gchar *address, guint prefixlen,
+				gboolean added);
+
+/**
+ * Mark all interfaces as kept current by link notifications, or not anymore
+ *
+ * While monitored the cached facts never expire.
+ */
+extern void interface_facts_set_monitored(gboolean monitored);
+
+/**
+ * Read the traffic counters of an interface from sysfs
+ *
+ * Not cached, every call reads the kernel's current counters.
+ *
+ * @param[IN]  iface One of the INTERFACE_FACTS_* values
+ * @param[OUT] stats Counters
+ *
+ * @return FALSE if the interface does not exist
+ */
+extern gboolean interface_facts_read_stats(gint iface, interface_stats_t *stats);
+
+#endif /* INTERFACE_FACTS_H_ */
@@ -20,11 +20,21 @@
 /**
  * @file lunaservice_utils.c
  *
- * @brief Convenience functions for sending luna error messages
+ * @brief Convenience functions for sending luna error messages and the
+ * transport used by the luna method handlers
  *
  */
 
+#include <string.h>
+
 #include "lunaservice_utils.h"
+#include "metrics.h"
+#include "logging.h"
+#include "watchdog.h"
+#include "flight_recorder.h"
+#include "scheduler.h"
+
+static const luna_service_transport_t *transport = &luna_service_transport_ls2;
 
 luna_service_request_t* luna_service_request_new(LSHandle *handle, LSMessage *message)
 {
@@ -43,7 +53,7 @@ LSMessageReplyErrorUnknown(LSHandle *sh, LSMessage *message)
     LSError lserror;
     LSErrorInit(&lserror);
 
-    bool retVal = LSMessageReply(sh, message, "{\"returnValue\":false,"
+    bool retVal = luna_service_message_reply(sh, message, "{\"returnValue\":false,"
         "\"errorText\":\"Unknown Error.\"}", &lserror);
     if (!retVal)
     {
@@ -58,7 +68,7 @@ LSMessageReplyErrorInvalidParams(LSHandle *sh, LSMessage *message)
     LSError lserror;
     LSErrorInit(&lserror);
 
-    bool retVal = LSMessageReply(sh, message, "{\"returnValue\":false,"
+    bool retVal = luna_service_message_reply(sh, message, "{\"returnValue\":false,"
         "\"errorText\":\"Invalid parameters.\"}", NULL);
     if (!retVal)
     {
@@ -73,7 +83,7 @@ LSMessageReplyErrorBadJSON(LSHandle *sh, LSMessage *message)
     LSError lserror;
     LSErrorInit(&lserror);
 
-    bool retVal = LSMessageReply(sh, message, "{\"returnValue\":false,"
+    bool retVal = luna_service_message_reply(sh, message, "{\"returnValue\":false,"
         "\"errorText\":\"Malformed json.\"}", NULL);
     if (!retVal)
     {
@@ -91,7 +101,7 @@ LSMessageReplyCustomError(LSHandle *sh, LSMessage *message, const char *errormsg
 
     sprintf(errorString, "{\"returnValue\":false,\"errorText\":\"%s\"}",errormsg);
 
-    bool retVal = LSMessageReply(sh, message, errorString, NULL);
+    bool retVal = luna_service_message_reply(sh, message, errorString, NULL);
     if (!retVal)
     {
         LSErrorPrint(&lserror, stderr);
@@ -105,7 +115,7 @@ LSMessageReplySuccess(LSHandle *sh, LSMessage *message)
     LSError lserror;
     LSErrorInit(&lserror);
 
-    bool retVal = LSMessageReply(sh, message, "{\"returnValue\":true}",
+    bool retVal = luna_service_message_reply(sh, message, "{\"returnValue\":true}",
         NULL);
     if (!retVal)
     {
@@ -113,3 +123,1017 @@ LSMessageReplySuccess(LSHandle *sh, LSMessage *message)
         LSErrorFree(&lserror);
     }
 }
+
+static gchar *subscription_key(const char *category, const char *method)
+{
+	if (g_str_has_suffix(category, "/"))
+		return g_strconcat(category, method, NULL);
+
+	return g_strconcat(category, "/", method, NULL);
+}
+
+/*
+ * luna-service2 backend
+ */
+
+static bool ls2_subscription_count(LSHandle *sh, const char *key, unsigned int *count, LSError *lserror)
+{
+	LSSubscriptionIter *iter = NULL;
+
+	*count = 0;
+	if (!LSSubscriptionAcquire(sh, key, &iter, lserror))
+		return false;
+
+	while (LSSubscriptionHasNext(iter))
+	{
+		LSSubscriptionNext(iter);
+		(*count)++;
+	}
+	LSSubscriptionRelease(iter);
+
+	return true;
+}
+
+static GPtrArray *ls2_subscription_collect(LSHandle *sh, const char *key, LSError *lserror)
+{
+	LSSubscriptionIter *iter = NULL;
+	GPtrArray *messages;
+
+	if (!LSSubscriptionAcquire(sh, key, &iter, lserror))
+		return NULL;
+
+	/* Take our own references so the catalog is not held while replying */
+	messages = g_ptr_array_new_with_free_func((GDestroyNotify) LSMessageUnref);
+	while (LSSubscriptionHasNext(iter))
+	{
+		LSMessage *message = LSSubscriptionNext(iter);
+		LSMessageRef(message);
+		g_ptr_array_add(messages, message);
+	}
+	LSSubscriptionRelease(iter);
+
+	return messages;
+}
+
+const luna_service_transport_t luna_service_transport_ls2 = {
+	.name = "luna-service2",
+	.message_get_payload = LSMessageGetPayload,
+	.message_get_method = LSMessageGetMethod,
+	.message_is_subscription = LSMessageIsSubscription,
+	.message_ref = LSMessageRef,
+	.message_unref = LSMessageUnref,
+	.message_reply = LSMessageReply,
+	.subscription_process = LSSubscriptionProcess,
+	.subscription_count = ls2_subscription_count,
+	.subscription_collect = ls2_subscription_collect,
+};
+
+/*
+ * In-memory backend
+ */
+
+typedef struct luna_service_memory_message {
+	gint ref_count;
+	gchar *key;
+	gchar *method;
+	gchar *payload;
+	bool subscribe;
+	bool subscribed;
+	luna_service_memory_reply_cb cb;
+	gpointer user_data;
+} luna_service_memory_message_t;
+
+/* Subscription key ("/<method>") to a GList of subscribed messages */
+static GHashTable *memory_subscriptions = NULL;
+
+static const char *memory_message_get_payload(LSMessage *message)
+{
+	return ((luna_service_memory_message_t *) message)->payload;
+}
+
+static const char *memory_message_get_method(LSMessage *message)
+{
+	return ((luna_service_memory_message_t *) message)->method;
+}
+
+static bool memory_message_is_subscription(LSMessage *message)
+{
+	return ((luna_service_memory_message_t *) message)->subscribe;
+}
+
+static void memory_message_ref(LSMessage *message)
+{
+	g_atomic_int_inc(&((luna_service_memory_message_t *) message)->ref_count);
+}
+
+static void memory_message_unref(LSMessage *message)
+{
+	luna_service_memory_message_t *msg = (luna_service_memory_message_t *) message;
+
+	if (!g_atomic_int_dec_and_test(&msg->ref_count))
+		return;
+
+	g_free(msg->key);
+	g_free(msg->method);
+	g_free(msg->payload);
+	g_free(msg);
+}
+
+static bool memory_message_reply(LSHandle *sh, LSMessage *message, const char *payload, LSError *lserror)
+{
+	luna_service_memory_message_t *msg = (luna_service_memory_message_t *) message;
+
+	if (NULL != msg->cb)
+		msg->cb(message, payload, msg->user_data);
+
+	return true;
+}
+
+static bool memory_subscription_process(LSHandle *sh, LSMessage *message, bool *subscribed, LSError *lserror)
+{
+	luna_service_memory_message_t *msg = (luna_service_memory_message_t *) message;
+
+	*subscribed = false;
+	if (!msg->subscribe || msg->subscribed)
+	{
+		*subscribed = msg->subscribed;
+		return true;
+	}
+
+	if (NULL == memory_subscriptions)
+		memory_subscriptions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	GList *list = g_hash_table_lookup(memory_subscriptions, msg->key);
+	g_hash_table_replace(memory_subscriptions, g_strdup(msg->key), g_list_prepend(list, msg));
+	memory_message_ref(message);
+	msg->subscribed = true;
+	*subscribed = true;
+
+	return true;
+}
+
+static bool memory_subscription_count(LSHandle *sh, const char *key, unsigned int *count, LSError *lserror)
+{
+	*count = 0;
+	if (NULL != memory_subscriptions)
+		*count = g_list_length(g_hash_table_lookup(memory_subscriptions, key));
+
+	return true;
+}
+
+static GPtrArray *memory_subscription_collect(LSHandle *sh, const char *key, LSError *lserror)
+{
+	GPtrArray *messages = g_ptr_array_new_with_free_func((GDestroyNotify) memory_message_unref);
+	GList *iter = NULL;
+
+	if (NULL != memory_subscriptions)
+		iter = g_hash_table_lookup(memory_subscriptions, key);
+
+	for (; NULL != iter; iter = iter->next)
+	{
+		memory_message_ref(iter->data);
+		g_ptr_array_add(messages, iter->data);
+	}
+
+	return messages;
+}
+
+const luna_service_transport_t luna_service_transport_memory = {
+	.name = "memory",
+	.message_get_payload = memory_message_get_payload,
+	.message_get_method = memory_message_get_method,
+	.message_is_subscription = memory_message_is_subscription,
+	.message_ref = memory_message_ref,
+	.message_unref = memory_message_unref,
+	.message_reply = memory_message_reply,
+	.subscription_process = memory_subscription_process,
+	.subscription_count = memory_subscription_count,
+	.subscription_collect = memory_subscription_collect,
+};
+
+LSMessage *luna_service_memory_message_new(const char *method, const char *payload, bool subscribe,
+						luna_service_memory_reply_cb cb, gpointer user_data)
+{
+	luna_service_memory_message_t *msg = g_new0(luna_service_memory_message_t, 1);
+
+	msg->ref_count = 1;
+	msg->key = subscription_key("/", method);
+	msg->method = g_strdup(method);
+	msg->payload = g_strdup(payload ? payload : "{}");
+	msg->subscribe = subscribe;
+	msg->cb = cb;
+	msg->user_data = user_data;
+
+	return (LSMessage *) msg;
+}
+
+/**
+ * Drop the subscription of an in-memory message, as if its caller went away
+ */
+
+void luna_service_memory_message_cancel(LSMessage *message)
+{
+	luna_service_memory_message_t *msg = (luna_service_memory_message_t *) message;
+
+	if (!msg->subscribed || NULL == memory_subscriptions)
+		return;
+
+	GList *list = g_hash_table_lookup(memory_subscriptions, msg->key);
+	g_hash_table_replace(memory_subscriptions, g_strdup(msg->key), g_list_remove(list, msg));
+	msg->subscribed = false;
+	memory_message_unref(message);
+}
+
+/**
+ * Dispatch an in-memory message to the matching handler of a category
+ */
+
+bool luna_service_memory_call(LSHandle *sh, luna_service_category_t *category, LSMessage *message)
+{
+	return luna_service_dispatch(category, sh, message);
+}
+
+/*
+ * Method dispatch
+ */
+
+static bool dispatch_cb(LSHandle *sh, LSMessage *message, void *context)
+{
+	return luna_service_dispatch(context, sh, message);
+}
+
+/**
+ * Wrap a method table so all its methods are called through luna_service_dispatch()
+ */
+
+luna_service_category_t *luna_service_category_new(const char *service_name, const LSMethod *methods)
+{
+	luna_service_category_t *category = g_new0(luna_service_category_t, 1);
+	guint i;
+
+	category->service_name = g_strdup(service_name);
+	category->methods = methods;
+	while (NULL != methods[category->n_methods].name)
+		category->n_methods++;
+
+	category->latency = g_new0(metrics_histogram_t *, category->n_methods);
+	category->dispatch_table = g_new0(LSMethod, category->n_methods + 1);
+	for (i = 0; i < category->n_methods; i++)
+	{
+		gchar *name = g_strdup_printf("%s/%s", service_name, methods[i].name);
+		category->latency[i] = metrics_lookup(METRICS_GROUP_LUNA, name);
+		g_free(name);
+
+		category->dispatch_table[i].name = methods[i].name;
+		category->dispatch_table[i].function = dispatch_cb;
+		category->dispatch_table[i].flags = methods[i].flags;
+	}
+
+	return category;
+}
+
+/**
+ * Register the methods of a category on the root category of a handle
+ */
+
+bool luna_service_register_category(LSHandle *sh, luna_service_category_t *category, LSError *lserror)
+{
+	if (!LSRegisterCategory(sh, "/", category->dispatch_table, NULL, NULL, lserror))
+		return false;
+
+	return LSCategorySetData(sh, "/", category, lserror);
+}
+
+/**
+ * Call the handler for a message and account its latency
+ */
+
+static bool call_method(luna_service_category_t *category, guint i, LSHandle *sh, LSMessage *message)
+{
+	const gchar *name = category->latency[i] ? category->latency[i]->name : category->methods[i].name;
+	const gchar *previous = watchdog_enter(name);
+	flight_recorder_add(FLIGHT_RECORDER_LUNA_REQUEST, name,
+			strlen(transport->message_get_payload(message)));
+	gint64 start = g_get_monotonic_time();
+	bool ret = category->methods[i].function(sh, message, NULL);
+	metrics_record(category->latency[i], g_get_monotonic_time() - start, FALSE);
+	watchdog_leave(previous);
+	return ret;
+}
+
+/**
+ * A method call handed over to the owner context of its category
+ */
+
+typedef struct forwarded_call
+{
+	luna_service_category_t *category;
+	guint method;
+	LSHandle *sh;
+	LSMessage *message;
+}forwarded_call_t;
+
+static gboolean forwarded_call_cb(gpointer user_data)
+{
+	forwarded_call_t *call = user_data;
+
+	call_method(call->category, call->method, call->sh, call->message);
+	transport->message_unref(call->message);
+	g_free(call);
+
+	return FALSE;
+}
+
+bool luna_service_dispatch(luna_service_category_t *category, LSHandle *sh, LSMessage *message)
+{
+	const char *method = transport->message_get_method(message);
+	guint i;
+
+	for (i = 0; i < category->n_methods; i++)
+	{
+		if (!g_strcmp0(category->methods[i].name, method))
+		{
+			if (NULL != category->owner_context && !category->local[i]
+				&& !g_main_context_is_owner(category->owner_context))
+			{
+				forwarded_call_t *call = g_new0(forwarded_call_t, 1);
+				call->category = category;
+				call->method = i;
+				call->sh = sh;
+				call->message = message;
+				transport->message_ref(message);
+				g_main_context_invoke(category->owner_context, forwarded_call_cb, call);
+				return true;
+			}
+
+			return call_method(category, i, sh, message);
+		}
+	}
+
+	WCA_LOG_ERROR("No handler for method %s of %s", method, category->service_name);
+	return false;
+}
+
+void luna_service_category_set_owner(luna_service_category_t *category, GMainContext *owner_context,
+					const char * const *local_methods)
+{
+	guint i, j;
+
+	category->owner_context = owner_context;
+	if (NULL == category->local)
+		category->local = g_new0(gboolean, category->n_methods);
+
+	for (i = 0; i < category->n_methods; i++)
+	{
+		category->local[i] = FALSE;
+		for (j = 0; NULL != local_methods && NULL != local_methods[j]; j++)
+		{
+			if (!g_strcmp0(category->methods[i].name, local_methods[j]))
+				category->local[i] = TRUE;
+		}
+	}
+}
+
+/*
+ * Transport selection
+ */
+
+void luna_service_set_transport(const luna_service_transport_t *new_transport)
+{
+	transport = new_transport ? new_transport : &luna_service_transport_ls2;
+}
+
+const char *luna_service_message_get_payload(LSMessage *message)
+{
+	return transport->message_get_payload(message);
+}
+
+const char *luna_service_message_get_method(LSMessage *message)
+{
+	return transport->message_get_method(message);
+}
+
+bool luna_service_message_is_subscription(LSMessage *message)
+{
+	return transport->message_is_subscription(message);
+}
+
+void luna_service_message_ref(LSMessage *message)
+{
+	transport->message_ref(message);
+}
+
+void luna_service_message_unref(LSMessage *message)
+{
+	transport->message_unref(message);
+}
+
+/*
+ * Handles attached to another context
+ *
+ * luna-service2 handles are not thread safe. Replies and subscription calls
+ * for a handle made from another thread, e.g. by a call forwarded to the
+ * owner context, are sent back to the handle's context. Replies and posts
+ * go there asynchronously, the calls returning a result wait for it. The
+ * handle's context must never wait for another one, or this deadlocks.
+ */
+
+/* LSHandle to the GMainContext it is attached to */
+static GHashTable *handle_contexts = NULL;
+G_LOCK_DEFINE_STATIC(handle_contexts);
+
+void luna_service_handle_set_context(LSHandle *sh, GMainContext *context)
+{
+	G_LOCK(handle_contexts);
+	if (NULL == handle_contexts)
+		handle_contexts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	if (NULL != context)
+		g_hash_table_insert(handle_contexts, sh, context);
+	else
+		g_hash_table_remove(handle_contexts, sh);
+	G_UNLOCK(handle_contexts);
+}
+
+/**
+ * Get the context of a handle if the calling thread does not run it
+ */
+
+static GMainContext *handle_foreign_context(LSHandle *sh)
+{
+	GMainContext *context = NULL;
+
+	G_LOCK(handle_contexts);
+	if (NULL != handle_contexts)
+		context = g_hash_table_lookup(handle_contexts, sh);
+	G_UNLOCK(handle_contexts);
+
+	if (NULL != context && g_main_context_is_owner(context))
+		return NULL;
+
+	return context;
+}
+
+/**
+ * A call on a handle run on the handle's context while the caller waits
+ */
+
+typedef struct handle_call
+{
+	GSourceFunc func;
+	gpointer data;
+	gboolean done;
+	GMutex mutex;
+	GCond cond;
+} handle_call_t;
+
+static gboolean handle_call_cb(gpointer user_data)
+{
+	handle_call_t *call = user_data;
+
+	call->func(call->data);
+
+	g_mutex_lock(&call->mutex);
+	call->done = TRUE;
+	g_cond_signal(&call->cond);
+	g_mutex_unlock(&call->mutex);
+
+	return FALSE;
+}
+
+static void handle_call_sync(GMainContext *context, GSourceFunc func, gpointer data)
+{
+	handle_call_t call = { .func = func, .data = data };
+
+	g_mutex_init(&call.mutex);
+	g_cond_init(&call.cond);
+
+	g_main_context_invoke(context, handle_call_cb, &call);
+
+	g_mutex_lock(&call.mutex);
+	while (!call.done)
+		g_cond_wait(&call.cond, &call.mutex);
+	g_mutex_unlock(&call.mutex);
+
+	g_cond_clear(&call.cond);
+	g_mutex_clear(&call.mutex);
+}
+
+/**
+ * Arguments and result of a subscription call run on the handle's context
+ */
+
+typedef struct handle_subscription_call
+{
+	LSHandle *sh;
+	LSMessage *message;
+	const char *key;
+	bool *subscribed;
+	unsigned int *count;
+	GPtrArray *subscribers;
+	LSError *lserror;
+	bool ret;
+} handle_subscription_call_t;
+
+static gboolean handle_process_cb(gpointer user_data)
+{
+	handle_subscription_call_t *call = user_data;
+
+	call->ret = transport->subscription_process(call->sh, call->message, call->subscribed, call->lserror);
+	return FALSE;
+}
+
+static gboolean handle_count_cb(gpointer user_data)
+{
+	handle_subscription_call_t *call = user_data;
+
+	call->ret = transport->subscription_count(call->sh, call->key, call->count, call->lserror);
+	return FALSE;
+}
+
+static gboolean handle_collect_cb(gpointer user_data)
+{
+	handle_subscription_call_t *call = user_data;
+
+	call->subscribers = transport->subscription_collect(call->sh, call->key, call->lserror);
+	return FALSE;
+}
+
+/**
+ * A reply sent from the handle's context
+ */
+
+typedef struct handle_reply
+{
+	LSHandle *sh;
+	LSMessage *message;
+	gchar *payload;
+} handle_reply_t;
+
+static gboolean handle_reply_cb(gpointer user_data)
+{
+	handle_reply_t *reply = user_data;
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	if (!transport->message_reply(reply->sh, reply->message, reply->payload, &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	transport->message_unref(reply->message);
+	g_free(reply->payload);
+	g_free(reply);
+
+	return FALSE;
+}
+
+bool luna_service_message_reply(LSHandle *sh, LSMessage *message, const char *payload, LSError *lserror)
+{
+	const char *method = transport->message_get_method(message);
+	size_t length = strlen(payload);
+
+	metrics_record(metrics_lookup(METRICS_GROUP_PAYLOAD, method), length, FALSE);
+	flight_recorder_add(FLIGHT_RECORDER_LUNA_REPLY, method, length);
+
+	GMainContext *context = handle_foreign_context(sh);
+	if (NULL != context)
+	{
+		handle_reply_t *reply = g_new0(handle_reply_t, 1);
+		reply->sh = sh;
+		reply->message = message;
+		reply->payload = g_strdup(payload);
+		transport->message_ref(message);
+		g_main_context_invoke(context, handle_reply_cb, reply);
+		return true;
+	}
+
+	return transport->message_reply(sh, message, payload, lserror);
+}
+
+bool luna_service_subscription_process(LSHandle *sh, LSMessage *message, bool *subscribed, LSError *lserror)
+{
+	GMainContext *context = handle_foreign_context(sh);
+	if (NULL != context)
+	{
+		handle_subscription_call_t call = { .sh = sh, .message = message, .subscribed = subscribed,
+							.lserror = lserror };
+		handle_call_sync(context, handle_process_cb, &call);
+		return call.ret;
+	}
+
+	return transport->subscription_process(sh, message, subscribed, lserror);
+}
+
+/*
+ * Subscription fan-out
+ */
+
+typedef struct fanout
+{
+	gchar *payload;
+	GPtrArray *subscribers;
+	guint next;
+	gboolean supersede;	/* full state, dropped when a newer state is posted */
+	gboolean superseded;
+} fanout_t;
+
+/* The fan-outs waiting for the same subscribers, delivered in order */
+typedef struct fanout_queue
+{
+	gchar *id;		/* handle and subscription key */
+	LSHandle *sh;
+	GQueue fanouts;
+} fanout_queue_t;
+
+/* Fan-out id to its fanout_queue_t, shared by all service contexts */
+static GHashTable *fanouts = NULL;
+G_LOCK_DEFINE_STATIC(fanouts);
+
+static void fanout_free(fanout_t *fanout)
+{
+	g_free(fanout->payload);
+	g_ptr_array_free(fanout->subscribers, TRUE);
+	g_free(fanout);
+}
+
+/**
+ * Get the fan-out to deliver next, dropping a superseded or finished head
+ *
+ * Frees the queue and returns NULL once nothing is left.
+ */
+
+static fanout_t *fanout_queue_next(fanout_queue_t *queue)
+{
+	fanout_t *fanout;
+
+	G_LOCK(fanouts);
+	while (NULL != (fanout = g_queue_peek_head(&queue->fanouts)))
+	{
+		if (!fanout->superseded && fanout->next < fanout->subscribers->len)
+			break;
+
+		g_queue_pop_head(&queue->fanouts);
+		fanout_free(fanout);
+	}
+
+	if (NULL == fanout)
+		g_hash_table_remove(fanouts, queue->id);
+	G_UNLOCK(fanouts);
+
+	if (NULL == fanout)
+	{
+		g_free(queue->id);
+		g_free(queue);
+	}
+
+	return fanout;
+}
+
+/**
+ * Reply to the next subscribers until the time slice is used up
+ */
+
+static gboolean fanout_cb(gpointer user_data)
+{
+	fanout_queue_t *queue = user_data;
+	gint64 start = g_get_monotonic_time();
+	fanout_t *fanout;
+
+	while (NULL != (fanout = fanout_queue_next(queue)))
+	{
+		while (fanout->next < fanout->subscribers->len)
+		{
+			LSError lserror;
+			LSErrorInit(&lserror);
+
+			LSMessage *message = g_ptr_array_index(fanout->subscribers, fanout->next++);
+			if (!transport->message_reply(queue->sh, message, fanout->payload, &lserror))
+				LSErrorFree(&lserror);
+
+			if (0 == fanout->next % SCHEDULER_FANOUT_CHUNK && scheduler_slice_expired(start))
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static bool subscription_post(LSHandle *sh, const char *category, const char *method, const char *payload,
+				gboolean supersede, LSError *lserror);
+
+/**
+ * A subscription post made from the handle's context
+ */
+
+typedef struct handle_post
+{
+	LSHandle *sh;
+	gchar *category;
+	gchar *method;
+	gchar *payload;
+	gboolean supersede;
+} handle_post_t;
+
+static gboolean handle_post_cb(gpointer user_data)
+{
+	handle_post_t *post = user_data;
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	if (!subscription_post(post->sh, post->category, post->method, post->payload, post->supersede, &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	g_free(post->category);
+	g_free(post->method);
+	g_free(post->payload);
+	g_free(post);
+
+	return FALSE;
+}
+
+static bool subscription_post(LSHandle *sh, const char *category, const char *method, const char *payload,
+				gboolean supersede, LSError *lserror)
+{
+	GMainContext *context = handle_foreign_context(sh);
+	if (NULL != context)
+	{
+		handle_post_t *post = g_new0(handle_post_t, 1);
+		post->sh = sh;
+		post->category = g_strdup(category);
+		post->method = g_strdup(method);
+		post->payload = g_strdup(payload);
+		post->supersede = supersede;
+		g_main_context_invoke(context, handle_post_cb, post);
+		return true;
+	}
+
+	gchar *key = subscription_key(category, method);
+	GPtrArray *subscribers = transport->subscription_collect(sh, key, lserror);
+
+	if (NULL == subscribers)
+	{
+		g_free(key);
+		return false;
+	}
+
+	metrics_record(metrics_lookup(METRICS_GROUP_FANOUT, method), subscribers->len, FALSE);
+	flight_recorder_add(FLIGHT_RECORDER_SUBSCRIPTION_POST, method, subscribers->len);
+	metrics_record(metrics_lookup(METRICS_GROUP_PAYLOAD, method), strlen(payload), FALSE);
+
+	fanout_t *fanout = g_new0(fanout_t, 1);
+	fanout->payload = g_strdup(payload);
+	fanout->subscribers = subscribers;
+	fanout->supersede = supersede;
+
+	gchar *id = g_strdup_printf("%p%s", (void *) sh, key);
+	g_free(key);
+
+	G_LOCK(fanouts);
+	if (NULL == fanouts)
+		fanouts = g_hash_table_new(g_str_hash, g_str_equal);
+
+	fanout_queue_t *queue = g_hash_table_lookup(fanouts, id);
+	gboolean created = (NULL == queue);
+	if (created)
+	{
+		queue = g_new0(fanout_queue_t, 1);
+		queue->id = id;
+		queue->sh = sh;
+		g_queue_init(&queue->fanouts);
+		g_hash_table_insert(fanouts, queue->id, queue);
+	}
+	else
+		g_free(id);
+
+	/* A newer state replaces the older ones not delivered yet, events are kept */
+	if (supersede)
+	{
+		GList *link = queue->fanouts.head;
+		while (NULL != link)
+		{
+			GList *next = link->next;
+			fanout_t *older = link->data;
+
+			if (older->supersede && link == queue->fanouts.head)
+				older->superseded = TRUE;	/* stopped at its next slice */
+			else if (older->supersede)
+			{
+				g_queue_delete_link(&queue->fanouts, link);
+				fanout_free(older);
+			}
+			link = next;
+		}
+	}
+	g_queue_push_tail(&queue->fanouts, fanout);
+	G_UNLOCK(fanouts);
+
+	if (created)
+		scheduler_idle_add(SCHEDULER_CLASS_BACKGROUND, fanout_cb, queue, NULL);
+
+	return true;
+}
+
+bool luna_service_subscription_post(LSHandle *sh, const char *category, const char *method, const char *payload, LSError *lserror)
+{
+	return subscription_post(sh, category, method, payload, TRUE, lserror);
+}
+
+bool luna_service_subscription_post_event(LSHandle *sh, const char *category, const char *method, const char *payload, LSError *lserror)
+{
+	return subscription_post(sh, category, method, payload, FALSE, lserror);
+}
+
+bool luna_service_subscription_count(LSHandle *sh, const char *key, unsigned int *count, LSError *lserror)
+{
+	GMainContext *context = handle_foreign_context(sh);
+	if (NULL != context)
+	{
+		handle_subscription_call_t call = { .sh = sh, .key = key, .count = count, .lserror = lserror };
+		handle_call_sync(context, handle_count_cb, &call);
+		return call.ret;
+	}
+
+	return transport->subscription_count(sh, key, count, lserror);
+}
+
+GPtrArray *luna_service_subscription_collect(LSHandle *sh, const char *category, const char *method, LSError *lserror)
+{
+	gchar *key = subscription_key(category, method);
+	GPtrArray *subscribers;
+
+	GMainContext *context = handle_foreign_context(sh);
+	if (NULL != context)
+	{
+		handle_subscription_call_t call = { .sh = sh, .key = key, .lserror = lserror };
+		handle_call_sync(context, handle_collect_cb, &call);
+		subscribers = call.subscribers;
+	}
+	else
+		subscribers = transport->subscription_collect(sh, key, lserror);
+
+	g_free(key);
+	return subscribers;
+}
+
+/*
+ * Periodic subscriptions
+ */
+
+luna_service_periodic_subscriber_t *luna_service_periodic_subscriber_new(LSHandle *sh, LSMessage *message,
+							guint interval, gpointer data, GDestroyNotify free_data)
+{
+	luna_service_periodic_subscriber_t *subscriber = g_new0(luna_service_periodic_subscriber_t, 1);
+
+	subscriber->handle = sh;
+	subscriber->message = message;
+	subscriber->interval = interval;
+	subscriber->data = data;
+	subscriber->free_data = free_data;
+	transport->message_ref(message);
+
+	return subscriber;
+}
+
+void luna_service_periodic_subscriber_free(luna_service_periodic_subscriber_t *subscriber)
+{
+	transport->message_unref(subscriber->message);
+	if (NULL != subscriber->free_data)
+		subscriber->free_data(subscriber->data);
+	g_free(subscriber);
+}
+
+/**
+ * Forget the subscribers whose subscription was cancelled
+ */
+
+static void periodic_prune(luna_service_periodic_t *periodic)
+{
+	LSHandle *collected = NULL;
+	GPtrArray *live = NULL;
+	GSList *iter = periodic->subscribers;
+
+	while (NULL != iter)
+	{
+		luna_service_periodic_subscriber_t *subscriber = iter->data;
+		GSList *next = iter->next;
+		guint i;
+
+		/* All subscribers normally share one handle, collected once */
+		if (NULL == live || subscriber->handle != collected)
+		{
+			LSError lserror;
+			LSErrorInit(&lserror);
+
+			if (NULL != live)
+				g_ptr_array_free(live, TRUE);
+
+			collected = subscriber->handle;
+			live = luna_service_subscription_collect(collected, "/", periodic->method, &lserror);
+			if (NULL == live)
+			{
+				LSErrorFree(&lserror);
+				return;
+			}
+		}
+
+		for (i = 0; i < live->len; i++)
+		{
+			if (g_ptr_array_index(live, i) == subscriber->message)
+				break;
+		}
+
+		if (i == live->len)
+		{
+			periodic->subscribers = g_slist_delete_link(periodic->subscribers, iter);
+			luna_service_periodic_subscriber_free(subscriber);
+		}
+		iter = next;
+	}
+
+	if (NULL != live)
+		g_ptr_array_free(live, TRUE);
+}
+
+static guint gcd(guint a, guint b)
+{
+	while (0 != b)
+	{
+		guint r = a % b;
+		a = b;
+		b = r;
+	}
+
+	return a;
+}
+
+static gboolean periodic_timeout_cb(gpointer user_data);
+
+/**
+ * Run the timer for the current subscribers, or stop it when there are none
+ *
+ * @return TRUE if the running timer was kept
+ */
+
+static gboolean periodic_update_timer(luna_service_periodic_t *periodic)
+{
+	GSList *iter;
+	guint period = 0;
+
+	for (iter = periodic->subscribers; NULL != iter; iter = iter->next)
+	{
+		luna_service_periodic_subscriber_t *subscriber = iter->data;
+		period = gcd(subscriber->interval, period);
+	}
+	if (0 != period && period < periodic->min_period)
+		period = periodic->min_period;
+
+	if (period == periodic->period && (0 == period || 0 != periodic->source))
+		return TRUE;
+
+	if (0 != periodic->source)
+		g_source_remove(periodic->source);
+
+	periodic->period = period;
+	periodic->source = 0;
+	if (0 != period)
+		periodic->source = scheduler_timeout_add(SCHEDULER_CLASS_BACKGROUND, period, periodic_timeout_cb,
+							periodic, NULL);
+
+	return FALSE;
+}
+
+static gboolean periodic_timeout_cb(gpointer user_data)
+{
+	luna_service_periodic_t *periodic = user_data;
+	GSList *iter;
+
+	periodic_prune(periodic);
+
+	gint64 now = g_get_monotonic_time();
+	GPtrArray *due = g_ptr_array_new();
+	for (iter = periodic->subscribers; NULL != iter; iter = iter->next)
+	{
+		luna_service_periodic_subscriber_t *subscriber = iter->data;
+
+		/* Never sooner than the interval, give or take a late previous tick */
+		if (now - subscriber->last_sent >= (gint64) (subscriber->interval - LUNA_SERVICE_PERIODIC_JITTER) * 1000)
+			g_ptr_array_add(due, subscriber);
+	}
+
+	if (due->len > 0)
+		periodic->tick(due, now);
+	g_ptr_array_free(due, TRUE);
+
+	/* The source was replaced or removed if the subscribers changed the period */
+	return periodic_update_timer(periodic);
+}
+
+void luna_service_periodic_add(luna_service_periodic_t *periodic, luna_service_periodic_subscriber_t *subscriber)
+{
+	periodic->subscribers = g_slist_prepend(periodic->subscribers, subscriber);
+	periodic_update_timer(periodic);
+}
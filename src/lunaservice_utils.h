@@ -21,6 +21,7 @@
  * @file lunaservice_utils.h
  *
  * @brief Header file defining convenience functions for sending luna error messages
+ * and the transport used by the luna method handlers
  *
  */
 
@@ -28,6 +29,7 @@
 #ifndef __LUNASERVICE_UTILS_H__
 #define __LUNASERVICE_UTILS_H__
 
+#include <glib.h>
 #include <luna-service2/lunaservice.h>
 
 typedef struct luna_service_request {
@@ -43,4 +45,180 @@ extern void LSMessageReplyErrorBadJSON(LSHandle *sh, LSMessage *message);
 extern void LSMessageReplyCustomError(LSHandle *sh, LSMessage *message, const char *errormsg);
 extern void LSMessageReplySuccess(LSHandle *sh, LSMessage *message);
 
+/**
+ * Transport used by the luna method handlers for replying to messages and
+ * handling subscriptions.
+ *
+ * The luna-service2 backend is used by default. The in-memory backend lets
+ * tools call the handlers directly without a running hub; the LSHandle and
+ * LSMessage pointers it passes around are its own objects and must only be
+ * used through the luna_service_* functions below.
+ */
+
+typedef struct luna_service_transport {
+	const char *name;
+	const char* (*message_get_payload)(LSMessage *message);
+	const char* (*message_get_method)(LSMessage *message);
+	bool (*message_is_subscription)(LSMessage *message);
+	void (*message_ref)(LSMessage *message);
+	void (*message_unref)(LSMessage *message);
+	bool (*message_reply)(LSHandle *sh, LSMessage *message, const char *payload, LSError *lserror);
+	bool (*subscription_process)(LSHandle *sh, LSMessage *message, bool *subscribed, LSError *lserror);
+	bool (*subscription_count)(LSHandle *sh, const char *key, unsigned int *count, LSError *lserror);
+	/* Referenced subscribed messages, NULL on error */
+	GPtrArray* (*subscription_collect)(LSHandle *sh, const char *key, LSError *lserror);
+} luna_service_transport_t;
+
+extern const luna_service_transport_t luna_service_transport_ls2;
+extern const luna_service_transport_t luna_service_transport_memory;
+
+extern void luna_service_set_transport(const luna_service_transport_t *transport);
+
+extern const char *luna_service_message_get_payload(LSMessage *message);
+extern const char *luna_service_message_get_method(LSMessage *message);
+extern bool luna_service_message_is_subscription(LSMessage *message);
+extern void luna_service_message_ref(LSMessage *message);
+extern void luna_service_message_unref(LSMessage *message);
+extern bool luna_service_message_reply(LSHandle *sh, LSMessage *message, const char *payload, LSError *lserror);
+
+/**
+ * Record the context a handle is attached to, when it is not the default one
+ *
+ * Replies and subscription calls made for the handle from other threads
+ * are then run on that context, since luna-service2 handles are not thread
+ * safe. Replies and posts are sent asynchronously, and their errors only
+ * logged. The handle's context must never wait for another context.
+ */
+extern void luna_service_handle_set_context(LSHandle *sh, GMainContext *context);
+extern bool luna_service_subscription_process(LSHandle *sh, LSMessage *message, bool *subscribed, LSError *lserror);
+
+/**
+ * Post a payload to all subscribers of a method
+ *
+ * The replies are sent from a background priority source on the thread
+ * default context, a bounded chunk at a time, in the order posted. The
+ * payload is taken as the full state, so a newer post to the same method
+ * supersedes the part of an older one not delivered yet.
+ */
+extern bool luna_service_subscription_post(LSHandle *sh, const char *category, const char *method, const char *payload, LSError *lserror);
+
+/**
+ * Post an event to all subscribers of a method
+ *
+ * Like luna_service_subscription_post(), but the payload is never
+ * superseded, every subscriber gets it in order with the other posts.
+ */
+extern bool luna_service_subscription_post_event(LSHandle *sh, const char *category, const char *method, const char *payload, LSError *lserror);
+extern bool luna_service_subscription_count(LSHandle *sh, const char *key, unsigned int *count, LSError *lserror);
+
+/**
+ * Get the messages currently subscribed to a method
+ *
+ * @return Array holding a reference on each message, NULL on error
+ */
+extern GPtrArray *luna_service_subscription_collect(LSHandle *sh, const char *category, const char *method, LSError *lserror);
+
+/**
+ * Periodic updates to the subscribers of a method
+ *
+ * One timer serves all subscribers. It runs at the greatest common divisor
+ * of their intervals, but not faster than min_period, and only while there
+ * are any. On each tick the cancelled subscriptions are dropped and the
+ * subscribers whose interval has passed are handed to the tick callback.
+ */
+
+/* How early a tick may come and still count as a subscriber's full interval, in milliseconds */
+#define LUNA_SERVICE_PERIODIC_JITTER	5
+
+typedef struct luna_service_periodic_subscriber {
+	LSHandle *handle;
+	LSMessage *message;
+	guint interval;		/* ms */
+	gint64 last_sent;	/* monotonic time, kept up to date by the tick callback */
+	gpointer data;		/* state of the method for this subscriber */
+	GDestroyNotify free_data;
+} luna_service_periodic_subscriber_t;
+
+/**
+ * Send the due subscribers their update and move their last_sent on
+ *
+ * @param[IN]  due Array of luna_service_periodic_subscriber_t
+ * @param[IN]  now Monotonic time of the tick
+ */
+typedef void (*luna_service_periodic_tick_cb)(GPtrArray *due, gint64 now);
+
+typedef struct luna_service_periodic {
+	const char *method;	/* subscription method, in the root category */
+	guint min_period;	/* ms */
+	luna_service_periodic_tick_cb tick;
+	GSList *subscribers;
+	guint source;
+	guint period;
+} luna_service_periodic_t;
+
+/**
+ * Create a subscriber, taking a reference on the message
+ */
+extern luna_service_periodic_subscriber_t *luna_service_periodic_subscriber_new(LSHandle *sh, LSMessage *message,
+							guint interval, gpointer data, GDestroyNotify free_data);
+extern void luna_service_periodic_subscriber_free(luna_service_periodic_subscriber_t *subscriber);
+
+/**
+ * Start serving a subscriber, restarting the timer if its interval needs it
+ */
+extern void luna_service_periodic_add(luna_service_periodic_t *periodic, luna_service_periodic_subscriber_t *subscriber);
+
+/**
+ * Method table of one luna service
+ *
+ * The luna-service2 hub calls every method through a single dispatch
+ * function which looks up the real handler and records its latency in
+ * the metrics registry.
+ */
+
+struct metrics_histogram;
+
+typedef struct luna_service_category {
+	gchar *service_name;
+	const LSMethod *methods;
+	guint n_methods;
+	struct metrics_histogram **latency;
+	LSMethod *dispatch_table;
+	GMainContext *owner_context;
+	gboolean *local;
+} luna_service_category_t;
+
+extern luna_service_category_t *luna_service_category_new(const char *service_name, const LSMethod *methods);
+extern bool luna_service_register_category(LSHandle *sh, luna_service_category_t *category, LSError *lserror);
+extern bool luna_service_dispatch(luna_service_category_t *category, LSHandle *sh, LSMessage *message);
+
+/**
+ * Run the handlers of a category on the context owning the connman objects
+ *
+ * For a handle attached to another context. Methods not listed in
+ * local_methods are handed over to owner_context with a reference on the
+ * message. Their replies and subscription calls go back to the handle's
+ * context, which must be recorded with luna_service_handle_set_context().
+ * The listed ones must only read thread safe state and run on the handle's
+ * own context.
+ */
+
+extern void luna_service_category_set_owner(luna_service_category_t *category, GMainContext *owner_context,
+						const char * const *local_methods);
+
+/**
+ * In-memory backend
+ *
+ * Replies and subscription posts for a message are delivered to its reply
+ * callback. The message is created with one reference which the caller
+ * drops with luna_service_message_unref() once the handler returned.
+ */
+
+typedef void (*luna_service_memory_reply_cb)(LSMessage *message, const char *payload, gpointer user_data);
+
+extern LSMessage *luna_service_memory_message_new(const char *method, const char *payload, bool subscribe,
+						luna_service_memory_reply_cb cb, gpointer user_data);
+extern void luna_service_memory_message_cancel(LSMessage *message);
+extern bool luna_service_memory_call(LSHandle *sh, luna_service_category_t *category, LSMessage *message);
+
 #endif
@@ -23,9 +23,14 @@
 
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <signal.h>
 #include <glib.h>
+#include <glib-unix.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <getopt.h>
@@ -35,9 +40,19 @@
 #include "logging.h"
 #include "wifi_service.h"
 #include "connectionmanager_service.h"
+#include "connman_trace.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "flight_recorder.h"
+#include "offload.h"
+#include "network_state.h"
+#include "status_page.h"
 
 static GMainLoop *mainloop = NULL;
 
+/* Loop of com.palm.connectionmanager when it runs on its own thread */
+static GMainLoop *connectionmanager_loop = NULL;
+
 int initialize_wifi_ls2_calls();
 
 /**
@@ -47,15 +62,119 @@ PmLogContext gLogContext;
 
 static const char* const kLogContextName = "webos-connman-adapter";
 
+static const struct option long_options[] = {
+    { "record", required_argument, NULL, 'r' },
+    { "watchdog", required_argument, NULL, 'w' },
+    { "split-contexts", no_argument, NULL, 's' },
+    { "help",   no_argument,       NULL, 'h' },
+    { NULL,     0,                 NULL, 0 }
+};
+
+static void
+print_usage(const char *name)
+{
+    printf("Usage: %s [OPTION]...\n"
+           "  -r, --record=FILE  record all D-Bus traffic with connman to FILE\n"
+           "  -w, --watchdog=MS  log main loop stalls longer than MS milliseconds\n"
+           "                     (default %d, 0 to disable)\n"
+           "  -s, --split-contexts  dispatch com.palm.connectionmanager on its own thread\n"
+           "  -h, --help         show this help\n", name, WATCHDOG_DEFAULT_THRESHOLD);
+}
+
 void
 term_handler(int signal)
 {
     g_main_loop_quit(mainloop);
 }
 
+static gpointer
+run_connectionmanager_loop(gpointer data)
+{
+    GMainContext *context = g_main_loop_get_context(connectionmanager_loop);
+
+    g_main_context_push_thread_default(context);
+    g_main_loop_run(connectionmanager_loop);
+    g_main_context_pop_thread_default(context);
+
+    return NULL;
+}
+
+static gboolean
+dump_flight_recorder(gpointer user_data)
+{
+    struct stat st;
+
+    /* Never write through a directory or file someone else could have planted */
+    if (mkdir(FLIGHT_RECORDER_DUMP_DIR, 0700) < 0 && errno != EEXIST)
+        goto error;
+
+    if (lstat(FLIGHT_RECORDER_DUMP_DIR, &st) < 0)
+        goto error;
+
+    if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))
+    {
+        WCA_LOG_ERROR("%s is not owned by the adapter, not writing the flight recorder",
+                      FLIGHT_RECORDER_DUMP_DIR);
+        return TRUE;
+    }
+
+    int fd = open(FLIGHT_RECORDER_DUMP_PATH, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0)
+        goto error;
+
+    FILE *file = fdopen(fd, "w");
+    if (NULL == file)
+    {
+        close(fd);
+        goto error;
+    }
+
+    flight_recorder_dump(file);
+    fclose(file);
+    WCA_LOG_INFO("Flight recorder written to %s", FLIGHT_RECORDER_DUMP_PATH);
+
+    return TRUE;
+
+error:
+    WCA_LOG_ERROR("Could not open %s: %s", FLIGHT_RECORDER_DUMP_PATH, strerror(errno));
+    return TRUE;
+}
+
 int
 main(int argc, char **argv)
 {
+    const char *record_file = NULL;
+    int watchdog_threshold = WATCHDOG_DEFAULT_THRESHOLD;
+    bool split_contexts = false;
+    GThread *connectionmanager_thread = NULL;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "r:w:sh", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            record_file = optarg;
+            break;
+        case 'w':
+            watchdog_threshold = atoi(optarg);
+            if (watchdog_threshold < 0)
+            {
+                print_usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 's':
+            split_contexts = true;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
 
     signal(SIGTERM, term_handler);
     signal(SIGINT, term_handler);
@@ -66,20 +185,61 @@ main(int argc, char **argv)
 
     WCA_LOG_INFO("Starting webos-connman-adapter");
 
+    /* Start recording before any connman proxy exists so the initial replies are traced */
+    if(NULL != record_file && !connman_trace_start(record_file))
+    {
+        WCA_LOG_FATAL("Error in starting connman trace");
+        return -1;
+    }
+
+    /* Readers without luna fall back to getstatus if there is no page */
+    if(!status_page_init())
+        WCA_LOG_ERROR("Status page not available");
+
+    network_state_init();
+    offload_init(NULL);
+    metrics_watch_dbus();
+    flight_recorder_watch_dbus();
+    g_unix_signal_add(SIGUSR1, dump_flight_recorder, NULL);
+
     if(initialize_wifi_ls2_calls(mainloop) < 0)
     {
         WCA_LOG_FATAL("Error in initializing com.palm.wifi service");
         return -1;
     }  
 
-    if(initialize_connectionmanager_ls2_calls(mainloop) < 0)
+    /* Connman signals keep being handled on the main loop, which feeds both services */
+    if(split_contexts)
+    {
+        GMainContext *context = g_main_context_new();
+        connectionmanager_loop = g_main_loop_new(context, FALSE);
+        g_main_context_unref(context);
+    }
+
+    if(initialize_connectionmanager_ls2_calls(split_contexts ? connectionmanager_loop : mainloop) < 0)
     {
         WCA_LOG_FATAL("Error in initializing com.palm.connectionmanager service");
         return -1;
     }
 
+    if(split_contexts)
+        connectionmanager_thread = g_thread_new("connectionmanager", run_connectionmanager_loop, NULL);
+
+    watchdog_start(watchdog_threshold);
+
     g_main_loop_run(mainloop);
 
+    watchdog_stop();
+
+    if(NULL != connectionmanager_thread)
+    {
+        g_main_loop_quit(connectionmanager_loop);
+        g_thread_join(connectionmanager_thread);
+        g_main_loop_unref(connectionmanager_loop);
+    }
+
+    connman_trace_stop();
+
     g_main_loop_unref(mainloop);
 
      return 0;
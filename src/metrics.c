@@ -0,0 +1,295 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  metrics.c
+ *
+ * @brief Registry of latency histograms and counters
+ *
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "metrics.h"
+#include "logging.h"
+
+/* Maximum number of histograms per group */
+#define METRICS_TABLE_SIZE	128
+
+/* Give up on connman calls whose reply was never seen */
+#define METRICS_MAX_PENDING_CALLS	1024
+
+static metrics_histogram_t *metrics_table[METRICS_GROUP_COUNT][METRICS_TABLE_SIZE];
+
+static const char *metrics_group_names[METRICS_GROUP_COUNT] = {
+	"lunaMethodsUs",
+	"dbusCallsUs",
+	"signalsUs",
+	"subscriptionFanout",
+	"payloadBytes",
+	"mainLoopStallsMs",
+};
+
+/**
+ * Look up or create a histogram (see header for API details)
+ *
+ * Histograms live in an open addressing table per group; empty slots are
+ * claimed with a compare-and-swap so concurrent lookups never block.
+ */
+
+metrics_histogram_t *metrics_lookup(metrics_group_t group, const gchar *name)
+{
+	guint hash, i;
+
+	if(group >= METRICS_GROUP_COUNT || NULL == name)
+		return NULL;
+
+	hash = g_str_hash(name);
+	for (i = 0; i < METRICS_TABLE_SIZE; i++)
+	{
+		gpointer *slot = (gpointer *) &metrics_table[group][(hash + i) % METRICS_TABLE_SIZE];
+		metrics_histogram_t *histogram = g_atomic_pointer_get(slot);
+
+		if(NULL == histogram)
+		{
+			metrics_histogram_t *new_histogram = g_new0(metrics_histogram_t, 1);
+			new_histogram->name = g_strdup(name);
+			if(g_atomic_pointer_compare_and_exchange(slot, NULL, new_histogram))
+				return new_histogram;
+
+			/* somebody else claimed the slot first */
+			g_free(new_histogram->name);
+			g_free(new_histogram);
+			histogram = g_atomic_pointer_get(slot);
+		}
+
+		if(g_str_equal(histogram->name, name))
+			return histogram;
+	}
+
+	return NULL;
+}
+
+/**
+ * Record a value (see header for API details)
+ */
+
+void metrics_record(metrics_histogram_t *histogram, guint64 value, gboolean error)
+{
+	guint bucket;
+	guint64 max;
+
+	if(NULL == histogram)
+		return;
+
+	bucket = (0 == value) ? 0 : MIN(g_bit_storage(value), METRICS_HISTOGRAM_BUCKETS - 1);
+
+	__atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&histogram->buckets[bucket], 1, __ATOMIC_RELAXED);
+	if(error)
+		__atomic_fetch_add(&histogram->errors, 1, __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+	while (value > max &&
+		!__atomic_compare_exchange_n(&histogram->max, &max, value, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+void metrics_record_since(metrics_group_t group, const gchar *name, gint64 start)
+{
+	metrics_record(metrics_lookup(group, name), g_get_monotonic_time() - start, FALSE);
+}
+
+/**
+ * Tracking of connman calls
+ *
+ * Filters run on the GDBus worker thread only, so the table of pending
+ * calls needs no locking.
+ */
+
+typedef struct metrics_pending_call
+{
+	gint64 start;
+	metrics_histogram_t *histogram;
+}metrics_pending_call_t;
+
+static GHashTable *pending_calls = NULL;
+
+static GDBusMessage *metrics_dbus_filter(GDBusConnection *connection, GDBusMessage *message,
+				gboolean incoming, gpointer user_data)
+{
+	GDBusMessageType type = g_dbus_message_get_message_type(message);
+
+	if(!incoming && type == G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+		!g_strcmp0(g_dbus_message_get_destination(message), "net.connman"))
+	{
+		metrics_pending_call_t *call = g_new0(metrics_pending_call_t, 1);
+		gchar *name = g_strdup_printf("%s.%s", g_dbus_message_get_interface(message),
+						g_dbus_message_get_member(message));
+
+		call->start = g_get_monotonic_time();
+		call->histogram = metrics_lookup(METRICS_GROUP_DBUS, name);
+		g_free(name);
+
+		if(g_hash_table_size(pending_calls) >= METRICS_MAX_PENDING_CALLS)
+			g_hash_table_remove_all(pending_calls);
+		g_hash_table_replace(pending_calls, GUINT_TO_POINTER(g_dbus_message_get_serial(message)), call);
+	}
+	else if(incoming && (type == G_DBUS_MESSAGE_TYPE_METHOD_RETURN || type == G_DBUS_MESSAGE_TYPE_ERROR))
+	{
+		gpointer serial = GUINT_TO_POINTER(g_dbus_message_get_reply_serial(message));
+		metrics_pending_call_t *call = g_hash_table_lookup(pending_calls, serial);
+
+		if(NULL != call)
+		{
+			metrics_record(call->histogram, g_get_monotonic_time() - call->start,
+					type == G_DBUS_MESSAGE_TYPE_ERROR);
+			g_hash_table_remove(pending_calls, serial);
+		}
+	}
+
+	return message;
+}
+
+/**
+ * Start recording connman calls (see header for API details)
+ */
+
+void metrics_watch_dbus(void)
+{
+	GError *error = NULL;
+	GDBusConnection *connection;
+
+	if(NULL != pending_calls)
+		return;
+
+	connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if(error)
+	{
+		WCA_LOG_ERROR("Could not connect to system bus for metrics: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+
+	pending_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	g_dbus_connection_add_filter(connection, metrics_dbus_filter, NULL, NULL);
+
+	/* the connection stays referenced by the filter for the lifetime of the process */
+}
+
+/**
+ * Reset all counters (see header for API details)
+ */
+
+void metrics_reset(void)
+{
+	guint group, i, bucket;
+
+	for (group = 0; group < METRICS_GROUP_COUNT; group++)
+	{
+		for (i = 0; i < METRICS_TABLE_SIZE; i++)
+		{
+			metrics_histogram_t *histogram = g_atomic_pointer_get(&metrics_table[group][i]);
+			if(NULL == histogram)
+				continue;
+
+			__atomic_store_n(&histogram->count, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&histogram->errors, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&histogram->sum, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&histogram->max, 0, __ATOMIC_RELAXED);
+			for (bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+				__atomic_store_n(&histogram->buckets[bucket], 0, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/**
+ * Upper bound of the bucket holding the given percentile
+ */
+
+static guint64 histogram_percentile(guint64 *buckets, guint64 count, guint pct)
+{
+	guint64 rank = (count * pct + 99) / 100, seen = 0;
+	guint bucket;
+
+	for (bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+	{
+		seen += buckets[bucket];
+		if(seen >= rank && seen > 0)
+			return (0 == bucket) ? 0 : ((guint64) 1 << bucket);
+	}
+
+	return 0;
+}
+
+static jvalue_ref histogram_to_json(metrics_histogram_t *histogram)
+{
+	jvalue_ref histogram_j = jobject_create();
+	jvalue_ref buckets_j = jarray_create(NULL);
+	guint64 buckets[METRICS_HISTOGRAM_BUCKETS];
+	guint bucket, last = 0;
+
+	guint64 count = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+	for (bucket = 0; bucket < METRICS_HISTOGRAM_BUCKETS; bucket++)
+	{
+		buckets[bucket] = __atomic_load_n(&histogram->buckets[bucket], __ATOMIC_RELAXED);
+		if(buckets[bucket])
+			last = bucket + 1;
+	}
+	for (bucket = 0; bucket < last; bucket++)
+		jarray_append(buckets_j, jnumber_create_i64(buckets[bucket]));
+
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("count"), jnumber_create_i64(count));
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("errors"), jnumber_create_i64(__atomic_load_n(&histogram->errors, __ATOMIC_RELAXED)));
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("sum"), jnumber_create_i64(__atomic_load_n(&histogram->sum, __ATOMIC_RELAXED)));
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("max"), jnumber_create_i64(__atomic_load_n(&histogram->max, __ATOMIC_RELAXED)));
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("p50"), jnumber_create_i64(histogram_percentile(buckets, count, 50)));
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("p99"), jnumber_create_i64(histogram_percentile(buckets, count, 99)));
+	jobject_put(histogram_j, J_CSTR_TO_JVAL("buckets"), buckets_j);
+
+	return histogram_j;
+}
+
+/**
+ * Build the JSON representation of all metrics (see header for API details)
+ */
+
+jvalue_ref metrics_to_json(void)
+{
+	jvalue_ref metrics_j = jobject_create();
+	guint group, i;
+
+	for (group = 0; group < METRICS_GROUP_COUNT; group++)
+	{
+		jvalue_ref group_j = jobject_create();
+
+		for (i = 0; i < METRICS_TABLE_SIZE; i++)
+		{
+			metrics_histogram_t *histogram = g_atomic_pointer_get(&metrics_table[group][i]);
+			if(NULL != histogram)
+				jobject_put(group_j, jstring_create(histogram->name), histogram_to_json(histogram));
+		}
+
+		jobject_put(metrics_j, jstring_create(metrics_group_names[group]), group_j);
+	}
+
+	return metrics_j;
+}
@@ -0,0 +1,104 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  metrics.h
+ *
+ * @brief Header file defining the registry of runtime metrics
+ *
+ */
+
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <glib.h>
+#include <pbnjson.h>
+
+/**
+ * Number of buckets of each histogram. Bucket 0 counts zero values,
+ * bucket i counts values in [2^(i-1), 2^i) and the last bucket counts
+ * everything above.
+ */
+#define METRICS_HISTOGRAM_BUCKETS	24
+
+/**
+ * Groups of metrics, each holding histograms identified by name
+ */
+typedef enum {
+	METRICS_GROUP_LUNA = 0,		/* luna method latency (us), by "<service>/<method>" */
+	METRICS_GROUP_DBUS,		/* connman call latency (us) and errors, by "<interface>.<member>" */
+	METRICS_GROUP_SIGNAL,		/* connman signal handling time (us), by "<interface>.<member>" */
+	METRICS_GROUP_FANOUT,		/* subscribers per subscription post, by method */
+	METRICS_GROUP_PAYLOAD,		/* luna reply and post payload size (bytes), by method */
+	METRICS_GROUP_STALL,		/* main loop stall duration (ms), by the activity running at the time */
+	METRICS_GROUP_COUNT
+} metrics_group_t;
+
+/**
+ * A histogram with running totals
+ *
+ * All fields are updated with atomic operations so recording never blocks.
+ */
+typedef struct metrics_histogram
+{
+	gchar *name;
+	guint64 count;
+	guint64 errors;
+	guint64 sum;
+	guint64 max;
+	guint64 buckets[METRICS_HISTOGRAM_BUCKETS];
+}metrics_histogram_t;
+
+/**
+ * Look up the histogram with the given name, creating it if needed
+ *
+ * Lock-free and callable from any thread. The returned histogram is never
+ * freed so callers may cache it.
+ *
+ * @return NULL if the group is full
+ */
+extern metrics_histogram_t *metrics_lookup(metrics_group_t group, const gchar *name);
+
+/**
+ * Record a value in a histogram, counting it as an error if requested
+ */
+extern void metrics_record(metrics_histogram_t *histogram, guint64 value, gboolean error);
+
+/**
+ * Record the time elapsed since start (from g_get_monotonic_time) in the named histogram
+ */
+extern void metrics_record_since(metrics_group_t group, const gchar *name, gint64 start);
+
+/**
+ * Start recording latency and errors of all calls to net.connman on the system bus
+ */
+extern void metrics_watch_dbus(void);
+
+/**
+ * Reset all counters to zero (the histograms themselves are kept)
+ */
+extern void metrics_reset(void);
+
+/**
+ * Build a JSON object with one member per group
+ */
+extern jvalue_ref metrics_to_json(void);
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,287 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  netlink_monitor.c
+ *
+ * @brief Watches rtnetlink for link and IPv4 address changes
+ *
+ * Cable plug and unplug and DHCP address changes are seen here as soon as
+ * the kernel makes them, before connman has processed them. They are
+ * stored in the interface facts and reported through a callback, several
+ * changes in a row coalescing into a single call.
+ *
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <glib.h>
+
+#include "netlink_monitor.h"
+#include "interface_facts.h"
+#include "scheduler.h"
+#include "logging.h"
+
+static int netlink_socket = -1;
+static guint watch_source = 0;
+static guint coalesce_source = 0;
+static netlink_monitor_changed_cb changed_callback = NULL;
+
+static gboolean changed_timeout_cb(gpointer user_data)
+{
+	coalesce_source = 0;
+
+	if(NULL != changed_callback)
+		changed_callback();
+
+	return FALSE;
+}
+
+static void schedule_changed(void)
+{
+	if(0 == coalesce_source)
+		coalesce_source = scheduler_timeout_add(SCHEDULER_CLASS_SIGNAL, NETLINK_MONITOR_COALESCE_INTERVAL,
+						changed_timeout_cb, NULL, NULL);
+}
+
+/**
+ * Read every interface from the kernel again, after notifications were lost
+ */
+
+static void resync(void)
+{
+	gint iface;
+
+	WCA_LOG_INFO("Netlink notifications were dropped, reading interfaces again");
+
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+		interface_facts_refresh(iface);
+}
+
+static gboolean handle_link(struct nlmsghdr *nlh)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+	struct rtattr *rta;
+	int len = IFLA_PAYLOAD(nlh);
+	const gchar *name = NULL;
+	const guchar *hwaddr = NULL;
+	guint mtu = 0;
+
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+	{
+		switch(rta->rta_type)
+		{
+			case IFLA_IFNAME:
+				name = RTA_DATA(rta);
+				break;
+			case IFLA_MTU:
+				mtu = *(guint32 *) RTA_DATA(rta);
+				break;
+			case IFLA_ADDRESS:
+				if(RTA_PAYLOAD(rta) == 6)
+					hwaddr = RTA_DATA(rta);
+				break;
+		}
+	}
+
+	gint iface = interface_facts_lookup(name);
+	if(iface < 0)
+		return FALSE;
+
+	gboolean changed = interface_facts_update_link(iface, nlh->nlmsg_type == RTM_NEWLINK, ifi->ifi_index,
+						ifi->ifi_flags, mtu, hwaddr);
+	if(changed)
+		WCA_LOG_DEBUG("Link %s %s, carrier %d", name, nlh->nlmsg_type == RTM_NEWLINK ? "changed" : "removed",
+				(ifi->ifi_flags & IFF_RUNNING) != 0);
+
+	return changed;
+}
+
+static gboolean handle_address(struct nlmsghdr *nlh)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+	struct rtattr *rta;
+	int len = IFA_PAYLOAD(nlh);
+	const void *local = NULL, *address = NULL;
+	gchar buffer[INET_ADDRSTRLEN];
+
+	if(ifa->ifa_family != AF_INET)
+		return FALSE;
+
+	for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+	{
+		if(rta->rta_type == IFA_LOCAL)
+			local = RTA_DATA(rta);
+		else if(rta->rta_type == IFA_ADDRESS)
+			address = RTA_DATA(rta);
+	}
+
+	/* On point to point links IFA_ADDRESS is the peer */
+	if(NULL != local)
+		address = local;
+
+	gint iface = interface_facts_lookup_index(ifa->ifa_index);
+	if(iface < 0 || NULL == address || NULL == inet_ntop(AF_INET, address, buffer, sizeof(buffer)))
+		return FALSE;
+
+	gboolean changed = interface_facts_update_address(iface, buffer, ifa->ifa_prefixlen,
+						nlh->nlmsg_type == RTM_NEWADDR);
+	if(changed)
+		WCA_LOG_DEBUG("Address %s/%d %s", buffer, ifa->ifa_prefixlen,
+				nlh->nlmsg_type == RTM_NEWADDR ? "added" : "removed");
+
+	return changed;
+}
+
+static gboolean netlink_io_cb(GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	guint32 buffer[2048];
+	gboolean changed = FALSE;
+
+	if(condition & (G_IO_ERR | G_IO_HUP))
+	{
+		WCA_LOG_ERROR("Netlink socket failed, link changes are only seen through connman now");
+		watch_source = 0;
+		netlink_monitor_stop();
+		return FALSE;
+	}
+
+	while(TRUE)
+	{
+		struct sockaddr_nl sender;
+		socklen_t sender_len = sizeof(sender);
+		int len = recvfrom(netlink_socket, buffer, sizeof(buffer), MSG_DONTWAIT,
+					(struct sockaddr *) &sender, &sender_len);
+		if(len < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == ENOBUFS)
+			{
+				resync();
+				changed = TRUE;
+				continue;
+			}
+			break;
+		}
+
+		if(0 == len)
+			break;
+
+		/* Only trust messages from the kernel */
+		if(sender.nl_pid != 0)
+			continue;
+
+		struct nlmsghdr *nlh;
+		for (nlh = (struct nlmsghdr *) buffer; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len))
+		{
+			switch(nlh->nlmsg_type)
+			{
+				case RTM_NEWLINK:
+				case RTM_DELLINK:
+					changed |= handle_link(nlh);
+					break;
+				case RTM_NEWADDR:
+				case RTM_DELADDR:
+					changed |= handle_address(nlh);
+					break;
+			}
+		}
+	}
+
+	if(changed)
+		schedule_changed();
+
+	return TRUE;
+}
+
+gboolean netlink_monitor_start(netlink_monitor_changed_cb changed_cb)
+{
+	struct sockaddr_nl local;
+	gint iface;
+
+	if(netlink_socket >= 0)
+		return TRUE;
+
+	netlink_socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+	if(netlink_socket < 0)
+	{
+		WCA_LOG_ERROR("Could not open netlink socket: %s", strerror(errno));
+		return FALSE;
+	}
+
+	memset(&local, 0, sizeof(local));
+	local.nl_family = AF_NETLINK;
+	local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+
+	if(bind(netlink_socket, (struct sockaddr *) &local, sizeof(local)) < 0)
+	{
+		WCA_LOG_ERROR("Could not bind netlink socket: %s", strerror(errno));
+		close(netlink_socket);
+		netlink_socket = -1;
+		return FALSE;
+	}
+
+	changed_callback = changed_cb;
+
+	/* Subscribed first, so nothing happening while reading is missed */
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+		interface_facts_refresh(iface);
+	interface_facts_set_monitored(TRUE);
+
+	GIOChannel *channel = g_io_channel_unix_new(netlink_socket);
+	GSource *source = g_io_create_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP);
+	g_source_set_priority(source, scheduler_priority(SCHEDULER_CLASS_SIGNAL));
+	g_source_set_callback(source, (GSourceFunc) netlink_io_cb, NULL, NULL);
+	watch_source = g_source_attach(source, NULL);
+	g_source_unref(source);
+	g_io_channel_unref(channel);
+
+	return TRUE;
+}
+
+void netlink_monitor_stop(void)
+{
+	if(0 != watch_source)
+	{
+		g_source_remove(watch_source);
+		watch_source = 0;
+	}
+
+	if(0 != coalesce_source)
+	{
+		g_source_remove(coalesce_source);
+		coalesce_source = 0;
+	}
+
+	if(netlink_socket >= 0)
+	{
+		close(netlink_socket);
+		netlink_socket = -1;
+	}
+
+	interface_facts_set_monitored(FALSE);
+	changed_callback = NULL;
+}
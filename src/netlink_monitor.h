@@ -0,0 +1,59 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  netlink_monitor.h
+ *
+ * @brief Header file defining the rtnetlink watcher keeping the interface
+ *        facts current
+ *
+ */
+
+
+#ifndef NETLINK_MONITOR_H_
+#define NETLINK_MONITOR_H_
+
+#include <glib.h>
+
+/**
+ * Time in milliseconds link and address changes are collected before the
+ * changed callback runs
+ */
+#define NETLINK_MONITOR_COALESCE_INTERVAL	50
+
+/**
+ * Called once per burst of carrier or address changes on a configured interface
+ */
+typedef void (*netlink_monitor_changed_cb)(void);
+
+/**
+ * Start listening for link and IPv4 address changes on the main context
+ *
+ * @param[IN]  changed_cb Called after changes were stored in the interface facts
+ *
+ * @return TRUE if the netlink socket could be opened
+ */
+extern gboolean netlink_monitor_start(netlink_monitor_changed_cb changed_cb);
+
+/**
+ * Stop listening, the interface facts go back to expiring
+ */
+extern void netlink_monitor_stop(void);
+
+#endif /* NETLINK_MONITOR_H_ */
@@ -0,0 +1,374 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  network_state.c
+ *
+ * @brief Builds and publishes immutable snapshots of the network state
+ *
+ * The snapshot is rebuilt on the main loop after connman signals, link
+ * notifications or profile changes. Services which did not change since the previous
+ * snapshot are shared with it rather than copied again. Publishing is
+ * a single atomic pointer exchange; readers take a reference without
+ * any lock.
+ *
+ */
+
+#include <arpa/inet.h>
+#include <glib.h>
+
+#include "network_state.h"
+#include "connman_manager.h"
+#include "connman_technology.h"
+#include "wifi_profile.h"
+#include "common.h"
+#include "logging.h"
+#include "status_page.h"
+
+static network_state_t *current = NULL;
+static guint64 current_version = 0;
+
+/* Number of readers between loading current and taking their reference */
+static gint readers = 0;
+
+static gint dirty = 1;
+static guint rebuild_source = 0;
+static GThread *publisher = NULL;
+
+/**
+ * Copy a connman service
+ */
+
+network_service_state_t *network_service_state_new(connman_service_t *service)
+{
+	network_service_state_t *entry = g_new0(network_service_state_t, 1);
+
+	entry->ref_count = 1;
+	entry->generation = service->generation;
+	entry->path = g_strdup(service->path);
+	entry->name = g_strdup(service->name);
+	entry->state = g_strdup(service->state);
+	entry->type = service->type;
+	entry->strength = service->strength;
+	entry->security = g_strdupv(service->security);
+	entry->hidden = service->hidden;
+	entry->favorite = service->favorite;
+	entry->auto_connect = service->auto_connect;
+	entry->iface = g_strdup(service->ipinfo.iface);
+	entry->ipv4_method = g_strdup(service->ipinfo.ipv4.method);
+	entry->ipv4_address = g_strdup(service->ipinfo.ipv4.address);
+	entry->ipv4_netmask = g_strdup(service->ipinfo.ipv4.netmask);
+	entry->ipv4_gateway = g_strdup(service->ipinfo.ipv4.gateway);
+	entry->nameservers = g_strdupv(service->ipinfo.dns);
+
+	return entry;
+}
+
+void network_service_state_unref(gpointer data)
+{
+	network_service_state_t *entry = data;
+
+	if(!g_atomic_int_dec_and_test(&entry->ref_count))
+		return;
+
+	g_free(entry->path);
+	g_free(entry->name);
+	g_free(entry->state);
+	g_strfreev(entry->security);
+	g_free(entry->iface);
+	g_free(entry->ipv4_method);
+	g_free(entry->ipv4_address);
+	g_free(entry->ipv4_netmask);
+	g_free(entry->ipv4_gateway);
+	g_strfreev(entry->nameservers);
+	g_free(entry);
+}
+
+static void technology_state_free(gpointer data)
+{
+	network_technology_state_t *entry = data;
+
+	g_free(entry->path);
+	g_free(entry->type);
+	g_free(entry->name);
+	g_free(entry);
+}
+
+static void profile_state_free(gpointer data)
+{
+	network_profile_state_t *entry = data;
+
+	g_free(entry->ssid);
+	g_strfreev(entry->security);
+	g_free(entry);
+}
+
+/**
+ * Copy a list of connman services, reusing the entries of the previous
+ * snapshot for services whose generation did not change
+ */
+
+static void copy_services(network_state_t *state, GSList *services, GPtrArray *array,
+				network_state_t *previous)
+{
+	GSList *iter;
+
+	for (iter = services; NULL != iter; iter = iter->next)
+	{
+		connman_service_t *service = (connman_service_t *)(iter->data);
+		network_service_state_t *entry = NULL;
+
+		if(NULL == service->path)
+			continue;
+
+		if(NULL != previous)
+			entry = g_hash_table_lookup(previous->services_by_path, service->path);
+
+		if(NULL != entry && entry->generation == service->generation)
+			g_atomic_int_inc(&entry->ref_count);
+		else
+			entry = network_service_state_new(service);
+
+		g_ptr_array_add(array, entry);
+		g_hash_table_insert(state->services_by_path, entry->path, entry);
+	}
+}
+
+static void copy_technologies(network_state_t *state)
+{
+	GSList *iter;
+
+	for (iter = manager->technologies; NULL != iter; iter = iter->next)
+	{
+		connman_technology_t *technology = (connman_technology_t *)(iter->data);
+		network_technology_state_t *entry = g_new0(network_technology_state_t, 1);
+
+		entry->path = g_strdup(technology->path);
+		entry->type = g_strdup(technology->type);
+		entry->name = g_strdup(technology->name);
+		entry->powered = technology->powered;
+		g_ptr_array_add(state->technologies, entry);
+	}
+}
+
+static void copy_profiles(network_state_t *state)
+{
+	wifi_profile_t *profile = get_next_profile(NULL);
+
+	while(NULL != profile)
+	{
+		network_profile_state_t *entry = g_new0(network_profile_state_t, 1);
+
+		entry->profile_id = profile->profile_id;
+		entry->ssid = g_strdup(profile->ssid);
+		entry->hidden = profile->hidden;
+		entry->security = g_strdupv(profile->security);
+		g_ptr_array_add(state->profiles, entry);
+
+		/* Keep the first, highest priority, profile for an ssid */
+		if(NULL == g_hash_table_lookup(state->profiles_by_ssid, entry->ssid))
+			g_hash_table_insert(state->profiles_by_ssid, entry->ssid, entry);
+
+		profile = get_next_profile(profile);
+	}
+}
+
+static network_state_t *build(network_state_t *previous)
+{
+	network_state_t *state = g_new0(network_state_t, 1);
+
+	state->ref_count = 1;
+	state->version = ++current_version;
+	state->wifi_services = g_ptr_array_new_with_free_func(network_service_state_unref);
+	state->wired_services = g_ptr_array_new_with_free_func(network_service_state_unref);
+	state->cellular_services = g_ptr_array_new_with_free_func(network_service_state_unref);
+	state->technologies = g_ptr_array_new_with_free_func(technology_state_free);
+	state->profiles = g_ptr_array_new_with_free_func(profile_state_free);
+	state->services_by_path = g_hash_table_new(g_str_hash, g_str_equal);
+	state->profiles_by_ssid = g_hash_table_new(g_str_hash, g_str_equal);
+
+	if(NULL != manager)
+	{
+		state->manager_state = g_strdup(manager->state);
+		state->offline = manager->offline;
+		copy_services(state, manager->wifi_services, state->wifi_services, previous);
+		copy_services(state, manager->wired_services, state->wired_services, previous);
+		copy_services(state, manager->cellular_services, state->cellular_services, previous);
+		copy_technologies(state);
+	}
+
+	copy_profiles(state);
+
+	gint iface;
+	for (iface = 0; iface < INTERFACE_FACTS_MAX; iface++)
+		state->links[iface] = *interface_facts_get(iface);
+
+	return state;
+}
+
+/**
+ * Build a new snapshot and swap it in. The previous one is released once
+ * no reader is in the middle of taking a reference to it.
+ */
+
+static void rebuild(void)
+{
+	g_atomic_int_set(&dirty, 0);
+
+	network_state_t *state = build(current);
+	network_state_t *old = __atomic_exchange_n(&current, state, __ATOMIC_SEQ_CST);
+
+	status_page_publish(state);
+
+	while(__atomic_load_n(&readers, __ATOMIC_SEQ_CST) > 0)
+		g_thread_yield();
+
+	if(NULL != old)
+		network_state_release(old);
+}
+
+static gboolean rebuild_cb(gpointer user_data)
+{
+	rebuild_source = 0;
+
+	if(g_atomic_int_get(&dirty))
+		rebuild();
+
+	return FALSE;
+}
+
+void network_state_init(void)
+{
+	publisher = g_thread_self();
+	rebuild();
+}
+
+network_state_t *network_state_acquire(void)
+{
+	network_state_t *state;
+
+	if(g_atomic_int_get(&dirty) && (NULL == publisher || g_thread_self() == publisher))
+		rebuild();
+
+	__atomic_add_fetch(&readers, 1, __ATOMIC_SEQ_CST);
+	state = __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+	g_atomic_int_inc(&state->ref_count);
+	__atomic_sub_fetch(&readers, 1, __ATOMIC_SEQ_CST);
+
+	return state;
+}
+
+void network_state_release(network_state_t *state)
+{
+	if(NULL == state || !g_atomic_int_dec_and_test(&state->ref_count))
+		return;
+
+	g_free(state->manager_state);
+	g_hash_table_destroy(state->services_by_path);
+	g_hash_table_destroy(state->profiles_by_ssid);
+	g_ptr_array_free(state->wifi_services, TRUE);
+	g_ptr_array_free(state->wired_services, TRUE);
+	g_ptr_array_free(state->cellular_services, TRUE);
+	g_ptr_array_free(state->technologies, TRUE);
+	g_ptr_array_free(state->profiles, TRUE);
+	g_free(state);
+}
+
+void network_state_invalidate(void)
+{
+	g_atomic_int_set(&dirty, 1);
+
+	if(0 == rebuild_source)
+		rebuild_source = g_idle_add_full(G_PRIORITY_HIGH_IDLE, rebuild_cb, NULL, NULL);
+}
+
+const network_profile_state_t *network_state_find_profile(const network_state_t *state, const gchar *ssid)
+{
+	if(NULL == state || NULL == ssid)
+		return NULL;
+
+	return g_hash_table_lookup(state->profiles_by_ssid, ssid);
+}
+
+const network_service_state_t *network_state_get_connected_service(const GPtrArray *services)
+{
+	guint i;
+
+	for (i = 0; i < services->len; i++)
+	{
+		const network_service_state_t *entry = g_ptr_array_index(services, i);
+		int service_state = connman_service_get_state(entry->state);
+
+		if(service_state == CONNMAN_SERVICE_STATE_ONLINE
+			|| service_state == CONNMAN_SERVICE_STATE_READY)
+			return entry;
+	}
+
+	return NULL;
+}
+
+const interface_facts_t *network_state_get_link(const network_state_t *state,
+				const network_service_state_t *service)
+{
+	gint iface;
+
+	for (iface = 0; NULL != service->iface && iface < INTERFACE_FACTS_MAX; iface++)
+	{
+		const interface_facts_t *link = &state->links[iface];
+		if(link->monitored && link->present && !g_strcmp0(link->name, service->iface))
+			return link;
+	}
+
+	return NULL;
+}
+
+gboolean network_state_get_effective_link(const network_state_t *state,
+				const network_service_state_t *service, network_service_ipv4_t *ipv4)
+{
+	int service_state = connman_service_get_state(service->state);
+	if(service_state != CONNMAN_SERVICE_STATE_ONLINE
+		&& service_state != CONNMAN_SERVICE_STATE_READY)
+		return FALSE;
+
+	const interface_facts_t *link = network_state_get_link(state, service);
+	if(NULL != link && !link->carrier)
+		return FALSE;
+
+	if(NULL == ipv4)
+		return TRUE;
+
+	if(NULL != link && link->ipv4_address[0] != '\0'
+		&& g_strcmp0(link->ipv4_address, service->ipv4_address))
+	{
+		struct in_addr netmask;
+
+		g_strlcpy(ipv4->address, link->ipv4_address, sizeof(ipv4->address));
+		netmask.s_addr = link->ipv4_prefixlen ? htonl(0xffffffffu << (32 - link->ipv4_prefixlen)) : 0;
+		inet_ntop(AF_INET, &netmask, ipv4->netmask, sizeof(ipv4->netmask));
+	}
+	else
+	{
+		g_strlcpy(ipv4->address, NULL != service->ipv4_address ? service->ipv4_address : "",
+				sizeof(ipv4->address));
+		g_strlcpy(ipv4->netmask, NULL != service->ipv4_netmask ? service->ipv4_netmask : "",
+				sizeof(ipv4->netmask));
+	}
+
+	return TRUE;
+}
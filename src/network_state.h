@@ -0,0 +1,189 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  network_state.h
+ *
+ * @brief Header file defining immutable, versioned snapshots of the
+ *        manager, technology, service and profile state
+ *
+ */
+
+
+#ifndef NETWORK_STATE_H_
+#define NETWORK_STATE_H_
+
+#include <glib.h>
+
+#include "connman_service.h"
+#include "interface_facts.h"
+
+/**
+ * Immutable copy of a connman service. Shared between consecutive
+ * snapshots as long as the service did not change.
+ */
+typedef struct network_service_state
+{
+	gint ref_count;
+	guint generation;	/* generation of the connman service it was copied from */
+	gchar *path;
+	gchar *name;
+	gchar *state;
+	gint type;
+	guchar strength;
+	GStrv security;
+	gboolean hidden;
+	gboolean favorite;
+	gboolean auto_connect;
+	gchar *iface;
+	gchar *ipv4_method;
+	gchar *ipv4_address;
+	gchar *ipv4_netmask;
+	gchar *ipv4_gateway;
+	GStrv nameservers;
+}network_service_state_t;
+
+/**
+ * Immutable copy of a connman technology
+ */
+typedef struct network_technology_state
+{
+	gchar *path;
+	gchar *type;
+	gchar *name;
+	gboolean powered;
+}network_technology_state_t;
+
+/**
+ * Immutable copy of a wifi profile
+ */
+typedef struct network_profile_state
+{
+	guint profile_id;
+	gchar *ssid;
+	gboolean hidden;
+	GStrv security;
+}network_profile_state_t;
+
+/**
+ * A consistent view of everything the luna handlers read. Never modified
+ * after it is published, so it can be read from any thread without locks.
+ */
+typedef struct network_state
+{
+	gint ref_count;
+	guint64 version;
+	gchar *manager_state;
+	gboolean offline;
+	GPtrArray *wifi_services;	/* network_service_state_t, in manager order */
+	GPtrArray *wired_services;
+	GPtrArray *cellular_services;
+	GPtrArray *technologies;	/* network_technology_state_t */
+	GPtrArray *profiles;		/* network_profile_state_t, in priority order */
+	GHashTable *services_by_path;
+	GHashTable *profiles_by_ssid;
+	interface_facts_t links[INTERFACE_FACTS_MAX];	/* indexed by INTERFACE_FACTS_* */
+}network_state_t;
+
+/**
+ * Record the calling thread as the one owning the manager, services and profiles
+ *
+ * Only that thread rebuilds snapshots. Until this is called any thread may.
+ */
+extern void network_state_init(void);
+
+/**
+ * Get a reference to the most recent snapshot
+ *
+ * On the owning thread a pending change is folded in first, so the
+ * snapshot is never older than the live objects. Other threads get the
+ * last published snapshot.
+ *
+ * @return Snapshot, release it with network_state_release()
+ */
+extern network_state_t *network_state_acquire(void);
+
+/**
+ * Drop a reference obtained from network_state_acquire()
+ */
+extern void network_state_release(network_state_t *state);
+
+/**
+ * Mark the published snapshot as stale and schedule a rebuild
+ *
+ * Cheap enough to call on every signal; consecutive calls coalesce into
+ * one rebuild.
+ */
+extern void network_state_invalidate(void);
+
+/**
+ * Look up the profile for the given ssid in a snapshot
+ *
+ * @return Profile or NULL
+ */
+extern const network_profile_state_t *network_state_find_profile(const network_state_t *state, const gchar *ssid);
+
+/**
+ * Get the first service of a snapshot list which is in "ready" or "online" state
+ *
+ * @return Service or NULL
+ */
+extern const network_service_state_t *network_state_get_connected_service(const GPtrArray *services);
+
+/**
+ * Get the link facts of the interface a service uses, when link
+ * notifications keep them current
+ *
+ * @return Link facts or NULL
+ */
+extern const interface_facts_t *network_state_get_link(const network_state_t *state,
+				const network_service_state_t *service);
+
+/**
+ * IPv4 settings of a connected service as they are reported
+ */
+typedef struct network_service_ipv4
+{
+	gchar address[INET_ADDRSTRLEN];	/* empty if not known */
+	gchar netmask[INET_ADDRSTRLEN];	/* empty if not known */
+}network_service_ipv4_t;
+
+/**
+ * Decide whether a service is reported as connected, and with which address
+ *
+ * The kernel sees carrier and address changes before connman does. A lost
+ * link is reported as disconnected right away, and the interface's address
+ * takes precedence over the one connman last reported. Whether the service
+ * is connected at all is still up to connman.
+ *
+ * @param[OUT] ipv4 Address to report, may be NULL
+ *
+ * @return TRUE if the service is reported as connected
+ */
+extern gboolean network_state_get_effective_link(const network_state_t *state,
+				const network_service_state_t *service, network_service_ipv4_t *ipv4);
+
+/**
+ * Copy a connman service, exposed for the micro-benchmarks
+ */
+extern network_service_state_t *network_service_state_new(connman_service_t *service);
+
+extern void network_service_state_unref(gpointer data);
+
+#endif /* NETWORK_STATE_H_ */
@@ -0,0 +1,122 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  offload.c
+ *
+ * @brief Runs serialization and encryption work on a thread pool
+ *
+ */
+
+#include <glib.h>
+
+#include "offload.h"
+#include "logging.h"
+
+typedef struct offload_job
+{
+	offload_work_func work;
+	offload_done_func done;
+	gpointer data;
+	gint priority;
+}offload_job_t;
+
+static GThreadPool *pool = NULL;
+static GMainContext *main_context = NULL;
+
+static gboolean job_done_cb(gpointer user_data)
+{
+	offload_job_t *job = user_data;
+
+	job->done(job->data);
+	g_free(job);
+
+	return FALSE;
+}
+
+static void job_run_cb(gpointer data, gpointer user_data)
+{
+	offload_job_t *job = data;
+
+	job->work(job->data);
+	g_main_context_invoke_full(main_context, job->priority, job_done_cb, job, NULL);
+}
+
+/**
+ * Create the worker threads (see header for API details)
+ */
+
+void offload_init(GMainContext *context)
+{
+	GError *error = NULL;
+
+	if(NULL != pool)
+		return;
+
+	main_context = context ? g_main_context_ref(context) : g_main_context_ref(g_main_context_default());
+
+	pool = g_thread_pool_new(job_run_cb, NULL, OFFLOAD_MAX_THREADS, FALSE, &error);
+	if(error)
+	{
+		WCA_LOG_ERROR("Could not create offload threads: %s", error->message);
+		g_error_free(error);
+		pool = NULL;
+	}
+}
+
+/**
+ * Queue work (see header for API details)
+ */
+
+void offload_run(offload_work_func work, offload_done_func done, gpointer data)
+{
+	offload_run_full(G_PRIORITY_DEFAULT, work, done, data);
+}
+
+/**
+ * Queue work with a priority for its completion (see header for API details)
+ */
+
+void offload_run_full(gint priority, offload_work_func work, offload_done_func done, gpointer data)
+{
+	GError *error = NULL;
+	offload_job_t *job;
+
+	if(NULL == pool)
+	{
+		work(data);
+		done(data);
+		return;
+	}
+
+	job = g_new0(offload_job_t, 1);
+	job->work = work;
+	job->done = done;
+	job->data = data;
+	job->priority = priority;
+
+	if(!g_thread_pool_push(pool, job, &error))
+	{
+		WCA_LOG_ERROR("Could not queue offload job: %s", error->message);
+		g_error_free(error);
+		g_free(job);
+		work(data);
+		done(data);
+	}
+}
@@ -0,0 +1,69 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  offload.h
+ *
+ * @brief Header file defining functions for running work on a thread pool
+ *
+ */
+
+
+#ifndef OFFLOAD_H_
+#define OFFLOAD_H_
+
+#include <glib.h>
+
+/**
+ * Number of worker threads
+ */
+#define OFFLOAD_MAX_THREADS	2
+
+/**
+ * Function run on a worker thread. It must only touch the data it is given.
+ */
+typedef void (*offload_work_func)(gpointer data);
+
+/**
+ * Function run on the main context once the work is done
+ */
+typedef void (*offload_done_func)(gpointer data);
+
+/**
+ * Create the worker threads
+ *
+ * Until this is called offload_run() does the work synchronously.
+ *
+ * @param[IN]  context Context the done functions are called on, NULL for the default one
+ */
+extern void offload_init(GMainContext *context);
+
+/**
+ * Run work on a worker thread, then call done with the same data on the main context
+ *
+ * Jobs may complete out of order.
+ */
+extern void offload_run(offload_work_func work, offload_done_func done, gpointer data);
+
+/**
+ * Same as offload_run(), calling done with the given GSource priority
+ */
+extern void offload_run_full(gint priority, offload_work_func work, offload_done_func done, gpointer data);
+
+#endif /* OFFLOAD_H_ */
@@ -0,0 +1,81 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  scheduler.c
+ *
+ * @brief Maps the kinds of work run on the main loop to GSource priorities
+ *
+ * Luna calls are dispatched ahead of connman signals, which in turn go
+ * ahead of subscription fan-out and periodic scans. Persisting settings
+ * comes last. Background work splits itself into time slices so it never
+ * holds the loop for more than SCHEDULER_SLICE_US at a time.
+ *
+ */
+
+#include <glib.h>
+
+#include "scheduler.h"
+
+static const gint priorities[SCHEDULER_CLASS_MAX] = {
+	[SCHEDULER_CLASS_INTERACTIVE] = G_PRIORITY_DEFAULT - 10,
+	[SCHEDULER_CLASS_SIGNAL] = G_PRIORITY_DEFAULT,
+	[SCHEDULER_CLASS_BACKGROUND] = G_PRIORITY_DEFAULT_IDLE,
+	[SCHEDULER_CLASS_PERSIST] = G_PRIORITY_LOW,
+};
+
+gint scheduler_priority(scheduler_class_t work_class)
+{
+	if(work_class >= SCHEDULER_CLASS_MAX)
+		return G_PRIORITY_DEFAULT;
+
+	return priorities[work_class];
+}
+
+static guint attach_source(GSource *source, scheduler_class_t work_class, GSourceFunc func,
+				gpointer data, GDestroyNotify notify)
+{
+	GMainContext *context = g_main_context_ref_thread_default();
+	guint id;
+
+	g_source_set_priority(source, scheduler_priority(work_class));
+	g_source_set_callback(source, func, data, notify);
+	id = g_source_attach(source, context);
+	g_source_unref(source);
+	g_main_context_unref(context);
+
+	return id;
+}
+
+guint scheduler_idle_add(scheduler_class_t work_class, GSourceFunc func, gpointer data,
+			GDestroyNotify notify)
+{
+	return attach_source(g_idle_source_new(), work_class, func, data, notify);
+}
+
+guint scheduler_timeout_add(scheduler_class_t work_class, guint interval, GSourceFunc func,
+			gpointer data, GDestroyNotify notify)
+{
+	return attach_source(g_timeout_source_new(interval), work_class, func, data, notify);
+}
+
+gboolean scheduler_slice_expired(gint64 start)
+{
+	return g_get_monotonic_time() - start >= SCHEDULER_SLICE_US;
+}
@@ -0,0 +1,84 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  scheduler.h
+ *
+ * @brief Header file defining the priorities of the different kinds of work
+ *        run on the main loop
+ *
+ */
+
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <glib.h>
+
+/**
+ * Kinds of work competing for the main loop, from most to least urgent
+ */
+typedef enum {
+	SCHEDULER_CLASS_INTERACTIVE,	/**< Luna method calls */
+	SCHEDULER_CLASS_SIGNAL,		/**< Connman signals and replies */
+	SCHEDULER_CLASS_BACKGROUND,	/**< Subscription fan-out and periodic scans */
+	SCHEDULER_CLASS_PERSIST,	/**< Storing settings and profiles */
+	SCHEDULER_CLASS_MAX,
+} scheduler_class_t;
+
+/**
+ * Longest time in microseconds a background task should keep the loop busy
+ * before giving it back
+ */
+#define SCHEDULER_SLICE_US	3000
+
+/**
+ * Number of subscribers replied to before the time slice is checked
+ */
+#define SCHEDULER_FANOUT_CHUNK	32
+
+/**
+ * GSource priority of a class
+ */
+extern gint scheduler_priority(scheduler_class_t work_class);
+
+/**
+ * Run func on the thread default context once nothing more urgent is pending
+ *
+ * func is called again for as long as it returns TRUE.
+ *
+ * @return Source id
+ */
+extern guint scheduler_idle_add(scheduler_class_t work_class, GSourceFunc func, gpointer data,
+				GDestroyNotify notify);
+
+/**
+ * Run func every interval milliseconds on the thread default context
+ *
+ * @return Source id
+ */
+extern guint scheduler_timeout_add(scheduler_class_t work_class, guint interval, GSourceFunc func,
+				gpointer data, GDestroyNotify notify);
+
+/**
+ * Check whether a background task started at start used up its time slice
+ */
+extern gboolean scheduler_slice_expired(gint64 start);
+
+#endif /* SCHEDULER_H_ */
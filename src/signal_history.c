@@ -0,0 +1,131 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  signal_history.c
+ *
+ * @brief Keeps the recent strength readings of a service in a ring and
+ *        summarizes them into min/avg/max buckets
+ *
+ */
+
+#include <glib.h>
+
+#include "signal_history.h"
+
+signal_history_t *signal_history_new(void)
+{
+	return g_new0(signal_history_t, 1);
+}
+
+void signal_history_free(signal_history_t *history)
+{
+	g_free(history);
+}
+
+void signal_history_add(signal_history_t *history, gint64 now, guchar strength)
+{
+	if(NULL == history)
+		return;
+
+	history->time[history->head] = (guint32) (now / SIGNAL_HISTORY_TICK);
+	history->strength[history->head] = strength;
+	history->head = (history->head + 1) % SIGNAL_HISTORY_SIZE;
+	if(history->count < SIGNAL_HISTORY_SIZE)
+		history->count++;
+}
+
+/**
+ * Index of the i-th oldest reading
+ */
+
+static guint slot(const signal_history_t *history, guint i)
+{
+	return (history->head + SIGNAL_HISTORY_SIZE - history->count + i) % SIGNAL_HISTORY_SIZE;
+}
+
+static gint64 sample_time(const signal_history_t *history, guint i)
+{
+	return (gint64) history->time[slot(history, i)] * SIGNAL_HISTORY_TICK;
+}
+
+guint signal_history_downsample(const signal_history_t *history, gint64 start, gint64 end,
+				gint64 resolution, signal_bucket_t *buckets, guint max_buckets)
+{
+	guint filled = 0, i = 0;
+	gboolean have = FALSE;
+	guchar value = 0;
+	gint64 bucket_start;
+
+	if(NULL == history || resolution <= 0 || end <= start)
+		return 0;
+
+	/* Strength in effect when the range starts */
+	while(i < history->count && sample_time(history, i) <= start)
+	{
+		value = history->strength[slot(history, i)];
+		have = TRUE;
+		i++;
+	}
+
+	for (bucket_start = start; bucket_start < end && filled < max_buckets; bucket_start += resolution)
+	{
+		gint64 bucket_end = MIN(bucket_start + resolution, end);
+		gint64 cursor = bucket_start, covered = 0;
+		gdouble integral = 0;
+		signal_bucket_t *bucket = &buckets[filled];
+
+		bucket->start = bucket_start;
+		bucket->samples = 0;
+		bucket->min = bucket->max = value;
+
+		while(i < history->count && sample_time(history, i) < bucket_end)
+		{
+			gint64 time = sample_time(history, i);
+
+			if(have)
+			{
+				integral += (gdouble) value * (time - cursor);
+				covered += time - cursor;
+			}
+
+			value = history->strength[slot(history, i)];
+			if(!have || value < bucket->min)
+				bucket->min = value;
+			if(!have || value > bucket->max)
+				bucket->max = value;
+			have = TRUE;
+			cursor = time;
+			bucket->samples++;
+			i++;
+		}
+
+		if(!have)
+			continue;
+
+		integral += (gdouble) value * (bucket_end - cursor);
+		covered += bucket_end - cursor;
+
+		/* A reading right at the end of the bucket leaves no time to weigh it */
+		bucket->avg = covered > 0 ? integral / covered : value;
+		filled++;
+	}
+
+	return filled;
+}
@@ -0,0 +1,94 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  signal_history.h
+ *
+ * @brief Header file defining the fixed size history of a service's signal strength
+ *
+ */
+
+
+#ifndef SIGNAL_HISTORY_H_
+#define SIGNAL_HISTORY_H_
+
+#include <glib.h>
+
+/**
+ * Number of strength readings kept per service
+ */
+#define SIGNAL_HISTORY_SIZE	512
+
+/**
+ * Resolution of the stored timestamps in microseconds
+ */
+#define SIGNAL_HISTORY_TICK	100000
+
+/**
+ * Ring of strength readings, oldest first from head - count. Times and
+ * strengths are kept in separate arrays so a reading takes five bytes.
+ */
+typedef struct signal_history
+{
+	guint head;		/* next slot to write */
+	guint count;
+	guint32 time[SIGNAL_HISTORY_SIZE];	/* monotonic time in SIGNAL_HISTORY_TICK units */
+	guchar strength[SIGNAL_HISTORY_SIZE];
+}signal_history_t;
+
+/**
+ * Summary of the strength over one bucket of time
+ */
+typedef struct signal_bucket
+{
+	gint64 start;		/* monotonic time in microseconds */
+	guchar min;
+	guchar max;
+	gdouble avg;		/* weighted by how long each strength lasted */
+	guint samples;		/* readings received within the bucket */
+}signal_bucket_t;
+
+extern signal_history_t *signal_history_new(void);
+
+extern void signal_history_free(signal_history_t *history);
+
+/**
+ * Record a strength reading
+ *
+ * @param[IN]  now Monotonic time in microseconds
+ */
+extern void signal_history_add(signal_history_t *history, gint64 now, guchar strength);
+
+/**
+ * Summarize the history between start and end in buckets of resolution
+ *
+ * connman only reports the strength when it changes, so a reading holds
+ * until the next one. Buckets before the first reading are skipped.
+ *
+ * @param[IN]  start Monotonic time in microseconds
+ * @param[IN]  end Monotonic time in microseconds
+ * @param[IN]  resolution Bucket width in microseconds
+ * @param[OUT] buckets Array of at least max_buckets elements
+ *
+ * @return Number of buckets filled in
+ */
+extern guint signal_history_downsample(const signal_history_t *history, gint64 start, gint64 end,
+				gint64 resolution, signal_bucket_t *buckets, guint max_buckets);
+
+#endif /* SIGNAL_HISTORY_H_ */
@@ -0,0 +1,170 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  status_journal.c
+ *
+ * @brief Keeps the last getstatus changes in a ring, numbered in sequence
+ *
+ * Each change holds the serialized top level fields of the getstatus
+ * payload which differ from the previous payload. A subscriber coming back
+ * with the last sequence number it saw gets just those changes, unless
+ * the ring wrapped since.
+ *
+ * Sequence numbers restart with the adapter, so each run has its own epoch
+ * id and a sequence number only means something along with its epoch.
+ *
+ */
+
+#include <glib.h>
+#include <pbnjson.h>
+
+#include "status_journal.h"
+#include "logging.h"
+
+static const char *tracked_keys[] = {
+	"isInternetConnectionAvailable",
+	"offlineMode",
+	"wired",
+	"wifi",
+	"cellular",
+};
+
+#define TRACKED_KEYS	G_N_ELEMENTS(tracked_keys)
+
+typedef struct journal_entry
+{
+	gint64 seq;
+	gchar *changes;		/* JSON object of the changed fields */
+} journal_entry_t;
+
+static journal_entry_t entries[STATUS_JOURNAL_SIZE];
+static guint head = 0;		/* next slot to write */
+static guint count = 0;
+static gint64 latest = 0;
+static gchar epoch[17];
+
+/* Serialized value of each tracked field in the previous payload */
+static gchar *last_values[TRACKED_KEYS];
+
+const gchar *status_journal_epoch(void)
+{
+	if('\0' == epoch[0])
+		g_snprintf(epoch, sizeof(epoch), "%08x%08x", g_random_int(), g_random_int());
+
+	return epoch;
+}
+
+gint64 status_journal_seq(void)
+{
+	return latest;
+}
+
+gint64 status_journal_record(jvalue_ref status)
+{
+	GString *changes = NULL;
+	guint i;
+
+	jschema_ref schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!schema)
+		return latest;
+
+	for (i = 0; i < TRACKED_KEYS; i++)
+	{
+		jvalue_ref value = {0};
+
+		if(!jobject_get_exists(status, j_cstr_to_buffer(tracked_keys[i]), &value))
+			continue;
+
+		const char *text = jvalue_tostring(value, schema);
+		if(NULL == text || !g_strcmp0(text, last_values[i]))
+			continue;
+
+		g_free(last_values[i]);
+		last_values[i] = g_strdup(text);
+
+		if(NULL == changes)
+			changes = g_string_new("{");
+		else
+			g_string_append_c(changes, ',');
+		g_string_append_printf(changes, "\"%s\":%s", tracked_keys[i], text);
+	}
+
+	jschema_release(&schema);
+
+	if(NULL == changes)
+		return latest;
+
+	g_string_append_c(changes, '}');
+
+	journal_entry_t *entry = &entries[head];
+	g_free(entry->changes);
+	entry->seq = ++latest;
+	entry->changes = g_string_free(changes, FALSE);
+
+	head = (head + 1) % STATUS_JOURNAL_SIZE;
+	if(count < STATUS_JOURNAL_SIZE)
+		count++;
+
+	return latest;
+}
+
+jvalue_ref status_journal_changes_since(gint64 since)
+{
+	guint i;
+
+	/* From the future */
+	if(since > latest)
+		return NULL;
+
+	guint first = (head + STATUS_JOURNAL_SIZE - count) % STATUS_JOURNAL_SIZE;
+	gint64 oldest = count > 0 ? entries[first].seq : latest + 1;
+	if(since < latest && since + 1 < oldest)
+		return NULL;
+
+	jschema_ref schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!schema)
+		return NULL;
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, schema, NULL, NULL); // no external refs & no error handlers
+
+	jvalue_ref array = jarray_create(NULL);
+	for (i = 0; i < count; i++)
+	{
+		journal_entry_t *entry = &entries[(first + i) % STATUS_JOURNAL_SIZE];
+		if(entry->seq <= since)
+			continue;
+
+		jvalue_ref change = jdom_parse(j_cstr_to_buffer(entry->changes), DOMOPT_NOOPT, &schemaInfo);
+		if(jis_null(change))
+		{
+			WCA_LOG_ERROR("Could not parse journaled change %lld", (long long) entry->seq);
+			j_release(&array);
+			array = NULL;
+			break;
+		}
+
+		jobject_put(change, J_CSTR_TO_JVAL("seq"), jnumber_create_i64(entry->seq));
+		jarray_append(array, change);
+	}
+
+	jschema_release(&schema);
+	return array;
+}
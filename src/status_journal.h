@@ -0,0 +1,76 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  status_journal.h
+ *
+ * @brief Header file defining the journal of getstatus changes, which lets
+ *        subscribers catch up on what they missed
+ *
+ */
+
+
+#ifndef STATUS_JOURNAL_H_
+#define STATUS_JOURNAL_H_
+
+#include <glib.h>
+#include <pbnjson.h>
+
+/**
+ * Number of changes kept
+ */
+#define STATUS_JOURNAL_SIZE	64
+
+/**
+ * Record a getstatus payload, journaling the top level fields which changed
+ * since the previous one
+ *
+ * Only called from the context posting getstatus, like the other functions.
+ *
+ * @param[IN]  status getstatus payload
+ *
+ * @return Sequence number of the latest change
+ */
+extern gint64 status_journal_record(jvalue_ref status);
+
+/**
+ * Get the id of this run of the adapter
+ *
+ * Sequence numbers start over on every run, so they can only be compared
+ * when they come with the same epoch id.
+ */
+extern const gchar *status_journal_epoch(void);
+
+/**
+ * Get the sequence number of the latest change
+ */
+extern gint64 status_journal_seq(void);
+
+/**
+ * Get the changes after a sequence number
+ *
+ * @param[IN]  since Sequence number the caller is up to date with
+ *
+ * @return Array of change objects oldest first, each holding "seq" and
+ *         the fields which changed, or NULL if changes after since are no
+ *         longer in the journal
+ */
+extern jvalue_ref status_journal_changes_since(gint64 since);
+
+#endif /* STATUS_JOURNAL_H_ */
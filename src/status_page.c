@@ -0,0 +1,188 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  status_page.c
+ *
+ * @brief Publishes the getstatus information as a binary record in shared
+ *        memory, so local processes can read it without a luna call
+ *
+ * The record is rewritten whenever a new snapshot differs from it. The
+ * sequence number is made odd before and even after the update, and the
+ * file's timestamps are touched afterwards so readers can wait with inotify.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <glib.h>
+
+#include "status_page.h"
+#include "connman_status_page.h"
+#include "logging.h"
+
+static int page_fd = -1;
+static connman_status_page_t *page = NULL;
+
+/* Everything from online on is compared and copied on publish */
+#define STATUS_OFFSET	offsetof(connman_status_page_t, online)
+#define STATUS_SIZE	(sizeof(connman_status_page_t) - STATUS_OFFSET)
+
+/**
+ * Check that an existing page was left by the adapter, and not planted in
+ * the world writable /dev/shm by someone else
+ */
+
+static gboolean page_is_trusted(int fd)
+{
+	struct stat st;
+
+	if(fstat(fd, &st) < 0)
+		return FALSE;
+
+	return S_ISREG(st.st_mode) && st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+gboolean status_page_init(void)
+{
+	if(NULL != page)
+		return TRUE;
+
+	page_fd = shm_open(CONNMAN_STATUS_PAGE_NAME, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(page_fd >= 0 && !page_is_trusted(page_fd))
+	{
+		WCA_LOG_WARNING("Status page is not owned by the adapter, creating it again");
+		close(page_fd);
+		shm_unlink(CONNMAN_STATUS_PAGE_NAME);
+		page_fd = shm_open(CONNMAN_STATUS_PAGE_NAME, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	}
+	if(page_fd < 0)
+	{
+		WCA_LOG_ERROR("Could not open status page: %s", strerror(errno));
+		return FALSE;
+	}
+
+	/* Readable by everyone, only the adapter writes, whatever the umask */
+	if(fchmod(page_fd, 0644) < 0)
+		goto error;
+
+	/* Keeping the file across restarts keeps the readers' mappings valid */
+	if(ftruncate(page_fd, sizeof(connman_status_page_t)) < 0)
+		goto error;
+
+	page = mmap(NULL, sizeof(connman_status_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, page_fd, 0);
+	if(MAP_FAILED == page)
+	{
+		page = NULL;
+		goto error;
+	}
+
+	guint32 sequence = page->magic == CONNMAN_STATUS_PAGE_MAGIC ? page->sequence : 0;
+
+	__atomic_store_n(&page->sequence, sequence | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	page->magic = CONNMAN_STATUS_PAGE_MAGIC;
+	page->version = CONNMAN_STATUS_PAGE_VERSION;
+	page->size = sizeof(connman_status_page_t);
+	memset((guchar *) page + STATUS_OFFSET, 0, STATUS_SIZE);
+	__atomic_store_n(&page->sequence, (sequence | 1) + 1, __ATOMIC_RELEASE);
+
+	return TRUE;
+
+error:
+	WCA_LOG_ERROR("Could not set up status page: %s", strerror(errno));
+	close(page_fd);
+	page_fd = -1;
+	return FALSE;
+}
+
+static guint32 parse_address(const gchar *address)
+{
+	struct in_addr addr;
+
+	if(NULL == address || inet_pton(AF_INET, address, &addr) != 1)
+		return 0;
+
+	return addr.s_addr;
+}
+
+/**
+ * Fill in a technology the way getstatus reports it
+ */
+
+static void fill_link(const network_state_t *state, const GPtrArray *services, connman_status_page_link_t *entry)
+{
+	network_service_ipv4_t ipv4;
+
+	const network_service_state_t *service = network_state_get_connected_service(services);
+	if(NULL == service || !network_state_get_effective_link(state, service, &ipv4))
+		return;
+
+	entry->state = CONNMAN_STATUS_PAGE_CONNECTED;
+	entry->on_internet = connman_service_get_state(service->state) == CONNMAN_SERVICE_STATE_ONLINE;
+	if(service->type == CONNMAN_SERVICE_TYPE_WIFI)
+	{
+		entry->strength = service->strength;
+		if(NULL != service->name)
+			g_strlcpy(entry->ssid, service->name, sizeof(entry->ssid));
+	}
+	if(NULL != service->iface)
+		g_strlcpy(entry->interface_name, service->iface, sizeof(entry->interface_name));
+
+	entry->ipv4_address = parse_address(ipv4.address);
+	entry->ipv4_netmask = parse_address(ipv4.netmask);
+	entry->ipv4_gateway = parse_address(service->ipv4_gateway);
+}
+
+void status_page_publish(const network_state_t *state)
+{
+	connman_status_page_t record;
+
+	if(NULL == page || NULL == state)
+		return;
+
+	memset(&record, 0, sizeof(record));
+	record.online = !g_strcmp0(state->manager_state, "online");
+	record.offline_mode = state->offline;
+	fill_link(state, state->wired_services, &record.links[CONNMAN_STATUS_PAGE_WIRED]);
+	fill_link(state, state->wifi_services, &record.links[CONNMAN_STATUS_PAGE_WIFI]);
+	fill_link(state, state->cellular_services, &record.links[CONNMAN_STATUS_PAGE_CELLULAR]);
+
+	/* Most snapshots change nothing readers see */
+	if(!memcmp((guchar *) page + STATUS_OFFSET, (guchar *) &record + STATUS_OFFSET, STATUS_SIZE))
+		return;
+
+	guint32 sequence = page->sequence;
+	__atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	page->updated = g_get_real_time() / 1000;
+	memcpy((guchar *) page + STATUS_OFFSET, (guchar *) &record + STATUS_OFFSET, STATUS_SIZE);
+
+	__atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+	if(futimens(page_fd, NULL) < 0)
+		WCA_LOG_DEBUG("Could not touch status page: %s", strerror(errno));
+}
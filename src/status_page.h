@@ -0,0 +1,53 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  status_page.h
+ *
+ * @brief Header file defining the writer of the network status page in
+ *        shared memory (see connman_status_page.h for the layout)
+ *
+ */
+
+
+#ifndef STATUS_PAGE_H_
+#define STATUS_PAGE_H_
+
+#include <glib.h>
+
+#include "network_state.h"
+
+/**
+ * Create or reopen the status page
+ *
+ * @return FALSE if the page could not be created, status is then only
+ *         available through luna
+ */
+extern gboolean status_page_init(void);
+
+/**
+ * Write the status in a snapshot to the page if it differs from the
+ * published one, and signal readers
+ *
+ * Must only be called from the thread publishing snapshots. Does nothing
+ * before status_page_init().
+ */
+extern void status_page_publish(const network_state_t *state);
+
+#endif /* STATUS_PAGE_H_ */
@@ -0,0 +1,142 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  technology_registry.c
+ *
+ * @brief Keeps the technology of each type and the observers interested in it
+ *
+ * The manager reports the technology it holds for each type here. Observers
+ * register by type, independently of the manager's lifetime, and get the
+ * property changes of whatever technology of that type currently exists.
+ *
+ */
+
+#include <glib.h>
+
+#include "technology_registry.h"
+#include "logging.h"
+
+typedef struct technology_observer
+{
+	connman_property_changed_cb property_changed;
+	technology_presence_cb presence;
+} technology_observer_t;
+
+typedef struct technology_entry
+{
+	connman_technology_t *technology;
+	GSList *observers;	/* technology_observer_t */
+} technology_entry_t;
+
+/* Indexed by technology type_id */
+static technology_entry_t entries[CONNMAN_TECHNOLOGY_TYPE_MAX];
+
+static gboolean valid_type(gint type)
+{
+	return type > CONNMAN_TECHNOLOGY_TYPE_UNKNOWN && type < CONNMAN_TECHNOLOGY_TYPE_MAX;
+}
+
+static void notify_presence(technology_entry_t *entry, connman_technology_t *technology, gboolean present)
+{
+	GSList *iter;
+
+	for (iter = entry->observers; NULL != iter; iter = iter->next)
+	{
+		technology_observer_t *observer = iter->data;
+
+		if(NULL != observer->presence)
+			observer->presence(technology, present);
+	}
+}
+
+/**
+ * Registered as the property changed callback of every technology with a type
+ */
+
+static void property_changed_cb(gpointer data, const gchar *property, GVariant *value)
+{
+	connman_technology_t *technology = (connman_technology_t *)data;
+	GSList *iter;
+
+	technology_entry_t *entry = &entries[technology->type_id];
+	if(entry->technology != technology)
+		return;
+
+	for (iter = entry->observers; NULL != iter; iter = iter->next)
+	{
+		technology_observer_t *observer = iter->data;
+
+		if(NULL != observer->property_changed)
+			observer->property_changed(data, property, value);
+	}
+}
+
+void technology_registry_add_observer(gint type, connman_property_changed_cb property_changed,
+				technology_presence_cb presence)
+{
+	if(!valid_type(type))
+		return;
+
+	technology_observer_t *observer = g_new0(technology_observer_t, 1);
+	observer->property_changed = property_changed;
+	observer->presence = presence;
+
+	technology_entry_t *entry = &entries[type];
+	entry->observers = g_slist_append(entry->observers, observer);
+}
+
+void technology_registry_technology_added(connman_technology_t *technology)
+{
+	if(NULL == technology || !valid_type(technology->type_id))
+		return;
+
+	technology_entry_t *entry = &entries[technology->type_id];
+	if(entry->technology == technology)
+		return;
+
+	WCA_LOG_DEBUG("Technology %s registered as %s", technology->path, technology->type);
+
+	entry->technology = technology;
+	connman_technology_register_property_changed_cb(technology, property_changed_cb);
+	notify_presence(entry, technology, TRUE);
+}
+
+void technology_registry_technology_removed(connman_technology_t *technology)
+{
+	if(NULL == technology || !valid_type(technology->type_id))
+		return;
+
+	technology_entry_t *entry = &entries[technology->type_id];
+	if(entry->technology != technology)
+		return;
+
+	WCA_LOG_DEBUG("Technology %s unregistered", technology->path);
+
+	entry->technology = NULL;
+	notify_presence(entry, technology, FALSE);
+}
+
+connman_technology_t *technology_registry_lookup(gint type)
+{
+	if(!valid_type(type))
+		return NULL;
+
+	return entries[type].technology;
+}
@@ -0,0 +1,72 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  technology_registry.h
+ *
+ * @brief Header file defining the registry of connman technologies by type,
+ *        and of the observers interested in them
+ *
+ */
+
+
+#ifndef TECHNOLOGY_REGISTRY_H_
+#define TECHNOLOGY_REGISTRY_H_
+
+#include <glib.h>
+
+#include "connman_technology.h"
+
+/**
+ * Called when a technology of the observed type appears or goes away
+ */
+typedef void (*technology_presence_cb)(connman_technology_t *technology, gboolean present);
+
+/**
+ * Observe the technology of the given type, whether it exists yet or not
+ *
+ * The observer stays registered across the technology, or connman itself,
+ * going away and coming back. Observers registered for a type are called
+ * in registration order.
+ *
+ * @param[IN]  type One of the CONNMAN_TECHNOLOGY_TYPE_* values
+ * @param[IN]  property_changed Called for every "PropertyChanged" signal of the technology, may be NULL
+ * @param[IN]  presence Called when the technology is added or removed, may be NULL
+ */
+extern void technology_registry_add_observer(gint type, connman_property_changed_cb property_changed,
+				technology_presence_cb presence);
+
+/**
+ * Record a technology connman added and attach the observers of its type
+ */
+extern void technology_registry_technology_added(connman_technology_t *technology);
+
+/**
+ * Detach the observers from a technology about to be freed
+ */
+extern void technology_registry_technology_removed(connman_technology_t *technology);
+
+/**
+ * Get the technology of the given type
+ *
+ * @return Technology or NULL if connman has none of that type
+ */
+extern connman_technology_t *technology_registry_lookup(gint type);
+
+#endif /* TECHNOLOGY_REGISTRY_H_ */
@@ -0,0 +1,146 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  watchdog.c
+ *
+ * @brief Detects stalls of the main loop and the handler causing them
+ *
+ */
+
+#include <glib.h>
+
+#include "watchdog.h"
+#include "metrics.h"
+#include "logging.h"
+
+/* Shortest heartbeat interval in milliseconds */
+#define WATCHDOG_MIN_INTERVAL	10
+
+static GThread *watchdog_thread = NULL;
+static GThread *main_thread = NULL;
+static guint heartbeat_source = 0;
+static guint threshold_us = 0;
+static guint interval_ms = 0;
+static gint stop_requested = 0;
+
+/* Shared between the main loop and the watchdog thread */
+static gint64 last_heartbeat = 0;
+static const gchar *current_activity = NULL;
+static const gchar *stall_culprit = NULL;
+
+const gchar *watchdog_enter(const gchar *activity)
+{
+	if(NULL != main_thread && g_thread_self() != main_thread)
+		return NULL;
+
+	const gchar *previous = g_atomic_pointer_get(&current_activity);
+	g_atomic_pointer_set(&current_activity, activity);
+	return previous;
+}
+
+void watchdog_leave(const gchar *previous)
+{
+	if(NULL != main_thread && g_thread_self() != main_thread)
+		return;
+
+	g_atomic_pointer_set(&current_activity, previous);
+}
+
+/**
+ * Heartbeat on the main context, also accounting a stall once it is over
+ */
+
+static gboolean heartbeat_cb(gpointer user_data)
+{
+	gint64 now = g_get_monotonic_time();
+	gint64 gap = now - __atomic_exchange_n(&last_heartbeat, now, __ATOMIC_SEQ_CST);
+	const gchar *culprit = g_atomic_pointer_get(&stall_culprit);
+
+	if(NULL != culprit)
+	{
+		WCA_LOG_WARNING("Main loop was stalled for %" G_GINT64_FORMAT " ms in %s",
+				gap / 1000, culprit);
+		metrics_record(metrics_lookup(METRICS_GROUP_STALL, culprit), gap / 1000, FALSE);
+		g_atomic_pointer_set(&stall_culprit, NULL);
+	}
+
+	return TRUE;
+}
+
+static gpointer watchdog_thread_func(gpointer data)
+{
+	while (!g_atomic_int_get(&stop_requested))
+	{
+		g_usleep(interval_ms * 1000);
+
+		gint64 late = g_get_monotonic_time() - __atomic_load_n(&last_heartbeat, __ATOMIC_SEQ_CST);
+		if(late <= threshold_us || NULL != g_atomic_pointer_get(&stall_culprit))
+			continue;
+
+		/* report each stall only once, while it is still going on */
+		const gchar *culprit = g_atomic_pointer_get(&current_activity);
+		if(NULL == culprit)
+			culprit = "unknown";
+		g_atomic_pointer_set(&stall_culprit, culprit);
+
+		WCA_LOG_WARNING("Main loop stalled for more than %" G_GINT64_FORMAT " ms, currently in %s",
+				late / 1000, culprit);
+	}
+
+	return NULL;
+}
+
+/**
+ * Start watching the main context (see header for API details)
+ */
+
+void watchdog_start(guint threshold_ms)
+{
+	if(0 == threshold_ms || NULL != watchdog_thread)
+		return;
+
+	main_thread = g_thread_self();
+	threshold_us = threshold_ms * 1000;
+	interval_ms = MAX(threshold_ms / 4, WATCHDOG_MIN_INTERVAL);
+	g_atomic_int_set(&stop_requested, 0);
+	__atomic_store_n(&last_heartbeat, g_get_monotonic_time(), __ATOMIC_SEQ_CST);
+
+	heartbeat_source = g_timeout_add(interval_ms, heartbeat_cb, NULL);
+	watchdog_thread = g_thread_new("watchdog", watchdog_thread_func, NULL);
+
+	WCA_LOG_INFO("Main loop watchdog started with a threshold of %u ms", threshold_ms);
+}
+
+/**
+ * Stop the watchdog (see header for API details)
+ */
+
+void watchdog_stop(void)
+{
+	if(NULL == watchdog_thread)
+		return;
+
+	g_atomic_int_set(&stop_requested, 1);
+	g_thread_join(watchdog_thread);
+	watchdog_thread = NULL;
+
+	g_source_remove(heartbeat_source);
+	heartbeat_source = 0;
+}
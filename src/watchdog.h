@@ -0,0 +1,72 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  watchdog.h
+ *
+ * @brief Header file defining the main loop stall watchdog
+ *
+ */
+
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <glib.h>
+
+/**
+ * Default stall threshold in milliseconds
+ */
+#define WATCHDOG_DEFAULT_THRESHOLD	1000
+
+/**
+ * Start watching the default main context
+ *
+ * A heartbeat source on the main context is checked from a separate
+ * thread. Whenever the heartbeat is late by more than the threshold the
+ * activity currently marked with watchdog_enter() is logged, and once the
+ * main loop runs again the stall duration is recorded in the metrics
+ * registry under that activity.
+ *
+ * @param[IN]  threshold_ms Stall threshold, 0 disables the watchdog
+ */
+extern void watchdog_start(guint threshold_ms);
+
+/**
+ * Stop the watchdog thread
+ */
+extern void watchdog_stop(void);
+
+/**
+ * Mark the start of an activity on the main loop
+ *
+ * Once the watchdog is started, calls from other threads are ignored.
+ *
+ * @param[IN]  activity Name of the handler, must stay valid for the lifetime of the process
+ *
+ * @return The previous activity, to be passed to watchdog_leave()
+ */
+extern const gchar *watchdog_enter(const gchar *activity);
+
+/**
+ * Mark the end of an activity, restoring the one returned by watchdog_enter()
+ */
+extern void watchdog_leave(const gchar *previous);
+
+#endif /* WATCHDOG_H_ */
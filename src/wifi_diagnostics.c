@@ -0,0 +1,259 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  wifi_diagnostics.c
+ *
+ * @brief Keeps the timeline of recent wifi connect attempts
+ *
+ */
+
+#include <string.h>
+
+#include "wifi_diagnostics.h"
+#include "connman_service.h"
+#include "logging.h"
+
+typedef enum {
+	WIFI_CONNECT_RESULT_PENDING = 0,
+	WIFI_CONNECT_RESULT_CONNECTED,
+	WIFI_CONNECT_RESULT_FAILED,
+	WIFI_CONNECT_RESULT_SUPERSEDED
+} wifi_connect_result_t;
+
+static const char *result_names[] = {
+	"pending",
+	"connected",
+	"failed",
+	"superseded",
+};
+
+static const char *event_names[WIFI_CONNECT_EVENT_COUNT] = {
+	"disconnected",
+	"connectCalled",
+	"agentRequest",
+	"agentReply",
+	"association",
+	"configuration",
+	"ready",
+	"online",
+	"failure",
+	"connectReply",
+};
+
+typedef struct wifi_connect_attempt
+{
+	gchar *ssid;
+	gconstpointer service;
+	gint64 start_time;				/* wall clock, microseconds */
+	gint64 start;					/* monotonic, microseconds */
+	gint64 events[WIFI_CONNECT_EVENT_COUNT];	/* offset from start, -1 if not seen */
+	wifi_connect_result_t result;
+	gboolean finished;
+}wifi_connect_attempt_t;
+
+static wifi_connect_attempt_t attempts[WIFI_DIAGNOSTICS_MAX_ATTEMPTS];
+static guint attempt_count = 0;
+
+static wifi_connect_attempt_t *current_attempt(void)
+{
+	wifi_connect_attempt_t *attempt;
+
+	if(0 == attempt_count)
+		return NULL;
+
+	attempt = &attempts[(attempt_count - 1) % WIFI_DIAGNOSTICS_MAX_ATTEMPTS];
+	return attempt->finished ? NULL : attempt;
+}
+
+/**
+ * Start a new attempt (see header for API details)
+ */
+
+void wifi_diagnostics_connect_started(const gchar *ssid, gconstpointer service)
+{
+	wifi_connect_attempt_t *attempt = current_attempt();
+	guint i;
+
+	if(NULL != attempt)
+	{
+		if(WIFI_CONNECT_RESULT_PENDING == attempt->result)
+			attempt->result = WIFI_CONNECT_RESULT_SUPERSEDED;
+		attempt->finished = TRUE;
+	}
+
+	attempt = &attempts[attempt_count++ % WIFI_DIAGNOSTICS_MAX_ATTEMPTS];
+	g_free(attempt->ssid);
+	memset(attempt, 0, sizeof(*attempt));
+
+	attempt->ssid = g_strdup(ssid);
+	attempt->service = service;
+	attempt->start_time = g_get_real_time();
+	attempt->start = g_get_monotonic_time();
+	for (i = 0; i < WIFI_CONNECT_EVENT_COUNT; i++)
+		attempt->events[i] = -1;
+}
+
+/**
+ * Record an event (see header for API details)
+ */
+
+void wifi_diagnostics_event(wifi_connect_event_t event)
+{
+	wifi_connect_attempt_t *attempt = current_attempt();
+
+	if(NULL == attempt || event >= WIFI_CONNECT_EVENT_COUNT || attempt->events[event] >= 0)
+		return;
+
+	attempt->events[event] = g_get_monotonic_time() - attempt->start;
+}
+
+/**
+ * Record a service state change (see header for API details)
+ */
+
+void wifi_diagnostics_state_changed(gconstpointer service, int state)
+{
+	wifi_connect_attempt_t *attempt = current_attempt();
+
+	if(NULL == attempt || attempt->service != service)
+		return;
+
+	switch(state)
+	{
+		case CONNMAN_SERVICE_STATE_ASSOCIATION:
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_ASSOCIATION);
+			break;
+		case CONNMAN_SERVICE_STATE_CONFIGURATION:
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_CONFIGURATION);
+			break;
+		case CONNMAN_SERVICE_STATE_READY:
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_READY);
+			attempt->result = WIFI_CONNECT_RESULT_CONNECTED;
+			break;
+		case CONNMAN_SERVICE_STATE_ONLINE:
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_READY);
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_ONLINE);
+			attempt->result = WIFI_CONNECT_RESULT_CONNECTED;
+			attempt->finished = TRUE;
+			break;
+		case CONNMAN_SERVICE_STATE_FAILURE:
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_FAILURE);
+			attempt->result = WIFI_CONNECT_RESULT_FAILED;
+			attempt->finished = TRUE;
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * Record the Connect reply (see header for API details)
+ */
+
+void wifi_diagnostics_connect_replied(gboolean success)
+{
+	wifi_connect_attempt_t *attempt = current_attempt();
+
+	if(NULL == attempt)
+		return;
+
+	wifi_diagnostics_event(WIFI_CONNECT_EVENT_CONNECT_REPLY);
+	if(success)
+	{
+		attempt->result = WIFI_CONNECT_RESULT_CONNECTED;
+	}
+	else
+	{
+		attempt->result = WIFI_CONNECT_RESULT_FAILED;
+		attempt->finished = TRUE;
+	}
+}
+
+/**
+ * Duration between two events in milliseconds, or -1 if one of them was not seen
+ */
+
+static gint64 phase_duration(wifi_connect_attempt_t *attempt, gint64 from, wifi_connect_event_t to)
+{
+	if(from < 0 || attempt->events[to] < 0)
+		return -1;
+
+	return (attempt->events[to] - from) / 1000;
+}
+
+static void put_phase(jvalue_ref phases_j, const char *name, gint64 duration)
+{
+	if(duration >= 0)
+		jobject_put(phases_j, jstring_create(name), jnumber_create_i64(duration));
+}
+
+static jvalue_ref attempt_to_json(wifi_connect_attempt_t *attempt)
+{
+	jvalue_ref attempt_j = jobject_create();
+	jvalue_ref events_j = jobject_create();
+	jvalue_ref phases_j = jobject_create();
+	gint64 *events = attempt->events;
+	gint64 association_start;
+	guint i;
+
+	for (i = 0; i < WIFI_CONNECT_EVENT_COUNT; i++)
+	{
+		if(events[i] >= 0)
+			jobject_put(events_j, jstring_create(event_names[i]), jnumber_create_i64(events[i] / 1000));
+	}
+
+	/* connman may skip reporting "association" if the service was already in it */
+	association_start = events[WIFI_CONNECT_EVENT_ASSOCIATION] >= 0 ?
+				events[WIFI_CONNECT_EVENT_ASSOCIATION] : events[WIFI_CONNECT_EVENT_CONNECT_CALLED];
+
+	put_phase(phases_j, "disconnect", phase_duration(attempt, 0, WIFI_CONNECT_EVENT_DISCONNECTED));
+	put_phase(phases_j, "agent", phase_duration(attempt, events[WIFI_CONNECT_EVENT_AGENT_REQUEST],
+						WIFI_CONNECT_EVENT_AGENT_REPLY));
+	put_phase(phases_j, "association", phase_duration(attempt, association_start,
+						WIFI_CONNECT_EVENT_CONFIGURATION));
+	put_phase(phases_j, "configuration", phase_duration(attempt, events[WIFI_CONNECT_EVENT_CONFIGURATION],
+						WIFI_CONNECT_EVENT_READY));
+	put_phase(phases_j, "online", phase_duration(attempt, events[WIFI_CONNECT_EVENT_READY],
+						WIFI_CONNECT_EVENT_ONLINE));
+	put_phase(phases_j, "total", phase_duration(attempt, 0, WIFI_CONNECT_EVENT_READY));
+
+	jobject_put(attempt_j, J_CSTR_TO_JVAL("ssid"), jstring_create(attempt->ssid ? attempt->ssid : ""));
+	jobject_put(attempt_j, J_CSTR_TO_JVAL("startTime"), jnumber_create_i64(attempt->start_time / 1000));
+	jobject_put(attempt_j, J_CSTR_TO_JVAL("result"), jstring_create(result_names[attempt->result]));
+	jobject_put(attempt_j, J_CSTR_TO_JVAL("eventsMs"), events_j);
+	jobject_put(attempt_j, J_CSTR_TO_JVAL("phasesMs"), phases_j);
+
+	return attempt_j;
+}
+
+/**
+ * Build the list of attempts (see header for API details)
+ */
+
+jvalue_ref wifi_diagnostics_to_json(void)
+{
+	jvalue_ref attempts_j = jarray_create(NULL);
+	guint i, count = MIN(attempt_count, WIFI_DIAGNOSTICS_MAX_ATTEMPTS);
+
+	for (i = 0; i < count; i++)
+		jarray_append(attempts_j, attempt_to_json(&attempts[(attempt_count - 1 - i) % WIFI_DIAGNOSTICS_MAX_ATTEMPTS]));
+
+	return attempts_j;
+}
@@ -0,0 +1,87 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  wifi_diagnostics.h
+ *
+ * @brief Header file defining functions for timing wifi connect attempts
+ *
+ */
+
+
+#ifndef WIFI_DIAGNOSTICS_H_
+#define WIFI_DIAGNOSTICS_H_
+
+#include <glib.h>
+#include <pbnjson.h>
+
+/**
+ * Number of connect attempts kept
+ */
+#define WIFI_DIAGNOSTICS_MAX_ATTEMPTS	16
+
+/**
+ * Events of a connect attempt, only the first occurrence of each is kept
+ */
+typedef enum {
+	WIFI_CONNECT_EVENT_DISCONNECTED = 0,	/* previously connected service was disconnected */
+	WIFI_CONNECT_EVENT_CONNECT_CALLED,	/* Connect call sent to connman */
+	WIFI_CONNECT_EVENT_AGENT_REQUEST,	/* agent asked for credentials */
+	WIFI_CONNECT_EVENT_AGENT_REPLY,		/* agent answered */
+	WIFI_CONNECT_EVENT_ASSOCIATION,
+	WIFI_CONNECT_EVENT_CONFIGURATION,
+	WIFI_CONNECT_EVENT_READY,
+	WIFI_CONNECT_EVENT_ONLINE,
+	WIFI_CONNECT_EVENT_FAILURE,
+	WIFI_CONNECT_EVENT_CONNECT_REPLY,	/* connman replied to the Connect call */
+	WIFI_CONNECT_EVENT_COUNT
+} wifi_connect_event_t;
+
+/**
+ * Start a new connect attempt, superseding a pending one
+ *
+ * @param[IN]  ssid    Requested ssid
+ * @param[IN]  service Target service, only used to match state changes
+ */
+extern void wifi_diagnostics_connect_started(const gchar *ssid, gconstpointer service);
+
+/**
+ * Record an event of the current attempt
+ */
+extern void wifi_diagnostics_event(wifi_connect_event_t event);
+
+/**
+ * Record a state change of a service, ignored unless it is the target of the current attempt
+ *
+ * @param[IN]  service Service which changed its state
+ * @param[IN]  state   connman state of the service (CONNMAN_SERVICE_STATE_*)
+ */
+extern void wifi_diagnostics_state_changed(gconstpointer service, int state);
+
+/**
+ * Record the result of the Connect call of the current attempt
+ */
+extern void wifi_diagnostics_connect_replied(gboolean success);
+
+/**
+ * Build a JSON array of the recorded attempts, newest first
+ */
+extern jvalue_ref wifi_diagnostics_to_json(void);
+
+#endif /* WIFI_DIAGNOSTICS_H_ */
@@ -27,6 +27,7 @@
 
 #include "wifi_profile.h"
 #include "wifi_setting.h"
+#include "network_state.h"
 #include "logging.h"
 
 static GSList *wifi_profile_list = NULL;
@@ -91,17 +92,10 @@ void create_new_profile(gchar *ssid, GStrv security, gboolean hidden)
 	new_profile->profile_id = gprofile_id++;
 	new_profile->ssid = g_strdup(ssid);
 	new_profile->hidden = hidden;
-	if(NULL != security)
-	{
-		gsize i;
-		new_profile->security = (GStrv) g_new0(GStrv, 1);
-		for (i = 0; i < g_strv_length(security); i++)
-		{
-			new_profile->security[i] = g_strdup(security[i]);
-		}
-	}
+	new_profile->security = g_strdupv(security);
 
 	wifi_profile_list = g_slist_append(wifi_profile_list, (gpointer)new_profile);
+	network_state_invalidate();
 	/* Store wifi profiles */
 	store_wifi_setting(WIFI_PROFILELIST_SETTING, NULL);
 }
@@ -125,6 +119,7 @@ void delete_profile(wifi_profile_t *profile)
 	g_strfreev(profile->security);
 	g_free(profile);
 	profile = NULL;
+	network_state_invalidate();
 	store_wifi_setting(WIFI_PROFILELIST_SETTING, NULL);
 }
 
@@ -184,6 +179,7 @@ void move_profile_to_head(wifi_profile_t *profile)
 		wifi_profile_list = g_slist_remove_link( wifi_profile_list, g_slist_find(wifi_profile_list, profile));
 		/* Then add it to start of the list */
 		wifi_profile_list = g_slist_prepend( wifi_profile_list, profile);
+		network_state_invalidate();
 	}
 	store_wifi_setting(WIFI_PROFILELIST_SETTING, NULL);
 }
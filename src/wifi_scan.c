@@ -0,0 +1,101 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  wifi_scan.c
+ *
+ * @brief Runs one wifi scan at a time and remembers when the found networks
+ *        were last refreshed
+ *
+ * The found networks themselves are the manager's wifi services, as
+ * published in the network state snapshots. This only tracks their age
+ * and the callers waiting for the scan in flight.
+ *
+ */
+
+#include <glib.h>
+
+#include "wifi_scan.h"
+#include "connman_manager.h"
+#include "common.h"
+#include "utils.h"
+#include "logging.h"
+
+static gboolean scan_in_flight = FALSE;
+static GSList *scan_waiters = NULL;	/* struct cb_data */
+
+/* Monotonic time of the last successful scan, 0 if there was none */
+static gint64 last_scan_time = 0;
+
+static void scan_done_cb(gboolean success, gpointer user_data)
+{
+	GSList *waiters = g_slist_reverse(scan_waiters);
+	GSList *iter;
+
+	scan_waiters = NULL;
+	scan_in_flight = FALSE;
+
+	if(success)
+		last_scan_time = g_get_monotonic_time();
+
+	for (iter = waiters; NULL != iter; iter = iter->next)
+	{
+		struct cb_data *cbd = iter->data;
+		wifi_scan_done_cb cb = cbd->cb;
+
+		cb(success, cbd->data);
+		g_free(cbd);
+	}
+	g_slist_free(waiters);
+}
+
+gboolean wifi_scan_start(wifi_scan_done_cb cb, gpointer user_data)
+{
+	if(!scan_in_flight)
+	{
+		connman_technology_t *wifi_tech = connman_manager_find_wifi_technology(manager);
+		if(!connman_technology_scan_network_async(wifi_tech, scan_done_cb, NULL))
+			return FALSE;
+
+		scan_in_flight = TRUE;
+	}
+
+	if(NULL != cb)
+		scan_waiters = g_slist_prepend(scan_waiters, cb_data_new(cb, user_data));
+
+	return TRUE;
+}
+
+gboolean wifi_scan_in_progress(void)
+{
+	return scan_in_flight;
+}
+
+gint64 wifi_scan_age(void)
+{
+	if(0 == last_scan_time)
+		return -1;
+
+	return (g_get_monotonic_time() - last_scan_time) / 1000;
+}
+
+void wifi_scan_invalidate(void)
+{
+	last_scan_time = 0;
+}
@@ -0,0 +1,67 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  wifi_scan.h
+ *
+ * @brief Header file defining the wifi scan cache
+ *
+ */
+
+
+#ifndef WIFI_SCAN_H_
+#define WIFI_SCAN_H_
+
+#include <glib.h>
+
+/**
+ * Called once the scan a caller joined is done
+ */
+typedef void (*wifi_scan_done_cb)(gboolean success, gpointer user_data);
+
+/**
+ * Start a wifi scan, or join the one already in flight
+ *
+ * At most one scan is running at any time.
+ *
+ * @param[IN]  cb Callback for the end of the scan, may be NULL
+ * @param[IN]  user_data User data passed to the callback
+ *
+ * @return FALSE if no scan could be started, cb is not called then
+ */
+extern gboolean wifi_scan_start(wifi_scan_done_cb cb, gpointer user_data);
+
+/**
+ * Check if a scan is in flight
+ */
+extern gboolean wifi_scan_in_progress(void);
+
+/**
+ * Age of the cached scan results
+ *
+ * @return Milliseconds since the last successful scan, -1 if there was none
+ */
+extern gint64 wifi_scan_age(void);
+
+/**
+ * Forget the cached scan results, e.g. once wifi is switched off
+ */
+extern void wifi_scan_invalidate(void);
+
+#endif /* WIFI_SCAN_H_ */
@@ -63,10 +63,17 @@ errorText | Yes | String | Error description
 #include "wifi_setting.h"
 #include "connman_manager.h"
 #include "connman_agent.h"
+#include "technology_registry.h"
 #include "lunaservice_utils.h"
+#include "watchdog.h"
+#include "wifi_diagnostics.h"
+#include "offload.h"
+#include "wifi_scan.h"
+#include "network_state.h"
 #include "common.h"
 #include "connectionmanager_service.h"
 #include "logging.h"
+#include "scheduler.h"
 
 /* Range for converting signal strength to signal bars */
 #define MID_SIGNAL_RANGE_LOW	34
@@ -83,6 +90,22 @@ typedef struct connection_settings {
 /* Schedule a scan every 15 seconds */
 #define WIFI_DEFAULT_SCAN_TIMEOUT	15000
 
+/* Reply to findnetworks from scan results up to 15 seconds old */
+#define WIFI_DEFAULT_MAX_SCAN_AGE	15000
+
+/* Fallback connect: time a candidate gets to associate, then to get configured */
+#define WIFI_FALLBACK_ASSOCIATION_TIMEOUT	10000
+#define WIFI_FALLBACK_CONFIGURATION_TIMEOUT	15000
+
+/* Smoothed signal strength one step down the profile list is worth */
+#define WIFI_FALLBACK_RANK_WEIGHT	10
+
+/* getsignalhistory defaults and limits, resolutions in milliseconds */
+#define WIFI_SIGNAL_HISTORY_DEFAULT_MINUTES	5
+#define WIFI_SIGNAL_HISTORY_DEFAULT_RESOLUTION	10000
+#define WIFI_SIGNAL_HISTORY_MIN_RESOLUTION	1000
+#define WIFI_SIGNAL_HISTORY_MAX_BUCKETS	720
+
 static LSHandle *pLsHandle, *pLsPublicHandle;
 
 connman_manager_t *manager = NULL;
@@ -91,6 +114,40 @@ static connman_agent_t *agent = NULL;
 guint scan_timeout_source = 0;
 guint current_scan_interval = 0;
 
+/**
+ * A connect in progress. Connect requests for the same ssid which arrive
+ * while it runs join it and get its result, rather than restarting it.
+ */
+typedef struct connect_attempt {
+	gint ref_count;				/* held while current and by each pending Connect call */
+	gchar *requested_ssid;			/* ssid the callers asked for, NULL for a plain fallback */
+	gchar *ssid;				/* ssid of the service being connected */
+	gchar *service_path;
+	connection_settings_t *settings;	/* credentials handed to the agent, may be NULL */
+	GSList *requests;			/* luna_service_request_t waiting for the result */
+	gboolean finished;			/* callers were answered, or it was superseded */
+	guint hop;				/* incremented for every service tried */
+	GPtrArray *candidates;			/* service paths to try in turn, NULL unless fallback */
+	guint candidate;			/* index in candidates of the service being connected */
+	guint deadline_source;			/* timeout of the current connection phase */
+} connect_attempt_t;
+
+/**
+ * A Connect call in flight, for one hop of an attempt
+ */
+typedef struct connect_call {
+	connect_attempt_t *attempt;
+	guint hop;
+} connect_call_t;
+
+static connect_attempt_t *current_attempt = NULL;
+
+/* Connect to the best known network once the first scan after power on is done */
+static gboolean fallback_on_power_on = FALSE;
+
+static void connect_attempt_state_changed(connect_attempt_t *attempt, connman_service_t *service, int service_state);
+static void fallback_after_power_on_cb(gboolean success, gpointer user_data);
+
 static connection_settings_t* connection_settings_new(void)
 {
 	connection_settings_t *settings = NULL;
@@ -269,13 +326,8 @@ static void send_connection_status(jvalue_ref *reply)
 	}
 }
 
-static void send_connection_status_to_subscribers(const gchar *service_state)
+static void post_status_to_subscribers(jvalue_ref reply, gboolean event)
 {
-	jvalue_ref reply = jobject_create();
-	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
-
-	send_connection_status(&reply);
-
 	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
 	if(response_schema)
 	{
@@ -283,13 +335,24 @@ static void send_connection_status_to_subscribers(const gchar *service_state)
 		WCA_LOG_DEBUG("Sending payload : %s",payload);
 		LSError lserror;
 		LSErrorInit(&lserror);
-		if (!LSSubscriptionPost(pLsHandle, "/", "getstatus", payload, &lserror))
+		bool posted = event ? luna_service_subscription_post_event(pLsHandle, "/", "getstatus", payload, &lserror)
+				: luna_service_subscription_post(pLsHandle, "/", "getstatus", payload, &lserror);
+		if (!posted)
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
 		}
 		jschema_release(&response_schema);
 	}
+}
+
+static void send_connection_status_to_subscribers(const gchar *service_state)
+{
+	jvalue_ref reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+
+	send_connection_status(&reply);
+	post_status_to_subscribers(reply, FALSE);
 	j_release(&reply);
 
 	/* If the service state is different from manager state, send 'getstatus'
@@ -317,6 +380,11 @@ static void service_state_changed_callback(gpointer data, const gchar *new_state
 	WCA_LOG_DEBUG("Service %s state changed to %s",service->name, new_state);
 
 	int service_state = connman_service_get_state(service->state);
+	wifi_diagnostics_state_changed(service, service_state);
+
+	if(NULL != current_attempt)
+		connect_attempt_state_changed(current_attempt, service, service_state);
+
 	switch(service_state)
 	{
 		case  CONNMAN_SERVICE_STATE_CONFIGURATION:
@@ -350,127 +418,245 @@ static void service_state_changed_callback(gpointer data, const gchar *new_state
 		else
 			create_new_profile(service->name, NULL, service->hidden);
 	}
+}
+
+/**
+ *  @brief Register for 'state changed' signal of the found networks which are
+ *  not idle, to update their connection status
+ */
+
+static void watch_wifi_service_states(void)
+{
+	GSList *ap;
 
-	/* Unset agent callback as we no longer have any valid input for connman available */
-	connman_agent_set_request_input_callback(agent, NULL, NULL);
+	for (ap = manager->wifi_services; NULL != ap ; ap = ap->next)
+	{
+		connman_service_t *service = (connman_service_t *)(ap->data);
+		if(NULL == service->name || NULL == service->state)
+			continue;
+
+		/* The hidden services, once connected, get added as a new service in "association" state */
+		if(connman_service_get_state(service->state) != CONNMAN_SERVICE_STATE_IDLE)
+			connman_service_register_state_changed_cb(service, service_state_changed_callback);
+	}
 }
 
-/**  @brief Add details about the given service representing a wifi access point
+/**  @brief Add details about the given wifi access point
  *  
- *  @param service
+ *  Only reads the immutable snapshot so it can run on any thread
+ *
+ *  @param info
+ *  @param profile_id -1 if there is no profile
  *  @param network
  *
  */
  
-static void add_service(connman_service_t *service, jvalue_ref *network)
+static void add_network_info(const network_service_state_t *info, gint profile_id, jvalue_ref *network)
 {
-	if(NULL == service || NULL == network)
+	if(NULL == info || NULL == network)
 		return;
 
 	gboolean supported = TRUE;
 
-	jobject_put(*network, J_CSTR_TO_JVAL("ssid"), jstring_create(service->name));
+	jobject_put(*network, J_CSTR_TO_JVAL("ssid"), jstring_create(info->name));
 
-	wifi_profile_t *profile = get_profile_by_ssid(service->name);
-	if(NULL != profile)
+	if(profile_id >= 0)
 	{
-		jobject_put(*network, J_CSTR_TO_JVAL("profileId"), jnumber_create_i32(profile->profile_id));
+		jobject_put(*network, J_CSTR_TO_JVAL("profileId"), jnumber_create_i32(profile_id));
 	}
 
-	if((service->security != NULL) && g_strv_length(service->security))
+	if((info->security != NULL) && g_strv_length(info->security))
 	{
 		gsize i;
 		jvalue_ref security_list = jarray_create(NULL);
-		for (i = 0; i < g_strv_length(service->security); i++)
+		for (i = 0; i < g_strv_length(info->security); i++)
 		{
 			/*Initial work to support ieee8021x*/
 			// (We did not support enterprise security i.e "ieee8021x" security type)
-			/*if(!g_strcmp0(service->security[i],"ieee8021x"))
+			/*if(!g_strcmp0(info->security[i],"ieee8021x"))
 				supported = FALSE;*/
-			if(!g_strcmp0(service->security[i],"none"))
+			if(!g_strcmp0(info->security[i],"none"))
 				continue;
-			jarray_append(security_list, jstring_create(service->security[i]));
+			jarray_append(security_list, jstring_create(info->security[i]));
 		}
 		jobject_put(*network, J_CSTR_TO_JVAL("availableSecurityTypes"),security_list);
 	}
 
-	jobject_put(*network, J_CSTR_TO_JVAL("signalBars"),jnumber_create_i32(signal_strength_to_bars(service->strength)));
-	jobject_put(*network, J_CSTR_TO_JVAL("signalLevel"),jnumber_create_i32(service->strength));
+	jobject_put(*network, J_CSTR_TO_JVAL("signalBars"),jnumber_create_i32(signal_strength_to_bars(info->strength)));
+	jobject_put(*network, J_CSTR_TO_JVAL("signalLevel"),jnumber_create_i32(info->strength));
 	jobject_put(*network, J_CSTR_TO_JVAL("supported"),jboolean_create(supported));
 
-	if(service->state != NULL) 
+	if(info->state != NULL)
 	{
-		if(connman_service_get_state(service->state) != CONNMAN_SERVICE_STATE_IDLE)
-		{
-			jobject_put(*network, J_CSTR_TO_JVAL("connectState"),jstring_create(connman_service_get_webos_state(connman_service_get_state(service->state)))); 
-			/* Register for 'state changed' signal for this service to update its connection status */
-			/* The hidden services, once connected, get added as a new service in "association" state */
-			connman_service_register_state_changed_cb(service, service_state_changed_callback);
-		}
+		int connman_state = connman_service_get_state(info->state);
+		if(connman_state != CONNMAN_SERVICE_STATE_IDLE)
+			jobject_put(*network, J_CSTR_TO_JVAL("connectState"),jstring_create(connman_service_get_webos_state(connman_state)));
 	}
 }
 
 /**
- *  @brief Populate information about all the found networks
+ *  @brief Add the list of networks in a snapshot to a findnetworks reply
  *
+ *  @param state
  *  @param reply
  *
  */
 
-static bool populate_wifi_networks(jvalue_ref *reply)
+static bool add_network_list(const network_state_t *state, jvalue_ref *reply)
 {
+	bool networks_found = false;
+	guint i;
+
 	if(NULL == reply)
 		return false;
 
-        bool networks_found = false;
+	jvalue_ref network_list = jarray_create(NULL);
 
-        jvalue_ref network_list = jarray_create(NULL);
+	for (i = 0; i < state->wifi_services->len; i++)
+	{
+		const network_service_state_t *info = g_ptr_array_index(state->wifi_services, i);
+		if(NULL == info->name)
+			continue;
 
-        GSList *ap;
+		const network_profile_state_t *profile = network_state_find_profile(state, info->name);
 
-        /* Go through the manager's services list and fill in details
-           for each one of them */
+		jvalue_ref network = jobject_create();
+		add_network_info(info, (NULL != profile) ? (gint) profile->profile_id : -1, &network);
 
-        for (ap = manager->wifi_services; NULL != ap ; ap = ap->next)
-	{
-                connman_service_t *service = (connman_service_t *)(ap->data);
-                if(NULL == service->name)
-                        continue;
+		jvalue_ref network_list_j = jobject_create();
+		jobject_put(network_list_j, J_CSTR_TO_JVAL("networkInfo"), network);
+		jarray_append(network_list, network_list_j);
+		networks_found = true;
+	}
 
-		jvalue_ref network = jobject_create();
-                add_service(service, &network);
+	if(networks_found)
+		jobject_put(*reply, J_CSTR_TO_JVAL("foundNetworks"), network_list);
+	else
+		j_release(&network_list);
+
+	return networks_found;
+}
 
-                jvalue_ref network_list_j = jobject_create();
-                jobject_put(network_list_j, J_CSTR_TO_JVAL("networkInfo"), network);
-                jarray_append(network_list, network_list_j);
+/**
+ *  @brief A findnetworks payload built on a worker thread
+ */
 
-                networks_found = true;
+typedef struct findnetworks_job
+{
+	network_state_t *state;
+	gint subscribed;	/* value of the "subscribed" field, -1 to leave it out */
+	LSHandle *sh;
+	LSMessage *message;	/* message to reply to, NULL to post to all subscribers */
+	gint64 age;		/* age of the scan results in ms, -1 if unknown */
+	guint seq;
+	gchar *payload;
+}findnetworks_job_t;
+
+/* Sequence numbers of the findnetworks posts, so a stale post never overtakes a newer one */
+static guint findnetworks_post_seq = 0;
+static guint findnetworks_posted_seq = 0;
+
+static void findnetworks_job_work(gpointer data)
+{
+	findnetworks_job_t *job = data;
+	jvalue_ref reply = jobject_create();
+
+	if(job->subscribed >= 0)
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(job->subscribed));
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	if(job->age >= 0)
+		jobject_put(reply, J_CSTR_TO_JVAL("age"), jnumber_create_i64(job->age));
+
+	/* Without any network the reply carries no more than returnValue */
+	if(!add_network_list(job->state, &reply) && NULL != job->message)
+	{
+		j_release(&reply);
+		reply = jobject_create();
+		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	}
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(response_schema)
+	{
+		job->payload = g_strdup(jvalue_tostring(reply, response_schema));
+		jschema_release(&response_schema);
 	}
+	j_release(&reply);
+}
+
+static void findnetworks_job_done(gpointer data)
+{
+	findnetworks_job_t *job = data;
+	LSError lserror;
+	LSErrorInit(&lserror);
 
-        if(networks_found)
+	if(NULL != job->message)
+	{
+		if(NULL == job->payload)
+			LSMessageReplyErrorUnknown(job->sh, job->message);
+		else if (!luna_service_message_reply(job->sh, job->message, job->payload, &lserror))
+		{
+			LSErrorPrint(&lserror, stderr);
+			LSErrorFree(&lserror);
+		}
+		luna_service_message_unref(job->message);
+	}
+	else if(NULL != job->payload && (gint)(job->seq - findnetworks_posted_seq) > 0)
 	{
-                jobject_put(*reply, J_CSTR_TO_JVAL("foundNetworks"), network_list);
+		findnetworks_posted_seq = job->seq;
+		if (!luna_service_subscription_post(job->sh, "/", LUNA_METHOD_FINDNETWORKS, job->payload, &lserror))
+		{
+			LSErrorPrint(&lserror, stderr);
+			LSErrorFree(&lserror);
+		}
 	}
+
+	network_state_release(job->state);
+	g_free(job->payload);
+	g_free(job);
+}
+
+/**
+ *  @brief Build the findnetworks payload on a worker thread, then reply to message
+ *  or post it to all subscribers if message is NULL
+ */
+
+static void send_findnetworks(LSHandle *sh, LSMessage *message, gint subscribed)
+{
+	findnetworks_job_t *job = g_new0(findnetworks_job_t, 1);
+
+	watch_wifi_service_states();
+
+	job->state = network_state_acquire();
+	job->age = wifi_scan_age();
+	job->subscribed = subscribed;
+	job->sh = sh;
+	job->message = message;
+	if(NULL != message)
+		luna_service_message_ref(message);
 	else
-		j_release(&network_list);
+		job->seq = ++findnetworks_post_seq;
 
-        return networks_found;
+	/* A reply is waited for, a post to subscribers is background work */
+	offload_run_full(scheduler_priority(NULL != message ? SCHEDULER_CLASS_INTERACTIVE : SCHEDULER_CLASS_BACKGROUND),
+			findnetworks_job_work, findnetworks_job_done, job);
 }
 
 
 static GVariant* agent_request_input_callback(GVariant *fields, gpointer data)
 {
-	connection_settings_t *settings = data;
+	connect_attempt_t *attempt = data;
+	connection_settings_t *settings = attempt->settings;
 	GVariant *response = NULL;
 	GVariantBuilder *vabuilder;
 	GVariantIter iter;
 	gchar *key;
 	GVariant *value;
 
-	if (!g_variant_is_container(fields)) {
-		connection_settings_free(settings);
+	wifi_diagnostics_event(WIFI_CONNECT_EVENT_AGENT_REQUEST);
+
+	if (!g_variant_is_container(fields))
 		return NULL;
-	}
 	vabuilder = g_variant_builder_new((const GVariantType *)"a{sv}");
 
 	g_variant_iter_init(&iter, fields);
@@ -517,48 +703,308 @@ static GVariant* agent_request_input_callback(GVariant *fields, gpointer data)
 	response = g_variant_builder_end(vabuilder);
 	g_variant_builder_unref(vabuilder);
 
-	connection_settings_free(settings);
-
-	connman_agent_set_request_input_callback(agent, NULL, NULL);
+	/* The attempt keeps the settings; answer once unless a caller brings new ones */
+	connman_agent_remove_request_input(agent, attempt->service_path);
+	wifi_diagnostics_event(WIFI_CONNECT_EVENT_AGENT_REPLY);
 	return response;
 }
 
+static void connect_attempt_unref(connect_attempt_t *attempt)
+{
+	if (--attempt->ref_count > 0)
+		return;
+
+	g_free(attempt->requested_ssid);
+	g_free(attempt->ssid);
+	g_free(attempt->service_path);
+	if (NULL != attempt->settings)
+		connection_settings_free(attempt->settings);
+	if (NULL != attempt->candidates)
+		g_ptr_array_free(attempt->candidates, TRUE);
+	g_slist_free(attempt->requests);
+	g_free(attempt);
+}
+
+/**
+ *  @brief Reply to every caller waiting on a connect attempt
+ *
+ *  @param error_text Error to reply with, NULL for success
+ */
+
+static void connect_attempt_reply(connect_attempt_t *attempt, const char *error_text)
+{
+	GSList *iter;
+
+	for (iter = attempt->requests; NULL != iter; iter = iter->next)
+	{
+		luna_service_request_t *service_req = iter->data;
+
+		if (NULL == error_text)
+			LSMessageReplySuccess(service_req->handle, service_req->message);
+		else
+			LSMessageReplyCustomError(service_req->handle, service_req->message, error_text);
+
+		luna_service_message_unref(service_req->message);
+		g_free(service_req);
+	}
+
+	g_slist_free(attempt->requests);
+	attempt->requests = NULL;
+}
+
+static connman_service_t *find_wifi_service_by_path(const gchar *path)
+{
+	GSList *iter;
+
+	for (iter = manager->wifi_services; NULL != iter; iter = iter->next)
+	{
+		connman_service_t *service = (connman_service_t *)(iter->data);
+
+		if (NULL != service->path && g_str_equal(service->path, path))
+			return service;
+	}
+	return NULL;
+}
+
+static void connect_attempt_clear_deadline(connect_attempt_t *attempt)
+{
+	if (attempt->deadline_source > 0)
+	{
+		g_source_remove(attempt->deadline_source);
+		attempt->deadline_source = 0;
+	}
+}
+
+/**
+ *  @brief Answer the callers of the current attempt and drop it
+ */
+
+static void connect_attempt_finish(connect_attempt_t *attempt, gboolean success, const char *error_text)
+{
+	attempt->finished = TRUE;
+	connect_attempt_clear_deadline(attempt);
+
+	wifi_diagnostics_connect_replied(success);
+	connect_attempt_reply(attempt, success ? NULL : error_text);
+
+	if (current_attempt == attempt)
+	{
+		current_attempt = NULL;
+		/* No valid input for connman available anymore */
+		connman_agent_remove_request_input(agent, attempt->service_path);
+		connect_attempt_unref(attempt);
+	}
+}
+
+/**
+ *  @brief Give up on the current attempt in favour of a connect to another ssid
+ *
+ *  Its callers are told right away. The attempt itself lives on until connman
+ *  answers its Connect call, which is then ignored.
+ */
+
+static void cancel_current_attempt(void)
+{
+	connect_attempt_t *attempt = current_attempt;
+
+	if (NULL == attempt)
+		return;
+
+	WCA_LOG_INFO("Connect to %s superseded", attempt->ssid);
+
+	current_attempt = NULL;
+	attempt->finished = TRUE;
+	connect_attempt_clear_deadline(attempt);
+	connman_agent_remove_request_input(agent, attempt->service_path);
+	connect_attempt_reply(attempt, "Connection superseded");
+
+	connman_service_t *service = find_wifi_service_by_path(attempt->service_path);
+	if (NULL != service)
+		connman_service_disconnect_async(service, NULL, NULL);
+
+	connect_attempt_unref(attempt);
+}
+
+static gboolean fallback_next_candidate(connect_attempt_t *attempt, const char *reason);
+
 static void service_connect_callback(gboolean success, gpointer user_data)
 {
-	luna_service_request_t *service_req = user_data;
-	if (success) {
-		LSMessageReplySuccess(service_req->handle, service_req->message);
+	connect_call_t *call = user_data;
+	connect_attempt_t *attempt = call->attempt;
+
+	/* Replies for candidates the attempt already moved away from are stale */
+	if (!attempt->finished && call->hop == attempt->hop)
+	{
+		if (success || !fallback_next_candidate(attempt, "failure"))
+			connect_attempt_finish(attempt, success, "Failed to connect");
 	}
-	else {
-		LSMessageReplyCustomError(service_req->handle, service_req->message, "Failed to connect");
+
+	connect_attempt_unref(attempt);
+	g_free(call);
+}
+
+/**
+ *  @brief Issue the Connect call for the service the attempt is on
+ */
+
+static void connect_attempt_connect(connect_attempt_t *attempt, connman_service_t *service)
+{
+	connect_call_t *call = g_new0(connect_call_t, 1);
+
+	call->attempt = attempt;
+	call->hop = attempt->hop;
+	attempt->ref_count++;
+
+	/* Register for 'state changed' signal for this service to update its connection status */
+	connman_service_register_state_changed_cb(service, service_state_changed_callback);
+
+	if (NULL != attempt->settings)
+	{
+		WCA_LOG_DEBUG("Setup for connecting with secured network");
+		connman_agent_add_request_input(agent, attempt->service_path, agent_request_input_callback,
+				attempt, NULL, CONNMAN_AGENT_REQUEST_TIMEOUT);
 	}
 
-	LSMessageUnref(service_req->message);
-	g_free(service_req);
+	wifi_diagnostics_event(WIFI_CONNECT_EVENT_CONNECT_CALLED);
+	if (!connman_service_connect(service, service_connect_callback, call))
+		service_connect_callback(FALSE, call);
 }
 
 /**
- *  @brief Connect to a access point with the given ssid
+ *  @brief Parse the 'security' object of a connect request
  *
- *  @param ssid 
+ *  @return FALSE if the object is present but not understood
  */
 
-static void connect_wifi_with_ssid(const char *ssid, jvalue_ref req_object, luna_service_request_t *service_req)
+static gboolean parse_connection_settings(const char *ssid, jvalue_ref req_object, connection_settings_t **settings_out)
 {
 	jvalue_ref security_obj = NULL;
 	jvalue_ref simple_security_obj = NULL;
 	jvalue_ref enterprise_security_obj = NULL;
 	jvalue_ref identity_obj = NULL;
 	jvalue_ref passkey_obj = NULL;
-	jvalue_ref hidden_obj = NULL;
 	jvalue_ref wps_obj = NULL;
 	jvalue_ref wpspin_obj = NULL;
-
 	raw_buffer identity_buf, passkey_buf, wpspin_buf;
+	connection_settings_t *settings = NULL;
+
+	*settings_out = NULL;
+
+	if (!jobject_get_exists(req_object, J_CSTR_TO_BUF("security"), &security_obj))
+		return TRUE;
+
+	settings = connection_settings_new();
+	settings->ssid = strdup(ssid);
+
+	/* parse security parameters and set connection settings accordingly */
+	if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("simpleSecurity"), &simple_security_obj) &&
+		jobject_get_exists(simple_security_obj, J_CSTR_TO_BUF("passKey"), &passkey_obj))
+	{
+		passkey_buf = jstring_get(passkey_obj);
+		settings->passkey = strdup(passkey_buf.m_str);
+		jstring_free_buffer(passkey_buf);
+	}
+	else if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("enterpriseSecurity"), &enterprise_security_obj) &&
+		 jobject_get_exists(enterprise_security_obj, J_CSTR_TO_BUF("identityEAP"), &identity_obj) &&
+		 jobject_get_exists(enterprise_security_obj, J_CSTR_TO_BUF("passKey"), &passkey_obj))
+	{
+		identity_buf = jstring_get(identity_obj);
+		settings->identity = strdup(identity_buf.m_str);
+		passkey_buf = jstring_get(passkey_obj);
+		settings->passkey = strdup(passkey_buf.m_str);
+		jstring_free_buffer(identity_buf);
+		jstring_free_buffer(passkey_buf);
+	}
+	else if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("wps"), &wps_obj))
+	{
+		jboolean_get(wps_obj, &settings->wpsmode);
+		if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("wpsPin"), &wpspin_obj))
+		{
+			wpspin_buf = jstring_get(wpspin_obj);
+			settings->wpspin = strdup(wpspin_buf.m_str);
+			jstring_free_buffer(wpspin_buf);
+		}
+		else
+		{
+			// Setting a default value if no pin is provided
+			settings->wpspin = strdup("nopin");
+		}
+	}
+	else
+	{
+		connection_settings_free(settings);
+		return FALSE;
+	}
+
+	*settings_out = settings;
+	return TRUE;
+}
+
+/**
+ *  @brief Hand a connect request over to the current attempt if it is for the same network
+ *
+ *  @return TRUE if the request joined the attempt
+ */
+
+static gboolean join_current_attempt(const char *ssid, gboolean fallback, connection_settings_t *settings,
+				luna_service_request_t *service_req)
+{
+	if (NULL == current_attempt || fallback != (NULL != current_attempt->candidates))
+		return FALSE;
+
+	/* A fallback connect without ssid joins whatever fallback is running */
+	if (NULL != ssid && g_strcmp0(current_attempt->requested_ssid, ssid))
+		return FALSE;
+
+	/* Same network already on its way, share its result */
+	WCA_LOG_DEBUG("Joining pending connect to %s", current_attempt->ssid);
+	if (NULL != service_req)
+		current_attempt->requests = g_slist_append(current_attempt->requests, service_req);
+	if (NULL != settings)
+	{
+		if (NULL != current_attempt->settings)
+			connection_settings_free(current_attempt->settings);
+		current_attempt->settings = settings;
+		connman_agent_add_request_input(agent, current_attempt->service_path, agent_request_input_callback,
+				current_attempt, NULL, CONNMAN_AGENT_REQUEST_TIMEOUT);
+	}
+	return TRUE;
+}
+
+static connect_attempt_t *connect_attempt_new(const char *ssid, connection_settings_t *settings,
+				luna_service_request_t *service_req)
+{
+	connect_attempt_t *attempt = g_new0(connect_attempt_t, 1);
+
+	attempt->ref_count = 1;
+	attempt->requested_ssid = g_strdup(ssid);
+	attempt->ssid = g_strdup(ssid);
+	attempt->settings = settings;
+	if (NULL != service_req)
+		attempt->requests = g_slist_append(NULL, service_req);
+
+	return attempt;
+}
+
+/**
+ *  @brief Connect to a access point with the given ssid
+ *
+ *  Connects are serialized: a request for the ssid already being connected
+ *  joins that attempt, a request for another ssid supersedes it. The
+ *  disconnect of the currently connected service is not waited for, the
+ *  Connect call goes out right behind it.
+ *
+ *  @param ssid
+ */
+
+static void connect_wifi_with_ssid(const char *ssid, jvalue_ref req_object, luna_service_request_t *service_req)
+{
+	jvalue_ref hidden_obj = NULL;
 	GSList *ap;
 	gboolean found_service = FALSE, psk_security = FALSE;
 	connection_settings_t *settings = NULL;
 	connman_service_t *service = NULL;
+	connect_attempt_t *attempt = NULL;
 	bool hidden = false;
 
 	if (NULL == ssid)
@@ -598,22 +1044,6 @@ static void connect_wifi_with_ssid(const char *ssid, jvalue_ref req_object, luna
 				WCA_LOG_INFO("Connecting to ssid %s",service->name);
 
 			found_service = TRUE;
-
-			connman_service_t *connected_service = connman_manager_get_connected_service(manager->wifi_services);
-			if(NULL != connected_service)
-			{
-				if(connected_service != service) {
-					connman_service_disconnect(connected_service);
-				}
-				else {
-					/* Already connected so connection was successful */
-					LSMessageReplySuccess(service_req->handle, service_req->message);
-					WCA_LOG_DEBUG("Already connected with network");
-					goto cleanup;
-				}
-			}
-			/* Register for 'state changed' signal for this service to update its connection status */
-			connman_service_register_state_changed_cb(service, service_state_changed_callback);
 			break;
 		}
 	}
@@ -623,68 +1053,363 @@ static void connect_wifi_with_ssid(const char *ssid, jvalue_ref req_object, luna
 		goto cleanup;
 	}
 
-	if (jobject_get_exists(req_object, J_CSTR_TO_BUF("security"), &security_obj))
+	if (!parse_connection_settings(ssid, req_object, &settings))
 	{
-		settings = connection_settings_new();
-		settings->ssid = strdup(ssid);
+		LSMessageReplyErrorInvalidParams(service_req->handle, service_req->message);
+		goto cleanup;
+	}
 
-		/* parse security parameters and set connection settings accordingly */
-		if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("simpleSecurity"), &simple_security_obj) &&
-			jobject_get_exists(simple_security_obj, J_CSTR_TO_BUF("passKey"), &passkey_obj))
-		{
-			passkey_buf = jstring_get(passkey_obj);
-			settings->passkey = strdup(passkey_buf.m_str);
-			jstring_free_buffer(passkey_buf);
-		}
-		else if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("enterpriseSecurity"), &enterprise_security_obj) &&
-			 jobject_get_exists(enterprise_security_obj, J_CSTR_TO_BUF("identityEAP"), &identity_obj) &&
-			 jobject_get_exists(enterprise_security_obj, J_CSTR_TO_BUF("passKey"), &passkey_obj))
-		{
-			identity_buf = jstring_get(identity_obj);
-			settings->identity = strdup(identity_buf.m_str);			
-			passkey_buf = jstring_get(passkey_obj);
-			settings->passkey = strdup(passkey_buf.m_str);
-			jstring_free_buffer(identity_buf);
-			jstring_free_buffer(passkey_buf);
+	if (join_current_attempt(ssid, FALSE, settings, service_req))
+		return;
+
+	cancel_current_attempt();
+
+	wifi_diagnostics_connect_started(ssid, service);
+
+	connman_service_t *connected_service = connman_manager_get_connected_service(manager->wifi_services);
+	if(NULL != connected_service)
+	{
+		if(connected_service != service) {
+			connman_service_disconnect_async(connected_service, NULL, NULL);
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_DISCONNECTED);
 		}
-		else if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("wps"), &wps_obj))
-		{
-			jboolean_get(wps_obj, &settings->wpsmode);
-			if (jobject_get_exists(security_obj, J_CSTR_TO_BUF("wpsPin"), &wpspin_obj))
-			{
-				wpspin_buf = jstring_get(wpspin_obj);
-				settings->wpspin = strdup(wpspin_buf.m_str);
-				jstring_free_buffer(wpspin_buf);
-			}
-			else
-			{
-				// Setting a default value if no pin is provided
-				settings->wpspin = strdup("nopin");
-			}
+		else {
+			/* Already connected so connection was successful */
+			wifi_diagnostics_connect_replied(TRUE);
+			LSMessageReplySuccess(service_req->handle, service_req->message);
+			WCA_LOG_DEBUG("Already connected with network");
+			goto cleanup;
 		}
-		else
+	}
+
+	attempt = connect_attempt_new(ssid, settings, service_req);
+	attempt->service_path = g_strdup(service->path);
+	current_attempt = attempt;
+
+	connect_attempt_connect(attempt, service);
+
+	return;
+cleanup:
+	if (settings != NULL)
+		connection_settings_free(settings);
+
+	luna_service_message_unref(service_req->message);
+	g_free(service_req);
+}
+
+/**
+ *  @brief Position of the profile for an ssid in the profile list, or -1
+ */
+
+static gint profile_rank(const gchar *ssid)
+{
+	wifi_profile_t *profile = get_next_profile(NULL);
+	gint rank = 0;
+
+	while(NULL != profile)
+	{
+		if(!g_strcmp0(profile->ssid, ssid))
+			return rank;
+		rank++;
+		profile = get_next_profile(profile);
+	}
+
+	return -1;
+}
+
+typedef struct fallback_candidate {
+	connman_service_t *service;
+	gint score;
+} fallback_candidate_t;
+
+static gint compare_candidates(gconstpointer a, gconstpointer b)
+{
+	const fallback_candidate_t *ca = a;
+	const fallback_candidate_t *cb = b;
+
+	return cb->score - ca->score;
+}
+
+/**
+ *  @brief Rank the known networks in range, best first
+ *
+ *  A step down the profile list weighs as much as WIFI_FALLBACK_RANK_WEIGHT
+ *  points of smoothed signal strength, so a recently used network wins over
+ *  a slightly stronger one but not over one which is much stronger.
+ *
+ *  @param ssid Network to try first, may be NULL
+ *
+ *  @return Object paths of the services to try, in order
+ */
+
+static GPtrArray *rank_fallback_candidates(const char *ssid)
+{
+	GArray *ranked = g_array_new(FALSE, FALSE, sizeof(fallback_candidate_t));
+	GPtrArray *candidates = g_ptr_array_new_with_free_func(g_free);
+	connman_service_t *requested = NULL;
+	GSList *ap;
+	guint i;
+
+	for (ap = manager->wifi_services; NULL != ap ; ap = ap->next)
+	{
+		connman_service_t *service = (connman_service_t *)(ap->data);
+
+		if(NULL == service->name || NULL == service->path)
+			continue;
+
+		if(NULL != ssid && g_str_equal(service->name, ssid))
 		{
-			LSMessageReplyErrorInvalidParams(service_req->handle, service_req->message);
-			goto cleanup;
+			if(NULL == requested)
+				requested = service;
+			continue;
 		}
 
-		WCA_LOG_DEBUG("Setup for connecting with secured network");
-		connman_agent_set_request_input_callback(agent, agent_request_input_callback, settings);
+		gint rank = profile_rank(service->name);
+		if(rank < 0)
+			continue;
+
+		fallback_candidate_t candidate = { service, service->smoothed_strength - rank * WIFI_FALLBACK_RANK_WEIGHT };
+		g_array_append_val(ranked, candidate);
+	}
+
+	if(NULL != requested)
+		g_ptr_array_add(candidates, g_strdup(requested->path));
+
+	g_array_sort(ranked, compare_candidates);
+	for (i = 0; i < ranked->len; i++)
+		g_ptr_array_add(candidates, g_strdup(g_array_index(ranked, fallback_candidate_t, i).service->path));
+
+	g_array_free(ranked, TRUE);
+
+	return candidates;
+}
+
+/**
+ *  @brief Post a fallback hop to the 'getstatus' subscribers
+ *
+ *  @param reason Why the previous candidate was left, NULL for the first one
+ */
+
+static void send_fallback_status_to_subscribers(connect_attempt_t *attempt, const char *reason)
+{
+	jvalue_ref reply = jobject_create();
+	jvalue_ref fallback = jobject_create();
+
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	send_connection_status(&reply);
+
+	if (attempt->candidate < attempt->candidates->len)
+		jobject_put(fallback, J_CSTR_TO_JVAL("ssid"), jstring_create(attempt->ssid));
+	else
+		jobject_put(fallback, J_CSTR_TO_JVAL("exhausted"), jboolean_create(true));
+	jobject_put(fallback, J_CSTR_TO_JVAL("candidate"), jnumber_create_i32(attempt->candidate + 1));
+	jobject_put(fallback, J_CSTR_TO_JVAL("candidates"), jnumber_create_i32(attempt->candidates->len));
+	if (NULL != reason)
+		jobject_put(fallback, J_CSTR_TO_JVAL("reason"), jstring_create(reason));
+	jobject_put(reply, J_CSTR_TO_JVAL("fallback"), fallback);
+
+	/* A hop, not a state, so the next status post must not drop it */
+	post_status_to_subscribers(reply, TRUE);
+	j_release(&reply);
+}
+
+static gboolean fallback_deadline_cb(gpointer user_data)
+{
+	connect_attempt_t *attempt = user_data;
+
+	attempt->deadline_source = 0;
+
+	WCA_LOG_INFO("Connect to %s timed out", attempt->ssid);
+	if (!fallback_next_candidate(attempt, "timeout"))
+		connect_attempt_finish(attempt, FALSE, "Failed to connect");
+
+	return FALSE;
+}
+
+static void fallback_arm_deadline(connect_attempt_t *attempt, guint timeout_ms)
+{
+	connect_attempt_clear_deadline(attempt);
+	attempt->deadline_source = scheduler_timeout_add(SCHEDULER_CLASS_SIGNAL, timeout_ms,
+						fallback_deadline_cb, attempt, NULL);
+}
+
+/**
+ *  @brief Connect to the next candidate still in range
+ *
+ *  @return FALSE once no candidate is left
+ */
+
+static gboolean fallback_try_candidate(connect_attempt_t *attempt)
+{
+	connman_service_t *service = NULL;
+
+	for (; attempt->candidate < attempt->candidates->len; attempt->candidate++)
+	{
+		service = find_wifi_service_by_path(g_ptr_array_index(attempt->candidates, attempt->candidate));
+		if (NULL != service)
+			break;
+	}
+
+	if (NULL == service)
+		return FALSE;
+
+	attempt->hop++;
+	g_free(attempt->ssid);
+	attempt->ssid = g_strdup(service->name);
+	g_free(attempt->service_path);
+	attempt->service_path = g_strdup(service->path);
+
+	WCA_LOG_INFO("Fallback connect to %s (%u of %u)", attempt->ssid,
+			attempt->candidate + 1, attempt->candidates->len);
+
+	fallback_arm_deadline(attempt, WIFI_FALLBACK_ASSOCIATION_TIMEOUT);
+	connect_attempt_connect(attempt, service);
+
+	return TRUE;
+}
+
+/**
+ *  @brief Leave the candidate the attempt is on and go on with the next one
+ *
+ *  @return FALSE if there is no candidate left, or the attempt is no fallback
+ */
+
+static gboolean fallback_next_candidate(connect_attempt_t *attempt, const char *reason)
+{
+	if (NULL == attempt->candidates)
+		return FALSE;
+
+	connman_agent_remove_request_input(agent, attempt->service_path);
+	connman_service_t *service = find_wifi_service_by_path(attempt->service_path);
+	if (NULL != service)
+		connman_service_disconnect_async(service, NULL, NULL);
+
+	/* Credentials only ever belong to the requested network */
+	if (NULL != attempt->settings)
+	{
+		connection_settings_free(attempt->settings);
+		attempt->settings = NULL;
+	}
+
+	attempt->candidate++;
+	gboolean found = fallback_try_candidate(attempt);
+	send_fallback_status_to_subscribers(attempt, reason);
+
+	return found;
+}
+
+/**
+ *  @brief Move the deadline of a fallback attempt along with the state of its service
+ */
+
+static void connect_attempt_state_changed(connect_attempt_t *attempt, connman_service_t *service, int service_state)
+{
+	if (attempt->finished || NULL == attempt->candidates || g_strcmp0(attempt->service_path, service->path))
+		return;
+
+	switch(service_state)
+	{
+		case CONNMAN_SERVICE_STATE_CONFIGURATION:
+			fallback_arm_deadline(attempt, WIFI_FALLBACK_CONFIGURATION_TIMEOUT);
+			break;
+		case CONNMAN_SERVICE_STATE_READY:
+		case CONNMAN_SERVICE_STATE_ONLINE:
+			connect_attempt_clear_deadline(attempt);
+			break;
+		case CONNMAN_SERVICE_STATE_FAILURE:
+			if (!fallback_next_candidate(attempt, "failure"))
+				connect_attempt_finish(attempt, FALSE, "Failed to connect");
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ *  @brief Connect to the best known network in range, moving on to the next
+ *  one whenever a phase of the connection takes too long
+ *
+ *  @param ssid Network to try first, NULL to only go by the ranking
+ *  @param service_req Request to answer, NULL when no caller waits
+ */
+
+static void connect_wifi_with_fallback(const char *ssid, jvalue_ref req_object, luna_service_request_t *service_req)
+{
+	connection_settings_t *settings = NULL;
+	connect_attempt_t *attempt = NULL;
+	GPtrArray *candidates = NULL;
+
+	if (NULL != ssid && !parse_connection_settings(ssid, req_object, &settings))
+	{
+		LSMessageReplyErrorInvalidParams(service_req->handle, service_req->message);
+		goto cleanup;
 	}
 
-	if (!connman_service_connect(service, service_connect_callback, service_req))
+	if (join_current_attempt(ssid, TRUE, settings, service_req))
+		return;
+
+	candidates = rank_fallback_candidates(ssid);
+	if (0 == candidates->len)
 	{
-		LSMessageReplyErrorUnknown(service_req->handle, service_req->message);
+		g_ptr_array_free(candidates, TRUE);
+		if (NULL != service_req)
+			LSMessageReplyCustomError(service_req->handle, service_req->message, "Network not found");
 		goto cleanup;
 	}
 
+	cancel_current_attempt();
+
+	connman_service_t *first = find_wifi_service_by_path(g_ptr_array_index(candidates, 0));
+	wifi_diagnostics_connect_started(first->name, first);
+
+	connman_service_t *connected_service = connman_manager_get_connected_service(manager->wifi_services);
+	if(NULL != connected_service)
+	{
+		if(connected_service != first) {
+			connman_service_disconnect_async(connected_service, NULL, NULL);
+			wifi_diagnostics_event(WIFI_CONNECT_EVENT_DISCONNECTED);
+		}
+		else {
+			/* Already on the best network */
+			g_ptr_array_free(candidates, TRUE);
+			wifi_diagnostics_connect_replied(TRUE);
+			if (NULL != service_req)
+				LSMessageReplySuccess(service_req->handle, service_req->message);
+			goto cleanup;
+		}
+	}
+
+	attempt = connect_attempt_new(ssid, settings, service_req);
+	attempt->candidates = candidates;
+	current_attempt = attempt;
+
+	fallback_try_candidate(attempt);
+	send_fallback_status_to_subscribers(attempt, NULL);
+
 	return;
 cleanup:
 	if (settings != NULL)
 		connection_settings_free(settings);
 
-	g_free(service_req);
-	LSMessageUnref(service_req->message);
+	if (NULL != service_req)
+	{
+		luna_service_message_unref(service_req->message);
+		g_free(service_req);
+	}
+}
+
+/**
+ *  @brief Once the first scan after wifi was switched on is done, get onto
+ *  the best known network unless connman already found one
+ */
+
+static void fallback_after_power_on_cb(gboolean success, gpointer user_data)
+{
+	if (NULL != current_attempt ||
+		NULL != connman_manager_get_connected_service(manager->wifi_services))
+		return;
+
+	connect_wifi_with_fallback(NULL, NULL, NULL);
 }
 
 /**
@@ -716,27 +1441,8 @@ static void manager_property_changed_callback(gpointer data, const gchar *proper
 
 static void manager_services_changed_callback(gpointer data)
 {
-	jvalue_ref reply = jobject_create();
-	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
-
 	/* Send the latest WiFi network list to subscribers of 'findnetworks' method */
-	populate_wifi_networks(&reply);
-
-	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
-	if(response_schema)
-	{
-		const char *payload = jvalue_tostring(reply, response_schema);
-		LSError lserror;
-		LSErrorInit(&lserror);
-
-		if (!LSSubscriptionPost(pLsHandle, "/", "findnetworks", payload, &lserror))
-		{
-			LSErrorPrint(&lserror, stderr);
-			LSErrorFree(&lserror);
-		}
-		jschema_release(&response_schema);
-	}
-	j_release(&reply);
+	send_findnetworks(pLsHandle, NULL, -1);
 }
 
 /**
@@ -759,6 +1465,13 @@ static void technology_property_changed_callback(gpointer data, const gchar *pro
 	   of WiFi technology changes */
 	if(g_str_equal(property,"Powered"))
 	{
+		if(!technology->powered)
+			wifi_scan_invalidate();
+		else if(fallback_on_power_on)
+		{
+			fallback_on_power_on = FALSE;
+			wifi_scan_start(fallback_after_power_on_cb, NULL);
+		}
 		send_connection_status_to_subscribers(NULL);
 		connectionmanager_send_status();
 	}
@@ -776,6 +1489,7 @@ Enable or Disable WIFI support
 Name | Required | Type | Description
 -----|--------|------|----------
 state | Yes | String | "enabled" or "disabled" to control WIFI accordingly
+fallback | No | Boolean | When enabling, connect to the best known network after the first scan unless connman connected already, see connect
 
 @par Returns(Call)
 Name | Required | Type | Description
@@ -817,7 +1531,7 @@ static bool handle_set_state_command(LSHandle *sh, LSMessage *message, void* con
 
     	JSchemaInfo schemaInfo;
     	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-    	parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+    	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
     	jschema_release(&input_schema);
 
 	if (jis_null(parsedObj))
@@ -828,7 +1542,9 @@ static bool handle_set_state_command(LSHandle *sh, LSMessage *message, void* con
 
 
 	jvalue_ref stateObj = {0};
+	jvalue_ref fallbackObj = {0};
 	gboolean enable_wifi = FALSE;
+	bool fallback = false;
 	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("state"), &stateObj))
 	{
 		if (jstring_equal2(stateObj, J_CSTR_TO_BUF("enabled")))
@@ -867,6 +1583,10 @@ static bool handle_set_state_command(LSHandle *sh, LSMessage *message, void* con
 		goto cleanup;
 	}
 
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("fallback"), &fallbackObj))
+		jboolean_get(fallbackObj, &fallback);
+	fallback_on_power_on = enable_wifi && fallback;
+
 	set_wifi_state(enable_wifi);
 	
 	LSMessageReplySuccess(sh,message);
@@ -940,6 +1660,20 @@ Name | Required | Type | Description
 -----|--------|------|----------
 profileId | Yes | String | Name of desired profile
 
+@par To connect with fallback
+Tries the known networks in range one after the other, best ranked first, until
+one connects. The ranking follows the profile list order and the smoothed signal
+strength. A network which takes longer than 10 seconds to associate, or 15
+seconds to get configured, is left for the next one. Every move is posted to the
+'getstatus' subscribers in a "fallback" object holding "ssid", "candidate",
+"candidates", "reason" ("timeout" or "failure") and "exhausted" once none is left.
+
+@par Parameters
+Name | Required | Type | Description
+-----|--------|------|----------
+fallback | Yes | Boolean | true
+ssid | No | String | Network to try first, with its "security" object if needed
+
 @par Returns(Call) for all forms
 Name | Required | Type | Description
 -----|--------|------|----------
@@ -964,6 +1698,7 @@ None
  *                                 }
  *                                }'
  *  luna://com.palm.wifi/connect '{"profileId":<Profile ID>}'`
+ *  luna://com.palm.wifi/connect '{"fallback":true}'
  * 
  *  @param sh
  *  @param message
@@ -994,7 +1729,7 @@ static bool handle_connect_command(LSHandle *sh, LSMessage *message, void* conte
 
         JSchemaInfo schemaInfo;
         jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-        parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+        parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
         jschema_release(&input_schema);
 
         if (jis_null(parsedObj))
@@ -1005,7 +1740,12 @@ static bool handle_connect_command(LSHandle *sh, LSMessage *message, void* conte
 
         jvalue_ref ssidObj = {0};
         jvalue_ref profileIdObj = {0};
-	char *ssid;
+        jvalue_ref fallbackObj = {0};
+	char *ssid = NULL;
+	bool fallback = false;
+
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("fallback"), &fallbackObj))
+		jboolean_get(fallbackObj, &fallback);
 
 	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("ssid"), &ssidObj))
 	{
@@ -1030,16 +1770,19 @@ static bool handle_connect_command(LSHandle *sh, LSMessage *message, void* conte
 		}
 		ssid = g_strdup(profile->ssid);
 	}
-	else
+	else if(!fallback)
 	{
 		LSMessageReplyErrorInvalidParams(sh, message);
 		goto cleanup;
 	}
 
 	service_req = luna_service_request_new(sh, message);
-	LSMessageRef(message);
+	luna_service_message_ref(message);
 
-	connect_wifi_with_ssid(ssid, parsedObj, service_req);
+	if(fallback)
+		connect_wifi_with_fallback(ssid, parsedObj, service_req);
+	else
+		connect_wifi_with_ssid(ssid, parsedObj, service_req);
 
 	g_free(ssid);
 cleanup:
@@ -1051,13 +1794,12 @@ gboolean scan_timeout_cb(gpointer user_data)
 {
 	LSError error;
 	LSHandle *sh = user_data;
-	LSSubscriptionIter *iter = NULL;
 	unsigned int subscription_count = 0;
-	connman_technology_t *wifi_tech = 0;
 
 	LSErrorInit(&error);
 
-	if (!LSSubscriptionAcquire(sh, "/" LUNA_METHOD_FINDNETWORKS, &iter, &error))
+	/* count all subscription we have for com.palm.wifi/findnetworks */
+	if (!luna_service_subscription_count(sh, "/" LUNA_METHOD_FINDNETWORKS, &subscription_count, &error))
 	{
 		LSErrorPrint(&error, stderr);
 		LSErrorFree(&error);
@@ -1068,14 +1810,6 @@ gboolean scan_timeout_cb(gpointer user_data)
 		return FALSE;
 	}
 
-	/* count all subscription we have for com.palm.wifi/findnetworks */
-	while (LSSubscriptionHasNext(iter))
-	{
-		LSMessage *message = LSSubscriptionNext(iter);
-		LSMessageUnref(message);
-		subscription_count++;
-	}
-
 	/* if we don't have any subscriptions left we don't have to scan anymore */
 	if (subscription_count == 0)
 	{
@@ -1083,12 +1817,36 @@ gboolean scan_timeout_cb(gpointer user_data)
 		return FALSE;
 	}
 
-	wifi_tech = connman_manager_find_wifi_technology(manager);
-	connman_technology_scan_network(wifi_tech);
+	/* Joins a scan already in flight; subscribers get the results once the services change */
+	wifi_scan_start(NULL, NULL);
 
 	return TRUE;
 }
 
+/**
+ *  @brief A findnetworks caller waiting for the scan in flight
+ */
+
+typedef struct findnetworks_waiter
+{
+	LSHandle *sh;
+	LSMessage *message;
+	gint subscribed;
+}findnetworks_waiter_t;
+
+static void findnetworks_scan_done_cb(gboolean success, gpointer user_data)
+{
+	findnetworks_waiter_t *waiter = user_data;
+
+	if(success)
+		send_findnetworks(waiter->sh, waiter->message, waiter->subscribed);
+	else
+		LSMessageReplyCustomError(waiter->sh, waiter->message, "Error in scanning network");
+
+	luna_service_message_unref(waiter->message);
+	g_free(waiter);
+}
+
 //->Start of API documentation comment block
 /**
 @page com_webos_wifi com.webos.wifi
@@ -1108,12 +1866,15 @@ Name | Required | Type | Description
 -----|--------|------|----------
 subscribe | No | Boolean | true to subcribe to changes
 interval | No | Integer | Internval in seconds to schedule a new scan (defaults to 30 seconds)
+maxAge | No | Integer | Oldest scan results in milliseconds to reply with before scanning again (defaults to 15000)
+waitForFresh | No | Boolean | true to wait for the scan when the results are older than maxAge, false (default) to reply with them right away and scan in the background
 
 @par Returns(Call)
 Name | Required | Type | Description
 -----|--------|------|----------
 returnValue | yes | Boolean | True
 foundNetworks | Yes | Array of Objects | List of networkInfo objects
+age | No | Integer | Milliseconds since the networks were last scanned
 
 @par "networkInfo" Object
 Each entry in the "foundNetworks" array is of the form "networkInfo":{...}
@@ -1139,6 +1900,7 @@ As for a successful call
  *  JSON format:
  *  luna://com.palm.wifi/findnetworks {}
  *  luna://com.palm.wifi/findnetworks {"subscribe":true}
+ *  luna://com.palm.wifi/findnetworks {"maxAge":5000,"waitForFresh":true}
  *  
  *  @param sh
  *  @param message
@@ -1149,13 +1911,66 @@ As for a successful call
 static bool handle_findnetworks_command(LSHandle *sh, LSMessage *message, void* context)
 {
 	jvalue_ref reply = jobject_create();
+	jvalue_ref parsedObj = {0};
 	bool subscribed = false;
+	int scan_interval = WIFI_DEFAULT_SCAN_TIMEOUT;
+	int max_age = WIFI_DEFAULT_MAX_SCAN_AGE;
+	bool wait_for_fresh = false;
 	LSError lserror;
 	LSErrorInit(&lserror);
 
-	if (LSMessageIsSubscription(message))
+	jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!input_schema)
+	{
+		LSMessageReplyErrorUnknown(sh, message);
+		goto cleanup;
+	}
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
+	jschema_release(&input_schema);
+
+	if (jis_null(parsedObj))
+	{
+		LSMessageReplyErrorBadJSON(sh, message);
+		goto cleanup;
+	}
+
+	jvalue_ref intervalObj = {0}, maxAgeObj = {0}, waitForFreshObj = {0};
+	if (jobject_get_exists(parsedObj, J_CSTR_TO_BUF("interval"), &intervalObj))
 	{
-		if (!LSSubscriptionProcess(sh, message, &subscribed, &lserror))
+		if (!jis_number(intervalObj))
+		{
+			LSMessageReplyErrorInvalidParams(sh, message);
+			goto cleanup;
+		}
+		jnumber_get_i32(intervalObj, &scan_interval);
+	}
+
+	if (jobject_get_exists(parsedObj, J_CSTR_TO_BUF("maxAge"), &maxAgeObj))
+	{
+		if (!jis_number(maxAgeObj))
+		{
+			LSMessageReplyErrorInvalidParams(sh, message);
+			goto cleanup;
+		}
+		jnumber_get_i32(maxAgeObj, &max_age);
+	}
+
+	if (jobject_get_exists(parsedObj, J_CSTR_TO_BUF("waitForFresh"), &waitForFreshObj))
+	{
+		if (!jis_boolean(waitForFreshObj))
+		{
+			LSMessageReplyErrorInvalidParams(sh, message);
+			goto cleanup;
+		}
+		jboolean_get(waitForFreshObj, &wait_for_fresh);
+	}
+
+	if (luna_service_message_is_subscription(message))
+	{
+		if (!luna_service_subscription_process(sh, message, &subscribed, &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
@@ -1177,68 +1992,47 @@ static bool handle_findnetworks_command(LSHandle *sh, LSMessage *message, void*
 		goto cleanup;
 	}
 
-	/* only scan if we don't have a scheduled scan pending */
-	if (scan_timeout_source > 0)
-	{
-		connman_technology_t *wifi_tech = connman_manager_find_wifi_technology(manager);
-		if(NULL == wifi_tech)
-		{
-			LSMessageReplySuccess(sh, message);
-			goto cleanup;
-		}
-
-		if(!connman_technology_scan_network(wifi_tech))
-		{
-			LSMessageReplyCustomError(sh,message,"Error in scanning network");
-			goto cleanup;
-		}
-	}
-
 	/* If client has subscribed we need to take care that we give him fresh results
 	 * regularly by scheduling a scan continously in a specific interval */
 	if (subscribed && scan_timeout_source == 0)
 	{
-		int scan_interval = WIFI_DEFAULT_SCAN_TIMEOUT;
+		scan_timeout_source = scheduler_timeout_add(SCHEDULER_CLASS_BACKGROUND, scan_interval,
+												 scan_timeout_cb, sh, NULL);
+	}
 
-		jvalue_ref parsedObj = {0};
-		jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
-		if(!input_schema)
-			return false;
+	gint subscribed_field = luna_service_message_is_subscription(message) ? subscribed : -1;
+	gint64 age = wifi_scan_age();
 
-		JSchemaInfo schemaInfo;
-		jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-		parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
-		jschema_release(&input_schema);
+	/* Fresh enough: reply straight from the cached results */
+	if (age >= 0 && age <= max_age)
+	{
+		send_findnetworks(sh, message, subscribed_field);
+		goto cleanup;
+	}
 
-		if (jis_null(parsedObj))
-		{
-				LSMessageReplyErrorBadJSON(sh, message);
-				return true;
-		}
+	/* Without any cached results there is nothing to reply with but the scan */
+	if (wait_for_fresh || age < 0)
+	{
+		findnetworks_waiter_t *waiter = g_new0(findnetworks_waiter_t, 1);
+		waiter->sh = sh;
+		waiter->message = message;
+		waiter->subscribed = subscribed_field;
+		luna_service_message_ref(message);
 
-		jvalue_ref intervalObj = 0;
-		if (jobject_get_exists(parsedObj, J_CSTR_TO_BUF("interval"), &intervalObj))
+		if (!wifi_scan_start(findnetworks_scan_done_cb, waiter))
 		{
-			if (!jis_number(intervalObj))
-			{
-				LSMessageReplyErrorInvalidParams(sh, message);
-				goto cleanup;
-			}
-
-			jnumber_get_i32(intervalObj, &scan_interval);
+			luna_service_message_unref(message);
+			g_free(waiter);
+			LSMessageReplyCustomError(sh,message,"Error in scanning network");
 		}
-
-		scan_timeout_source = g_timeout_add_full(G_PRIORITY_DEFAULT, scan_interval,
-												 scan_timeout_cb, sh, NULL);
+		goto cleanup;
 	}
 
-	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	/* Stale: reply from the cache and revalidate, subscribers get the new results */
+	send_findnetworks(sh, message, subscribed_field);
+	wifi_scan_start(NULL, NULL);
+	goto cleanup;
 
-	if(!populate_wifi_networks(&reply))
-	{
-		LSMessageReplySuccess(sh, message);
-		goto cleanup;
-	}
 response:
 	{
 		/* Fill in details of all the found wifi networks */
@@ -1248,7 +2042,7 @@ response:
 			LSMessageReplyErrorUnknown(sh,message);
 			goto cleanup;
 		}
-		if (!LSMessageReply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+		if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
@@ -1262,10 +2056,67 @@ cleanup:
 		LSErrorPrint(&lserror, stderr);
 		LSErrorFree(&lserror);
 	}
+	j_release(&parsedObj);
 	j_release(&reply);
 	return true;
 }
 
+//->Start of API documentation comment block
+/**
+@page com_webos_wifi com.webos.wifi
+@{
+@section com_webos_wifi_getnetworks getNetworks
+
+List the wifi access points found by the last scan, without scanning.
+
+@par Parameters
+None
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+age | No | Integer | Milliseconds since the networks were last scanned, absent if they never were
+foundNetworks | No | Array of Objects | List of networkInfo objects, as for findnetworks
+
+@par Returns(Subscription)
+None
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ *  @brief Handler for "getNetworks" command.
+ *  Reply with the cached scan results, never starting a scan
+ *
+ *  JSON format:
+ *  luna://com.palm.wifi/getNetworks {}
+ *
+ *  @param sh
+ *  @param message
+ *  @param context
+ *
+ */
+
+static bool handle_get_networks_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	if(!connman_status_check(manager, sh, message))
+		return true;
+
+	if(!wifi_technology_status_check(sh, message))
+		return true;
+
+	if(!is_wifi_powered())
+	{
+		LSMessageReplyCustomError(sh,message,"WiFi switched off");
+		return true;
+	}
+
+	send_findnetworks(sh, message, -1);
+	return true;
+}
+
 //->Start of API documentation comment block
 /**
 @page com_webos_wifi com.webos.wifi
@@ -1338,9 +2189,9 @@ static bool handle_get_status_command(LSHandle* sh, LSMessage *message, void* co
 	LSErrorInit(&lserror);
 	bool subscribed = false;
 
-	if (LSMessageIsSubscription(message))
+	if (luna_service_message_is_subscription(message))
 	{
-		if (!LSSubscriptionProcess(sh, message, &subscribed, &lserror))
+		if (!luna_service_subscription_process(sh, message, &subscribed, &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
@@ -1369,7 +2220,7 @@ response:
 			goto cleanup;
 		}
 
-		if (!LSMessageReply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+		if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
 		{
 			LSErrorPrint(&lserror, stderr);
 			LSErrorFree(&lserror);
@@ -1496,7 +2347,7 @@ static bool handle_get_profilelist_command(LSHandle *sh, LSMessage *message, voi
 		goto cleanup;
 	}
 
-	if (!LSMessageReply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
 	{
 		LSErrorPrint(&lserror, stderr);
 		LSErrorFree(&lserror);
@@ -1566,7 +2417,7 @@ static bool handle_get_profile_command(LSHandle *sh, LSMessage *message, void* c
 
         JSchemaInfo schemaInfo;
         jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-        parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+        parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
         jschema_release(&input_schema);
 
         if (jis_null(parsedObj))
@@ -1615,7 +2466,7 @@ static bool handle_get_profile_command(LSHandle *sh, LSMessage *message, void* c
 		goto cleanup;
 	}
 
-	if (!LSMessageReply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
 	{
 		LSErrorPrint(&lserror, stderr);
 		LSErrorFree(&lserror);
@@ -1684,7 +2535,7 @@ static bool handle_delete_profile_command(LSHandle *sh, LSMessage *message, void
 
         JSchemaInfo schemaInfo;
         jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
-        parsedObj = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(message)), DOMOPT_NOOPT, &schemaInfo);
+        parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
         jschema_release(&input_schema);
 
         if (jis_null(parsedObj))
@@ -1798,13 +2649,320 @@ static void connman_service_started(GDBusConnection *conn, const gchar *name, co
 	   methods to their subscribers */
 	connman_manager_register_property_changed_cb(manager, manager_property_changed_callback);
 	connman_manager_register_services_changed_cb(manager, manager_services_changed_callback);
+}
 
-	/* Register for WiFi technology's "PropertyChanged" signal*/
-	connman_technology_t *technology = connman_manager_find_wifi_technology(manager);
-	if(technology)
+//->Start of API documentation comment block
+/**
+@page com_webos_wifi com.webos.wifi
+@{
+@section com_webos_wifi_getwifidiagnostics getwifidiagnostics
+
+Lists the most recent connect attempts with the time spent in each phase
+of the connection.
+
+@par Parameters
+None
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+connectAttempts | yes | Array of Object | Array of connectAttempt objects, newest first
+
+@par "connectAttempt" Object
+Name | Required | Type | Description
+-----|--------|------|----------
+ssid | yes | String | SSID passed to the connect method
+startTime | yes | Integer | Time of the connect request in milliseconds since the epoch
+result | yes | String | One of "pending", "connected", "failed" or "superseded"
+eventsMs | yes | Object | Time of each event since the connect request in milliseconds
+phasesMs | yes | Object | Duration of each phase in milliseconds
+
+@par Events
+disconnected, connectCalled, agentRequest, agentReply, association,
+configuration, ready, online, failure and connectReply. Events which did not
+happen are left out.
+
+@par Phases
+Name | Description
+-----|----------
+disconnect | Disconnecting the previously connected service
+agent | Answering the credentials request of connman
+association | Association with the access point, including the agent phase
+configuration | IP configuration until the service is ready
+online | From ready until connman reports the service online
+total | From the connect request until the service is ready
+
+@par Returns(Subscription)
+None.
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ * Handler for "getwifidiagnostics" command.
+ *
+ * JSON format:
+ * luna://com.palm.wifi/getwifidiagnostics {}
+ */
+static bool handle_get_wifi_diagnostics_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	jvalue_ref reply = jobject_create();
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("connectAttempts"), wifi_diagnostics_to_json());
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+	{
+		LSMessageReplyErrorUnknown(sh,message);
+		goto cleanup;
+	}
+
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	jschema_release(&response_schema);
+
+cleanup:
+	j_release(&reply);
+	return true;
+}
+
+static void signal_tick(GPtrArray *due, gint64 now);
+
+/* getsignalhistory subscribers, their last_sent being the end of the last bucket sent */
+static luna_service_periodic_t signal_periodic = {
+	.method = LUNA_METHOD_GETSIGNALHISTORY,
+	.min_period = WIFI_SIGNAL_HISTORY_MIN_RESOLUTION,
+	.tick = signal_tick,
+};
+
+/**
+ *  @brief Reply with the connected service's strength between start and end,
+ *  in buckets of the given resolution
+ */
+
+static void send_signal_history(LSHandle *sh, LSMessage *message, gint64 start, gint64 end,
+				guint resolution, const bool *subscribed)
+{
+	LSError lserror;
+	LSErrorInit(&lserror);
+
+	jvalue_ref reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	if(NULL != subscribed)
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(*subscribed));
+	jobject_put(reply, J_CSTR_TO_JVAL("resolution"), jnumber_create_i32(resolution));
+
+	jvalue_ref buckets_j = jarray_create(NULL);
+	connman_service_t *connected_service = connman_manager_get_connected_service(manager->wifi_services);
+	if(NULL != connected_service)
+	{
+		gint64 width = (gint64) resolution * 1000;
+		guint max_buckets = (end - start + width - 1) / width;
+		signal_bucket_t *buckets = g_new(signal_bucket_t, MAX(max_buckets, 1));
+		guint i, count;
+
+		count = signal_history_downsample(connected_service->signal_history, start, end,
+						width, buckets, max_buckets);
+
+		/* Monotonic times are meaningless to clients */
+		gint64 real_offset = g_get_real_time() - g_get_monotonic_time();
+		for (i = 0; i < count; i++)
+		{
+			jvalue_ref bucket_j = jobject_create();
+			jobject_put(bucket_j, J_CSTR_TO_JVAL("timestamp"), jnumber_create_i64((buckets[i].start + real_offset) / 1000));
+			jobject_put(bucket_j, J_CSTR_TO_JVAL("min"), jnumber_create_i32(buckets[i].min));
+			jobject_put(bucket_j, J_CSTR_TO_JVAL("avg"), jnumber_create_f64(buckets[i].avg));
+			jobject_put(bucket_j, J_CSTR_TO_JVAL("max"), jnumber_create_i32(buckets[i].max));
+			jobject_put(bucket_j, J_CSTR_TO_JVAL("samples"), jnumber_create_i32(buckets[i].samples));
+			jarray_append(buckets_j, bucket_j);
+		}
+		g_free(buckets);
+
+		if(NULL != connected_service->name)
+			jobject_put(reply, J_CSTR_TO_JVAL("ssid"), jstring_create(connected_service->name));
+	}
+	jobject_put(reply, J_CSTR_TO_JVAL("buckets"), buckets_j);
+
+	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!response_schema)
+	{
+		LSMessageReplyErrorUnknown(sh,message);
+		goto cleanup;
+	}
+
+	if (!luna_service_message_reply(sh, message, jvalue_tostring(reply, response_schema), &lserror))
+	{
+		LSErrorPrint(&lserror, stderr);
+		LSErrorFree(&lserror);
+	}
+
+	jschema_release(&response_schema);
+
+cleanup:
+	j_release(&reply);
+}
+
+/**
+ *  @brief Send the due subscribers the buckets completed since their last update
+ */
+
+static void signal_tick(GPtrArray *due, gint64 now)
+{
+	guint i;
+
+	for (i = 0; i < due->len; i++)
+	{
+		luna_service_periodic_subscriber_t *subscriber = g_ptr_array_index(due, i);
+		gint64 resolution = (gint64) subscriber->interval * 1000;
+		gint64 complete = (now - subscriber->last_sent) / resolution;
+
+		/* Only whole buckets are sent */
+		if(complete > 0)
+		{
+			gint64 end = subscriber->last_sent + complete * resolution;
+			send_signal_history(subscriber->handle, subscriber->message, subscriber->last_sent, end,
+						subscriber->interval, NULL);
+			subscriber->last_sent = end;
+		}
+	}
+}
+
+//->Start of API documentation comment block
+/**
+@page com_webos_wifi com.webos.wifi
+@{
+@section com_webos_wifi_getsignalhistory getsignalhistory
+
+Summarize how the signal strength of the connected WIFI network evolved.
+
+The strength readings of each network are kept in a fixed size history of
+the last 512 readings. They are summarized in buckets of "resolution"
+milliseconds, each with the lowest, average and highest strength.
+
+Subscribers first get the last "minutes" and then each bucket as it
+completes. They follow whichever network is connected.
+
+@par Parameters
+Name | Required | Type | Description
+-----|--------|------|----------
+minutes | no | Integer | How far back the reply goes, default 5
+resolution | no | Integer | Bucket width in milliseconds, at least 1000, default 10000
+subscribe | no | Boolean | Subscribe to new buckets
+
+minutes * 60000 / resolution must not exceed 720.
+
+@par Returns(Call)
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True
+subscribed | yes | Boolean | True if subscribed
+resolution | yes | Integer | Bucket width in milliseconds
+ssid | no | String | SSID of the connected network, absent if none is connected
+buckets | yes | Array of Object | Buckets oldest first, see below. Buckets before the first reading are left out.
+
+@par "bucket" Object
+Name | Required | Type | Description
+-----|--------|------|----------
+timestamp | yes | Integer | Start of the bucket in milliseconds since the epoch
+min | yes | Integer | Lowest strength
+avg | yes | Number | Average strength, weighted by how long each reading lasted
+max | yes | Integer | Highest strength
+samples | yes | Integer | Number of readings within the bucket
+
+@par Returns(Subscription)
+The same fields as the call, without "subscribed", holding the buckets
+completed since the previous update.
+
+@}
+*/
+//->End of API documentation comment block
+
+/**
+ * Handler for "getsignalhistory" command.
+ *
+ * JSON format:
+ * luna://com.palm.wifi/getsignalhistory {"minutes":<minutes>,"resolution":<milliseconds>,"subscribe":true}
+ */
+static bool handle_get_signal_history_command(LSHandle *sh, LSMessage *message, void* context)
+{
+	LSError lserror;
+	LSErrorInit(&lserror);
+	bool subscribed = false;
+
+	jvalue_ref parsedObj = {0};
+	jschema_ref input_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if(!input_schema)
+		return false;
+
+	JSchemaInfo schemaInfo;
+	jschema_info_init(&schemaInfo, input_schema, NULL, NULL); // no external refs & no error handlers
+	parsedObj = jdom_parse(j_cstr_to_buffer(luna_service_message_get_payload(message)), DOMOPT_NOOPT, &schemaInfo);
+	jschema_release(&input_schema);
+
+	if (jis_null(parsedObj))
+	{
+		LSMessageReplyErrorBadJSON(sh, message);
+		return true;
+	}
+
+	jvalue_ref minutesObj = {0}, resolutionObj = {0};
+	int minutes = WIFI_SIGNAL_HISTORY_DEFAULT_MINUTES;
+	int resolution = WIFI_SIGNAL_HISTORY_DEFAULT_RESOLUTION;
+
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("minutes"), &minutesObj))
+	{
+		if(!jis_number(minutesObj))
+			goto invalid_params;
+		jnumber_get_i32(minutesObj, &minutes);
+	}
+
+	if(jobject_get_exists(parsedObj, J_CSTR_TO_BUF("resolution"), &resolutionObj))
+	{
+		if(!jis_number(resolutionObj))
+			goto invalid_params;
+		jnumber_get_i32(resolutionObj, &resolution);
+	}
+
+	if(minutes < 0 || resolution < WIFI_SIGNAL_HISTORY_MIN_RESOLUTION
+		|| (gint64) minutes * 60000 / resolution > WIFI_SIGNAL_HISTORY_MAX_BUCKETS)
+		goto invalid_params;
+
+	if (luna_service_message_is_subscription(message))
+	{
+		if (!luna_service_subscription_process(sh, message, &subscribed, &lserror))
+		{
+			LSErrorPrint(&lserror, stderr);
+			LSErrorFree(&lserror);
+		}
+	}
+
+	gint64 now = g_get_monotonic_time();
+	send_signal_history(sh, message, now - (gint64) minutes * 60 * G_USEC_PER_SEC, now, resolution, &subscribed);
+
+	if(subscribed)
 	{
-		connman_technology_register_property_changed_cb(technology, technology_property_changed_callback);
+		luna_service_periodic_subscriber_t *subscriber = luna_service_periodic_subscriber_new(sh, message,
+											resolution, NULL, NULL);
+		subscriber->last_sent = now;
+		luna_service_periodic_add(&signal_periodic, subscriber);
 	}
+
+	goto cleanup;
+
+invalid_params:
+	LSMessageReplyErrorInvalidParams(sh, message);
+cleanup:
+	j_release(&parsedObj);
+	return true;
 }
 
 /**
@@ -1817,8 +2975,11 @@ static LSMethod wifi_methods[] = {
     { LUNA_METHOD_SETSTATE,		handle_set_state_command },
     { LUNA_METHOD_CONNECT,		handle_connect_command },
     { LUNA_METHOD_FINDNETWORKS,		handle_findnetworks_command },
+    { LUNA_METHOD_GETNETWORKS,		handle_get_networks_command },
     { LUNA_METHOD_DELETEPROFILE,	handle_delete_profile_command },
     { LUNA_METHOD_GETSTATUS,		handle_get_status_command },
+    { LUNA_METHOD_GETWIFIDIAGNOSTICS,	handle_get_wifi_diagnostics_command },
+    { LUNA_METHOD_GETSIGNALHISTORY,	handle_get_signal_history_command },
     { },
 };
 
@@ -1849,7 +3010,8 @@ int initialize_wifi_ls2_calls( GMainLoop *mainloop )
 		goto Exit;
 	}
 
-	if (LSRegisterCategory(pLsHandle, NULL, wifi_methods, NULL, NULL, &lserror) == false)
+	if (luna_service_register_category(pLsHandle, luna_service_category_new(WIFI_LUNA_SERVICE_NAME, wifi_methods),
+				&lserror) == false)
 	{
 		WCA_LOG_FATAL("LSRegisterCategory() returned error");
 		goto Exit;
@@ -1867,8 +3029,19 @@ int initialize_wifi_ls2_calls( GMainLoop *mainloop )
 		goto Exit;
 	}
 
+	/* Method calls go ahead of connman signals and background work */
+	if (LSGmainSetPriority(pLsHandle, scheduler_priority(SCHEDULER_CLASS_INTERACTIVE), &lserror) == false
+		|| LSGmainSetPriority(pLsPublicHandle, scheduler_priority(SCHEDULER_CLASS_INTERACTIVE), &lserror) == false)
+	{
+		WCA_LOG_FATAL("LSGmainSetPriority() returned error");
+		goto Exit;
+	}
+
 	g_type_init();
 
+	/* Observe the WiFi technology's "PropertyChanged" signal, whenever connman has one */
+	technology_registry_add_observer(CONNMAN_TECHNOLOGY_TYPE_WIFI, technology_property_changed_callback, NULL);
+
         g_bus_watch_name(G_BUS_TYPE_SYSTEM, "net.connman", G_BUS_NAME_WATCHER_FLAGS_NONE, connman_service_started, connman_service_stopped, NULL, NULL);
 
 	init_wifi_profile_list();
@@ -40,6 +40,9 @@
 #define LUNA_METHOD_GETPROFILELIST          "getprofilelist"
 #define LUNA_METHOD_GETSTATUS               "getstatus"
 #define LUNA_METHOD_SETSTATE                "setstate"
+#define LUNA_METHOD_GETWIFIDIAGNOSTICS      "getwifidiagnostics"
+#define LUNA_METHOD_GETSIGNALHISTORY        "getsignalhistory"
+#define LUNA_METHOD_GETNETWORKS             "getNetworks"
 
 extern int initialize_wifi_ls2_calls(GMainLoop *mainloop);
 
@@ -32,6 +32,8 @@
 #include "wifi_service.h"
 #include "wifi_profile.h"
 #include "logging.h"
+#include "offload.h"
+#include "scheduler.h"
 
 /**
  * WiFi setting keys used to identify settings stored in luna-prefs database.
@@ -331,29 +333,66 @@ static void add_wifi_profile(jvalue_ref *profile_j, wifi_profile_t *profile)
 	}
 }
 
-static gchar *add_wifi_profile_list(void)
+static void free_profile_copy(gpointer data)
 {
-        if(profile_list_is_empty())
-                return NULL;
+	wifi_profile_t *profile = data;
 
+	g_free(profile->ssid);
+	g_strfreev(profile->security);
+	g_free(profile);
+}
+
+/**
+ * @brief Copy the profile list so it can be serialized on a worker thread
+ */
+
+static GPtrArray *copy_wifi_profile_list(void)
+{
+	GPtrArray *profiles = g_ptr_array_new_with_free_func(free_profile_copy);
+
+	wifi_profile_t *profile = get_next_profile(NULL);
+	while(NULL != profile)
+	{
+		wifi_profile_t *copy = g_new0(wifi_profile_t, 1);
+		copy->profile_id = profile->profile_id;
+		copy->ssid = g_strdup(profile->ssid);
+		copy->hidden = profile->hidden;
+		copy->security = g_strdupv(profile->security);
+		g_ptr_array_add(profiles, copy);
+		profile = get_next_profile(profile);
+	}
+
+	return profiles;
+}
+
+/**
+ * @brief Serialize and encrypt a copied profile list, touching no global state
+ */
+
+static gchar *serialize_wifi_profile_list(GPtrArray *profiles)
+{
 	gchar *profile_list_str = NULL;
+	guint i;
+
+	if(0 == profiles->len)
+		return NULL;
+
 	jschema_ref response_schema = jschema_parse (j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
 	if(response_schema)
 	{
 		jvalue_ref profilelist_j = jobject_create();
 		jvalue_ref profilelist_arr_j = jarray_create(NULL);
 
-		wifi_profile_t *profile = get_next_profile(NULL);
-		while(NULL != profile)
+		for (i = 0; i < profiles->len; i++)
 		{
 			jvalue_ref profileinfo_j = jobject_create();
 			jvalue_ref profile_j = jobject_create();
-			add_wifi_profile(&profile_j, profile);
+			add_wifi_profile(&profile_j, g_ptr_array_index(profiles, i));
 			const gchar *profile_str = jvalue_tostring(profile_j, response_schema);
 			gchar *enc_profile_str = wifi_setting_encrypt(profile_str, WIFI_LUNA_PREFS_ID);
 			jobject_put(profileinfo_j, J_CSTR_TO_JVAL("wifiProfile"), jstring_create(enc_profile_str));
 			jarray_append(profilelist_arr_j, profileinfo_j);
-			profile = get_next_profile(profile);
+			j_release(&profile_j);
 			g_free(enc_profile_str);
 		}
 		jobject_put(profilelist_j, J_CSTR_TO_JVAL("profileList"), profilelist_arr_j);
@@ -364,52 +403,95 @@ static gchar *add_wifi_profile_list(void)
 	return profile_list_str;
 }
 
+/**
+ * @brief A profile list being encrypted on a worker thread
+ */
+
+typedef struct profile_list_job
+{
+	GPtrArray *profiles;
+	guint seq;
+	gchar *profile_list_str;
+}profile_list_job_t;
+
+/* Sequence numbers of the stored profile lists, so an older list never overwrites a newer one */
+static guint profile_list_seq = 0;
+static guint profile_list_stored_seq = 0;
+
+static void profile_list_job_work(gpointer data)
+{
+	profile_list_job_t *job = data;
+
+	job->profile_list_str = serialize_wifi_profile_list(job->profiles);
+}
+
+static void profile_list_job_done(gpointer data)
+{
+	profile_list_job_t *job = data;
+	LPAppHandle handle;
+	LPErr lpErr;
+
+	if(NULL == job->profile_list_str || (gint)(job->seq - profile_list_stored_seq) <= 0)
+		goto Exit;
+	profile_list_stored_seq = job->seq;
+
+	lpErr = LPAppGetHandle(WIFI_LUNA_PREFS_ID, &handle);
+	if (lpErr)
+	{
+		WCA_LOG_ERROR("Error in getting LPAppHandle for %s",WIFI_LUNA_PREFS_ID);
+		goto Exit;
+	}
+
+	lpErr = LPAppSetValue(handle, SettingKey[WIFI_PROFILELIST_SETTING], job->profile_list_str);
+	if (lpErr)
+		WCA_LOG_ERROR("Error in executing LPAppSetValue for %s",SettingKey[WIFI_PROFILELIST_SETTING]);
+
+	(void) LPAppFreeHandle(handle, true);
+
+Exit:
+	g_ptr_array_free(job->profiles, TRUE);
+	g_free(job->profile_list_str);
+	g_free(job);
+}
+
 /**
  * @brief Set the values of given settings in luna-prefs
  *
  * The param data can be supplied for providing the values of settings
  * (Not required for WIFI_PROFILELIST_SETTING since this function
  * will fetch from wifi profile list itself
+ *
+ * The profile list is encrypted on a worker thread and written once
+ * that is done, so TRUE only means the store has been queued.
  */
 
 gboolean store_wifi_setting(wifi_setting_type_t setting, void *data)
 {
-	LPErr lpErr = LP_ERR_NONE;
-	LPAppHandle handle;
 	gboolean ret = FALSE;
 
-	lpErr = LPAppGetHandle(WIFI_LUNA_PREFS_ID, &handle);
-        if (lpErr)
-        {
-		WCA_LOG_ERROR("Error in getting LPAppHandle for %s",WIFI_LUNA_PREFS_ID);
-		return FALSE;
-	}
-
 	switch(setting)
 	{
 		case WIFI_PROFILELIST_SETTING:
 			{
-				/* Convert list of profiles to json string for storing */
-				char *profile_list_str = add_wifi_profile_list();
-				if(NULL == profile_list_str)
+				if(profile_list_is_empty())
 				{
 					WCA_LOG_DEBUG("No wifi profiles found");
-					goto Exit;
-				}
-				lpErr = LPAppSetValue(handle, SettingKey[setting], profile_list_str);
-				g_free(profile_list_str);
-				if (lpErr)
-				{
-					WCA_LOG_ERROR("Error in executing LPAppSetValue for %s",SettingKey[setting]);
-					goto Exit;
+					break;
 				}
+
+				/* Convert list of profiles to json string off the main loop, the
+				   result is stored once it is back on the main loop */
+				profile_list_job_t *job = g_new0(profile_list_job_t, 1);
+				job->profiles = copy_wifi_profile_list();
+				job->seq = ++profile_list_seq;
+				offload_run_full(scheduler_priority(SCHEDULER_CLASS_PERSIST),
+						profile_list_job_work, profile_list_job_done, job);
 				ret = TRUE;
 				break;
 			}
 		default:
 			break;
 	}
-Exit:
-	(void) LPAppFreeHandle(handle, true);
+
 	return ret;
 }
@@ -0,0 +1,167 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  connman_status_page.c
+ *
+ * @brief Reader side of the network status page. Only depends on libc so
+ *        native clients can link it without pulling in glib.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "connman_status_page.h"
+
+/* Copies attempted while the writer keeps changing the record */
+#define READ_ATTEMPTS	100
+
+struct connman_status_page_reader
+{
+	const connman_status_page_t *page;
+	int watch_fd;
+};
+
+connman_status_page_reader_t *connman_status_page_open(void)
+{
+	struct stat st;
+	int saved_errno;
+
+	int fd = shm_open(CONNMAN_STATUS_PAGE_NAME, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0)
+		goto error;
+
+	if (st.st_size < (off_t) sizeof(connman_status_page_t))
+	{
+		errno = EPROTO;
+		goto error;
+	}
+
+	void *page = mmap(NULL, sizeof(connman_status_page_t), PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == page)
+		goto error;
+	close(fd);
+
+	connman_status_page_reader_t *reader = calloc(1, sizeof(*reader));
+	if (NULL == reader)
+	{
+		munmap(page, sizeof(connman_status_page_t));
+		return NULL;
+	}
+
+	reader->page = page;
+	reader->watch_fd = -1;
+	return reader;
+
+error:
+	saved_errno = errno;
+	close(fd);
+	errno = saved_errno;
+	return NULL;
+}
+
+void connman_status_page_close(connman_status_page_reader_t *reader)
+{
+	if (NULL == reader)
+		return;
+
+	if (reader->watch_fd >= 0)
+		close(reader->watch_fd);
+	munmap((void *) reader->page, sizeof(connman_status_page_t));
+	free(reader);
+}
+
+int connman_status_page_read(connman_status_page_reader_t *reader, connman_status_page_t *status)
+{
+	const connman_status_page_t *page = reader->page;
+	int attempt;
+
+	for (attempt = 0; attempt < READ_ATTEMPTS; attempt++)
+	{
+		uint32_t begin = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+		if (begin & 1)
+		{
+			sched_yield();
+			continue;
+		}
+
+		memcpy(status, (const void *) page, sizeof(*status));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) != begin)
+			continue;
+
+		if (status->magic != CONNMAN_STATUS_PAGE_MAGIC || status->version != CONNMAN_STATUS_PAGE_VERSION
+			|| status->size < sizeof(connman_status_page_t))
+		{
+			errno = EPROTO;
+			return -1;
+		}
+
+		status->sequence = begin;
+		return 0;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+int connman_status_page_watch(connman_status_page_reader_t *reader)
+{
+	if (reader->watch_fd >= 0)
+		return reader->watch_fd;
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	/* The adapter touches the file after every change */
+	if (inotify_add_watch(fd, CONNMAN_STATUS_PAGE_PATH, IN_ATTRIB | IN_MODIFY) < 0)
+	{
+		int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+		return -1;
+	}
+
+	reader->watch_fd = fd;
+	return fd;
+}
+
+void connman_status_page_consume(connman_status_page_reader_t *reader)
+{
+	char buffer[4096];
+
+	if (reader->watch_fd < 0)
+		return;
+
+	while (read(reader->watch_fd, buffer, sizeof(buffer)) > 0)
+		;
+}
@@ -0,0 +1,153 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2012-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ * @file  connman_status_page.h
+ *
+ * @brief Layout of the network status page webos-connman-adapter publishes
+ *        in shared memory, and the functions to read it without any IPC
+ *
+ * The page holds the same information as com.palm.connectionmanager/getstatus.
+ * The adapter is the only writer. It guards each update with a sequence
+ * number which is odd while the update is in progress, so readers copy the
+ * record and retry if the number changed meanwhile.
+ *
+ * Usage:
+ *
+ *	connman_status_page_reader_t *reader = connman_status_page_open();
+ *	connman_status_page_t status;
+ *
+ *	if (reader && connman_status_page_read(reader, &status) == 0)
+ *		online = status.online;
+ *
+ * To wait for changes, poll the descriptor returned by
+ * connman_status_page_watch() for reading, then call
+ * connman_status_page_consume() and read again.
+ *
+ */
+
+
+#ifndef CONNMAN_STATUS_PAGE_H_
+#define CONNMAN_STATUS_PAGE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * shm_open() name of the page, found as /dev/shm/webos-connman-adapter-status
+ */
+#define CONNMAN_STATUS_PAGE_NAME	"/webos-connman-adapter-status"
+#define CONNMAN_STATUS_PAGE_PATH	"/dev/shm/webos-connman-adapter-status"
+
+#define CONNMAN_STATUS_PAGE_MAGIC	0x53414357	/* "WCAS" */
+
+/**
+ * Incremented whenever the layout changes incompatibly
+ */
+#define CONNMAN_STATUS_PAGE_VERSION	1
+
+/**
+ * Index of the technologies in connman_status_page_t.links
+ */
+enum {
+	CONNMAN_STATUS_PAGE_WIRED = 0,
+	CONNMAN_STATUS_PAGE_WIFI,
+	CONNMAN_STATUS_PAGE_CELLULAR,
+	CONNMAN_STATUS_PAGE_LINKS
+};
+
+/**
+ * Connection state of a technology, the "state" field of getstatus
+ */
+enum {
+	CONNMAN_STATUS_PAGE_DISCONNECTED = 0,
+	CONNMAN_STATUS_PAGE_CONNECTED
+};
+
+/**
+ * Status of one technology. Everything but state is zero when disconnected.
+ */
+typedef struct connman_status_page_link
+{
+	uint8_t state;			/* CONNMAN_STATUS_PAGE_DISCONNECTED or _CONNECTED */
+	uint8_t on_internet;		/* connman reports the service online */
+	uint8_t strength;		/* 0 - 100, wifi only */
+	uint8_t reserved;
+	uint32_t ipv4_address;		/* network byte order */
+	uint32_t ipv4_netmask;		/* network byte order */
+	uint32_t ipv4_gateway;		/* network byte order */
+	char interface_name[16];	/* NUL terminated */
+	char ssid[36];			/* NUL terminated, wifi only */
+} connman_status_page_link_t;
+
+/**
+ * The status record
+ */
+typedef struct connman_status_page
+{
+	uint32_t magic;			/* CONNMAN_STATUS_PAGE_MAGIC */
+	uint32_t version;		/* CONNMAN_STATUS_PAGE_VERSION */
+	uint32_t size;			/* sizeof(connman_status_page_t) of the writer */
+	uint32_t sequence;		/* odd while being written, +2 per change */
+	uint64_t updated;		/* time of the last change in milliseconds since the epoch */
+	uint8_t online;			/* isInternetConnectionAvailable */
+	uint8_t offline_mode;		/* offlineMode is "enabled" */
+	uint8_t reserved[6];
+	connman_status_page_link_t links[CONNMAN_STATUS_PAGE_LINKS];
+} connman_status_page_t;
+
+typedef struct connman_status_page_reader connman_status_page_reader_t;
+
+/**
+ * Map the status page
+ *
+ * @return Reader, or NULL with errno set if the adapter never published the page
+ */
+extern connman_status_page_reader_t *connman_status_page_open(void);
+
+extern void connman_status_page_close(connman_status_page_reader_t *reader);
+
+/**
+ * Copy a consistent status record
+ *
+ * @return 0 on success, -1 with errno set to EAGAIN if the writer kept
+ *         changing the record, EPROTO if its version is not supported
+ */
+extern int connman_status_page_read(connman_status_page_reader_t *reader, connman_status_page_t *status);
+
+/**
+ * Get a descriptor which becomes readable when the status changed
+ *
+ * @return File descriptor owned by the reader, or -1 with errno set
+ */
+extern int connman_status_page_watch(connman_status_page_reader_t *reader);
+
+/**
+ * Clear the readable state of the watch descriptor
+ */
+extern void connman_status_page_consume(connman_status_page_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONNMAN_STATUS_PAGE_H_ */